@@ -6,7 +6,7 @@
 
 QT       += core gui
 
-# Because Qt 5.2 has no QOpenGLWidget
+# QGLWidget, the old surface kept to compare against QOpenGLWindow (Qt 5.4)
 QT += opengl
 
 CONFIG += c++11
@@ -14,6 +14,9 @@ CONFIG += c++11
 # Qt5
 QT += widgets
 
+# command lists recorded on the thread pool
+QT += concurrent
+
 TARGET = FancyChessBoard
 TEMPLATE = app
 
@@ -23,7 +26,27 @@ SOURCES += main.cpp \
     glwidget.cpp \
     mainwindow.cpp \
     objloader.cpp \
-    customwidgets.cpp
+    customwidgets.cpp \
+    glextensions.cpp \
+    renderqueue.cpp \
+    streambuffer.cpp \
+    programcache.cpp \
+    lightclusters.cpp \
+    gbuffer.cpp \
+    shadowmaps.cpp \
+    planarreflection.cpp \
+    dynamicresolution.cpp \
+    gputimer.cpp \
+    antialiasing.cpp \
+    qualitygovernor.cpp \
+    tournamentwall.cpp \
+    hud.cpp \
+    softrasterizer.cpp \
+    bvh.cpp \
+    pathtracer.cpp \
+    simulation.cpp \
+    renderthread.cpp \
+    parameters.cpp
 
 HEADERS += \
     utils.h \
@@ -31,7 +54,31 @@ HEADERS += \
     glwidget.h \
     mainwindow.h \
     objloader.h \
-    customwidgets.h
+    customwidgets.h \
+    glextensions.h \
+    renderqueue.h \
+    commandlist.h \
+    streambuffer.h \
+    programcache.h \
+    lightclusters.h \
+    gbuffer.h \
+    shadowmaps.h \
+    planarreflection.h \
+    dynamicresolution.h \
+    gputimer.h \
+    antialiasing.h \
+    qualitygovernor.h \
+    tournamentwall.h \
+    hud.h \
+    softrasterizer.h \
+    bvh.h \
+    pathtracer.h \
+    simulation.h \
+    triplebuffer.h \
+    spscqueue.h \
+    renderthread.h \
+    parameters.h \
+    pieces.h
 
 OTHER_FILES += \
     shaders/* \
@@ -45,7 +92,20 @@ OTHER_FILES += \
     shaders/bezier.frag \
     shaders/bezier.vert \
     shaders/cubemap.vert \
-    shaders/cubemap.frag
+    shaders/cubemap.frag \
+    shaders/clusters.glsl \
+    shaders/octahedral.glsl \
+    shaders/deferred.vert \
+    shaders/deferred.frag \
+    shaders/shadows.glsl \
+    shaders/shadow.vert \
+    shaders/shadow.frag \
+    shaders/post.vert \
+    shaders/post.frag \
+    shaders/wall.vert \
+    shaders/wall.frag \
+    shaders/hud.vert \
+    shaders/hud.frag
 
 # RESOURCES += \
 #     resources.qrc
@@ -0,0 +1,107 @@
+#include "antialiasing.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+bool AntiAliasing::prepare(GLExtensions* ext, Mode mode, int samples, int width, int height)
+{
+    if(fbo && mode == myMode && (mode != MSAA || samples == mySamples) && width == myWidth && height == myHeight)
+        return true;
+
+    destroy();
+    this->ext = ext;
+
+    if(mode == OFF || !ext->framebufferObject)
+        return false;
+
+    ext->GenFramebuffers(1, &fbo);
+    ext->BindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    if(mode == MSAA) {
+        GLint maxSamples = 1;
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        samples = std::max(1, std::min(samples, (int) maxSamples));
+
+        // rgba8 like the window (see MyGLDrawer), a multisampled blit needs the same format on both sides
+        GLuint buffers[2];
+        ext->GenRenderbuffers(2, buffers);
+        colorBuffer = buffers[0];
+        depthBuffer = buffers[1];
+        ext->BindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        ext->RenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+        ext->BindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        ext->RenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+        ext->BindRenderbuffer(GL_RENDERBUFFER, 0);
+        ext->FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        ext->FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    } else {
+        samples = 1;
+        glGenTextures(1, &colorTexture);
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // fxaa reads between the texels
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glGenTextures(1, &depthTexture);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        ext->FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+        ext->FramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    }
+
+    if(ext->CheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        qDebug() << "anti-aliasing target incomplete, mode" << mode << "samples" << samples;
+        destroy();
+        return false;
+    }
+
+    timer.create(ext);
+    myMode = mode;
+    mySamples = samples;
+    myWidth = width;
+    myHeight = height;
+    return true;
+}
+
+void AntiAliasing::destroy()
+{
+    if(!fbo)
+        return;
+
+    ext->DeleteFramebuffers(1, &fbo);
+    if(colorBuffer) {
+        GLuint buffers[] = {colorBuffer, depthBuffer};
+        ext->DeleteRenderbuffers(2, buffers);
+    }
+    if(colorTexture) {
+        GLuint textures[] = {colorTexture, depthTexture};
+        glDeleteTextures(2, textures);
+    }
+    timer.destroy();
+
+    fbo = colorBuffer = depthBuffer = colorTexture = depthTexture = 0;
+    myMode = OFF;
+    mySamples = myWidth = myHeight = 0;
+}
+
+void AntiAliasing::resolve(GLuint target)
+{
+    ext->BindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    ext->BindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+    ext->BlitFramebuffer(0, 0, myWidth, myHeight, 0, 0, myWidth, myHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    ext->BindFramebuffer(GL_FRAMEBUFFER, target);
+}
+
+void AntiAliasing::bindTexture(int unit)
+{
+    ext->ActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    ext->ActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,52 @@
+#ifndef ANTIALIASING_H
+#define ANTIALIASING_H
+
+#include "glextensions.h"
+#include "gputimer.h"
+
+/**
+ * @brief offscreen target of the scene for the anti-aliasing modes
+ *
+ * MSAA: multisampled color and depth renderbuffers, resolved by a blit at the end of the frame.
+ * FXAA: one sample, the color is a texture read by a full screen pass (see shaders/post.frag).
+ * The window itself has no samples, so OFF and FXAA don't pay for them.
+ */
+class AntiAliasing
+{
+public:
+    enum Mode { OFF, MSAA, FXAA };
+
+    /**
+     * @brief (re)allocates the target if the mode, the samples or the size changed
+     * samples are clamped to what the driver supports, false if there can't be a target
+     */
+    bool prepare(GLExtensions* ext, Mode mode, int samples, int width, int height);
+    void destroy();
+
+    Mode mode() const { return myMode; }
+    int samples() const { return mySamples; }
+    GLuint framebuffer() const { return fbo; }
+
+    /**
+     * @brief MSAA: averages the samples into the target framebuffer, of the same size
+     */
+    void resolve(GLuint target);
+
+    /**
+     * @brief FXAA: color texture on a unit
+     */
+    void bindTexture(int unit);
+
+    GpuTimer timer; // of the resolve or the FXAA pass
+
+private:
+    GLExtensions* ext = nullptr;
+    Mode myMode = OFF;
+    int mySamples = 0;
+    int myWidth = 0, myHeight = 0;
+    GLuint fbo = 0;
+    GLuint colorBuffer = 0, depthBuffer = 0; // MSAA
+    GLuint colorTexture = 0, depthTexture = 0; // FXAA
+};
+
+#endif // ANTIALIASING_H
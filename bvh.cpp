@@ -0,0 +1,449 @@
+#include "bvh.h"
+
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using std::min;
+using std::max;
+
+#ifdef __SSE2__
+static_assert(Bvh::LANES == 4, "a lane per float of an SSE register");
+
+static inline __m128 select(__m128 mask, __m128 a, __m128 b) // mask ? a : b
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+#endif
+
+static float area(const float* lo, const float* hi)
+{
+    float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+static void empty(float* lo, float* hi)
+{
+    for(int a = 0; a < 3; a++) {
+        lo[a] = 1e30f;
+        hi[a] = -1e30f;
+    }
+}
+
+static void grow(float* lo, float* hi, const float* pmin, const float* pmax)
+{
+    for(int a = 0; a < 3; a++) {
+        lo[a] = min(lo[a], pmin[a]);
+        hi[a] = max(hi[a], pmax[a]);
+    }
+}
+
+void Bvh::clear()
+{
+    nodes.clear();
+    triangles.clear();
+    for(int a = 0; a < 3; a++) {
+        p0[a].clear();
+        e1[a].clear();
+        e2[a].clear();
+    }
+    stats = Stats();
+}
+
+void Bvh::build(const QVector<QVector3D>& vertices)
+{
+    QElapsedTimer timer;
+    timer.start();
+    clear();
+
+    int n = vertices.size() / 3;
+    QVector<Reference> refs(n);
+    for(int i = 0; i < n; i++) {
+        Reference& r = refs[i];
+        r.triangle = i;
+        for(int a = 0; a < 3; a++) {
+            r.min[a] = min(vertices[3*i][a], min(vertices[3*i+1][a], vertices[3*i+2][a]));
+            r.max[a] = max(vertices[3*i][a], max(vertices[3*i+1][a], vertices[3*i+2][a]));
+            r.center[a] = 0.5f * (r.min[a] + r.max[a]);
+        }
+    }
+
+    stats.triangles = n;
+    if(n == 0)
+        return;
+
+    nodes.reserve(2 * n);
+    subdivide(refs, 0, n, 1);
+
+    // the leaves point in the reordered arrays, filled last
+    for(int a = 0; a < 3; a++) {
+        p0[a].resize(n);
+        e1[a].resize(n);
+        e2[a].resize(n);
+    }
+    for(int i = 0; i < n; i++) {
+        int t = triangles[i];
+        for(int a = 0; a < 3; a++) {
+            p0[a][i] = vertices[3*t][a];
+            e1[a][i] = vertices[3*t+1][a] - vertices[3*t][a];
+            e2[a][i] = vertices[3*t+2][a] - vertices[3*t][a];
+        }
+    }
+
+    stats.nodes = nodes.size();
+    stats.buildNs = timer.nsecsElapsed();
+}
+
+void Bvh::leaf(Node& node, const QVector<Reference>& refs, int begin, int end)
+{
+    node.index = triangles.size();
+    node.count = end - begin;
+    for(int i = begin; i < end; i++)
+        triangles.append(refs[i].triangle);
+    stats.leaves++;
+}
+
+int Bvh::subdivide(QVector<Reference>& refs, int begin, int end, int depth)
+{
+    int index = nodes.size();
+    nodes.append(Node());
+    stats.depth = max(stats.depth, depth);
+
+    Node node;
+    float cmin[3], cmax[3]; // of the centers
+    empty(node.min, node.max);
+    empty(cmin, cmax);
+    for(int i = begin; i < end; i++) {
+        grow(node.min, node.max, refs[i].min, refs[i].max);
+        grow(cmin, cmax, refs[i].center, refs[i].center);
+    }
+
+    int n = end - begin;
+    if(n <= LEAF || depth >= MAX_DEPTH) {
+        leaf(node, refs, begin, end);
+        nodes[index] = node;
+        return index;
+    }
+
+    // binned SAH: the cost of a split is the area of each side times its triangles, a leaf costs its triangles
+    float bestCost = 1e30f;
+    int bestAxis = -1, bestBin = 0;
+    for(int a = 0; a < 3; a++) {
+        float extent = cmax[a] - cmin[a];
+        if(extent <= 0)
+            continue;
+
+        struct {
+            float min[3], max[3];
+            int count = 0;
+        } bins[BINS];
+        for(auto& b : bins)
+            empty(b.min, b.max);
+
+        float scale = BINS / extent;
+        for(int i = begin; i < end; i++) {
+            int b = min(BINS - 1, (int) ((refs[i].center[a] - cmin[a]) * scale));
+            grow(bins[b].min, bins[b].max, refs[i].min, refs[i].max);
+            bins[b].count++;
+        }
+
+        // areas and counts on the right of each plane, then sweep from the left
+        float rightArea[BINS];
+        int rightCount[BINS];
+        float lo[3], hi[3];
+        empty(lo, hi);
+        int count = 0;
+        for(int b = BINS - 1; b > 0; b--) {
+            grow(lo, hi, bins[b].min, bins[b].max);
+            count += bins[b].count;
+            rightArea[b] = count ? area(lo, hi) : 0;
+            rightCount[b] = count;
+        }
+        empty(lo, hi);
+        count = 0;
+        for(int b = 1; b < BINS; b++) {
+            grow(lo, hi, bins[b-1].min, bins[b-1].max);
+            count += bins[b-1].count;
+            if(!count || !rightCount[b])
+                continue;
+            float cost = area(lo, hi) * count + rightArea[b] * rightCount[b];
+            if(cost < bestCost) {
+                bestCost = cost;
+                bestAxis = a;
+                bestBin = b;
+            }
+        }
+    }
+
+    float parentArea = area(node.min, node.max);
+    bool split = bestAxis >= 0 && (parentArea <= 0 || 1 + bestCost / parentArea < n);
+    if(!split && n <= 4 * LEAF) {
+        leaf(node, refs, begin, end);
+        nodes[index] = node;
+        return index;
+    }
+
+    int mid;
+    if(bestAxis >= 0) {
+        float scale = BINS / (cmax[bestAxis] - cmin[bestAxis]);
+        float c = cmin[bestAxis];
+        int a = bestAxis, b = bestBin;
+        mid = std::partition(refs.begin() + begin, refs.begin() + end, [a, b, c, scale](const Reference& r) {
+            return min(BINS - 1, (int) ((r.center[a] - c) * scale)) < b;
+        }) - refs.begin();
+    } else {
+        mid = (begin + end) / 2; // all the centers at the same place
+    }
+    if(mid == begin || mid == end)
+        mid = (begin + end) / 2;
+
+    node.count = 0;
+    subdivide(refs, begin, mid, depth + 1);
+    node.index = subdivide(refs, mid, end, depth + 1);
+    nodes[index] = node;
+    return index;
+}
+
+bool Bvh::intersect(const Ray& ray, Hit& hit) const
+{
+    return anyOrNearest(ray, &hit);
+}
+
+bool Bvh::occluded(const Ray& ray) const
+{
+    return anyOrNearest(ray, nullptr);
+}
+
+bool Bvh::anyOrNearest(const Ray& ray, Hit* hit) const
+{
+    if(nodes.isEmpty())
+        return false;
+
+    const float o[3] = {ray.origin.x(), ray.origin.y(), ray.origin.z()};
+    const float d[3] = {ray.direction.x(), ray.direction.y(), ray.direction.z()};
+    const float inv[3] = {1 / d[0], 1 / d[1], 1 / d[2]};
+    float tMax = ray.tMax;
+    bool found = false;
+
+    auto box = [&o, &inv, &tMax](const Node& node, float& tNear) {
+        float t0 = 0, t1 = tMax;
+        for(int a = 0; a < 3; a++) {
+            float ta = (node.min[a] - o[a]) * inv[a], tb = (node.max[a] - o[a]) * inv[a];
+            t0 = max(t0, min(ta, tb));
+            t1 = min(t1, max(ta, tb));
+        }
+        tNear = t0;
+        return t0 <= t1;
+    };
+
+    int stack[MAX_DEPTH + 1];
+    int top = 0;
+    float tNear;
+    if(!box(nodes[0], tNear))
+        return false;
+    stack[top++] = 0;
+
+    while(top) {
+        const Node& node = nodes[stack[--top]];
+
+        if(node.count) {
+            // Moller-Trumbore
+            for(int i = node.index; i < node.index + node.count; i++) {
+                float a1[3] = {e1[0][i], e1[1][i], e1[2][i]}, a2[3] = {e2[0][i], e2[1][i], e2[2][i]};
+                float p[3] = {d[1] * a2[2] - d[2] * a2[1], d[2] * a2[0] - d[0] * a2[2], d[0] * a2[1] - d[1] * a2[0]};
+                float det = a1[0] * p[0] + a1[1] * p[1] + a1[2] * p[2];
+                if(std::abs(det) < 1e-12f)
+                    continue;
+                float invDet = 1 / det;
+                float s[3] = {o[0] - p0[0][i], o[1] - p0[1][i], o[2] - p0[2][i]};
+                float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+                if(u < 0 || u > 1)
+                    continue;
+                float q[3] = {s[1] * a1[2] - s[2] * a1[1], s[2] * a1[0] - s[0] * a1[2], s[0] * a1[1] - s[1] * a1[0]};
+                float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * invDet;
+                if(v < 0 || u + v > 1)
+                    continue;
+                float t = (a2[0] * q[0] + a2[1] * q[1] + a2[2] * q[2]) * invDet;
+                if(t <= 0 || t >= tMax)
+                    continue;
+
+                if(!hit)
+                    return true;
+                tMax = t;
+                hit->triangle = triangles[i];
+                hit->t = t;
+                hit->u = u;
+                hit->v = v;
+                found = true;
+            }
+            continue;
+        }
+
+        // the nearer child on top of the stack
+        int left = &node - nodes.constData() + 1, right = node.index;
+        float tLeft, tRight;
+        bool hitLeft = box(nodes[left], tLeft), hitRight = box(nodes[right], tRight);
+        if(hitLeft && hitRight) {
+            stack[top++] = tLeft < tRight ? right : left;
+            stack[top++] = tLeft < tRight ? left : right;
+        } else if(hitLeft) {
+            stack[top++] = left;
+        } else if(hitRight) {
+            stack[top++] = right;
+        }
+    }
+
+    return found;
+}
+
+void Bvh::intersect4(const Ray rays[LANES], Hit hits[LANES]) const
+{
+    for(int l = 0; l < LANES; l++)
+        hits[l] = Hit();
+    if(nodes.isEmpty())
+        return;
+
+    // lanes as plain arrays, loaded in SSE registers when there are
+    float ox[LANES], oy[LANES], oz[LANES], dx[LANES], dy[LANES], dz[LANES];
+    float ix[LANES], iy[LANES], iz[LANES], tMax[LANES];
+    float u[LANES], v[LANES];
+    int id[LANES];
+    for(int l = 0; l < LANES; l++) {
+        ox[l] = rays[l].origin.x(); oy[l] = rays[l].origin.y(); oz[l] = rays[l].origin.z();
+        dx[l] = rays[l].direction.x(); dy[l] = rays[l].direction.y(); dz[l] = rays[l].direction.z();
+        ix[l] = 1 / dx[l]; iy[l] = 1 / dy[l]; iz[l] = 1 / dz[l];
+        tMax[l] = rays[l].tMax;
+        u[l] = v[l] = 0;
+        id[l] = -1;
+    }
+
+#ifdef __SSE2__
+    // the lanes in SSE registers, the same tests as the loops below on the 4 rays at once
+    const __m128 vox = _mm_loadu_ps(ox), voy = _mm_loadu_ps(oy), voz = _mm_loadu_ps(oz);
+    const __m128 vdx = _mm_loadu_ps(dx), vdy = _mm_loadu_ps(dy), vdz = _mm_loadu_ps(dz);
+    const __m128 vix = _mm_loadu_ps(ix), viy = _mm_loadu_ps(iy), viz = _mm_loadu_ps(iz);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1), far = _mm_set1_ps(1e30f);
+#endif
+
+    // any lane in the box, and the nearest entry of the lanes
+    auto box = [&](const Node& node, float& tNear) {
+        float enter[LANES];
+#ifdef __SSE2__
+        const __m128 ax = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[0]), vox), vix), bx = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[0]), vox), vix);
+        const __m128 ay = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[1]), voy), viy), by = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[1]), voy), viy);
+        const __m128 az = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[2]), voz), viz), bz = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[2]), voz), viz);
+        const __m128 t0 = _mm_max_ps(_mm_max_ps(zero, _mm_min_ps(ax, bx)), _mm_max_ps(_mm_min_ps(ay, by), _mm_min_ps(az, bz)));
+        const __m128 t1 = _mm_min_ps(_mm_min_ps(_mm_loadu_ps(tMax), _mm_max_ps(ax, bx)), _mm_min_ps(_mm_max_ps(ay, by), _mm_max_ps(az, bz)));
+        const __m128 in = _mm_cmple_ps(t0, t1);
+        _mm_storeu_ps(enter, select(in, t0, far));
+        bool any = _mm_movemask_ps(in) != 0;
+#else
+        bool any = false;
+        for(int l = 0; l < LANES; l++) {
+            float ax = (node.min[0] - ox[l]) * ix[l], bx = (node.max[0] - ox[l]) * ix[l];
+            float ay = (node.min[1] - oy[l]) * iy[l], by = (node.max[1] - oy[l]) * iy[l];
+            float az = (node.min[2] - oz[l]) * iz[l], bz = (node.max[2] - oz[l]) * iz[l];
+            float t0 = max(max(0.f, min(ax, bx)), max(min(ay, by), min(az, bz)));
+            float t1 = min(min(tMax[l], max(ax, bx)), min(max(ay, by), max(az, bz)));
+            bool in = t0 <= t1;
+            enter[l] = in ? t0 : 1e30f;
+            any |= in;
+        }
+#endif
+        tNear = *std::min_element(enter, enter + LANES);
+        return any;
+    };
+
+    int stack[MAX_DEPTH + 1];
+    int top = 0;
+    float tNear;
+    if(!box(nodes[0], tNear))
+        return;
+    stack[top++] = 0;
+
+    while(top) {
+        const Node& node = nodes[stack[--top]];
+
+        if(node.count) {
+            for(int i = node.index; i < node.index + node.count; i++) {
+                const float px = p0[0][i], py = p0[1][i], pz = p0[2][i];
+                const float ax = e1[0][i], ay = e1[1][i], az = e1[2][i];
+                const float bx = e2[0][i], by = e2[1][i], bz = e2[2][i];
+#ifdef __SSE2__
+                const __m128 vpx = _mm_set1_ps(px), vpy = _mm_set1_ps(py), vpz = _mm_set1_ps(pz);
+                const __m128 vax = _mm_set1_ps(ax), vay = _mm_set1_ps(ay), vaz = _mm_set1_ps(az);
+                const __m128 vbx = _mm_set1_ps(bx), vby = _mm_set1_ps(by), vbz = _mm_set1_ps(bz);
+                const __m128 qx = _mm_sub_ps(_mm_mul_ps(vdy, vbz), _mm_mul_ps(vdz, vby));
+                const __m128 qy = _mm_sub_ps(_mm_mul_ps(vdz, vbx), _mm_mul_ps(vdx, vbz));
+                const __m128 qz = _mm_sub_ps(_mm_mul_ps(vdx, vby), _mm_mul_ps(vdy, vbx));
+                const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vax, qx), _mm_mul_ps(vay, qy)), _mm_mul_ps(vaz, qz));
+                const __m128 invDet = _mm_div_ps(one, det);
+                const __m128 sx = _mm_sub_ps(vox, vpx), sy = _mm_sub_ps(voy, vpy), sz = _mm_sub_ps(voz, vpz);
+                const __m128 uu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, qx), _mm_mul_ps(sy, qy)), _mm_mul_ps(sz, qz)), invDet);
+                const __m128 rx = _mm_sub_ps(_mm_mul_ps(sy, vaz), _mm_mul_ps(sz, vay));
+                const __m128 ry = _mm_sub_ps(_mm_mul_ps(sz, vax), _mm_mul_ps(sx, vaz));
+                const __m128 rz = _mm_sub_ps(_mm_mul_ps(sx, vay), _mm_mul_ps(sy, vax));
+                const __m128 vv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vdx, rx), _mm_mul_ps(vdy, ry)), _mm_mul_ps(vdz, rz)), invDet);
+                const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vbx, rx), _mm_mul_ps(vby, ry)), _mm_mul_ps(vbz, rz)), invDet);
+                const __m128 t1 = _mm_loadu_ps(tMax);
+                const __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.f), det);
+                const __m128 hit = _mm_and_ps(
+                    _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(absDet, _mm_set1_ps(1e-12f)), _mm_cmpge_ps(uu, zero)),
+                               _mm_and_ps(_mm_cmpge_ps(vv, zero), _mm_cmple_ps(_mm_add_ps(uu, vv), one))),
+                    _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, t1)));
+                if(!_mm_movemask_ps(hit))
+                    continue;
+                _mm_storeu_ps(tMax, select(hit, t, t1));
+                _mm_storeu_ps(u, select(hit, uu, _mm_loadu_ps(u)));
+                _mm_storeu_ps(v, select(hit, vv, _mm_loadu_ps(v)));
+                const __m128i mask = _mm_castps_si128(hit), old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(id));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(id), _mm_or_si128(_mm_and_si128(mask, _mm_set1_epi32(i)), _mm_andnot_si128(mask, old)));
+#else
+                for(int l = 0; l < LANES; l++) {
+                    float qx = dy[l] * bz - dz[l] * by, qy = dz[l] * bx - dx[l] * bz, qz = dx[l] * by - dy[l] * bx;
+                    float det = ax * qx + ay * qy + az * qz;
+                    float invDet = 1 / det;
+                    float sx = ox[l] - px, sy = oy[l] - py, sz = oz[l] - pz;
+                    float uu = (sx * qx + sy * qy + sz * qz) * invDet;
+                    float rx = sy * az - sz * ay, ry = sz * ax - sx * az, rz = sx * ay - sy * ax;
+                    float vv = (dx[l] * rx + dy[l] * ry + dz[l] * rz) * invDet;
+                    float t = (bx * rx + by * ry + bz * rz) * invDet;
+                    bool hit = (std::abs(det) >= 1e-12f) & (uu >= 0) & (vv >= 0) & (uu + vv <= 1) & (t > 0) & (t < tMax[l]);
+                    tMax[l] = hit ? t : tMax[l];
+                    u[l] = hit ? uu : u[l];
+                    v[l] = hit ? vv : v[l];
+                    id[l] = hit ? i : id[l];
+                }
+#endif
+            }
+            continue;
+        }
+
+        int left = &node - nodes.constData() + 1, right = node.index;
+        float tLeft, tRight;
+        bool hitLeft = box(nodes[left], tLeft), hitRight = box(nodes[right], tRight);
+        if(hitLeft && hitRight) {
+            stack[top++] = tLeft < tRight ? right : left;
+            stack[top++] = tLeft < tRight ? left : right;
+        } else if(hitLeft) {
+            stack[top++] = left;
+        } else if(hitRight) {
+            stack[top++] = right;
+        }
+    }
+
+    for(int l = 0; l < LANES; l++) {
+        if(id[l] < 0)
+            continue;
+        hits[l].triangle = triangles[id[l]];
+        hits[l].t = tMax[l];
+        hits[l].u = u[l];
+        hits[l].v = v[l];
+    }
+}
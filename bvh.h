@@ -0,0 +1,82 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <QVector>
+#include <QVector3D>
+
+/**
+ * @brief bounding volume hierarchy over triangles, built with the surface area heuristic
+ *
+ * Binned SAH on the centroids of the triangles, leaves of a few triangles stored contiguously as structure of arrays.
+ * intersect4 takes LANES rays down the tree together: the box and triangle tests run on the 4 lanes at once with SSE2
+ * (a loop over them elsewhere), and coherent rays (a 2x2 block of pixels) visit about the same nodes.
+ * No GL, read only once built, any number of threads can trace it.
+ */
+class Bvh
+{
+public:
+    enum { BINS = 16, LEAF = 4, LANES = 4, MAX_DEPTH = 48 }; // past the depth, a leaf of whatever is left
+
+    struct Ray {
+        QVector3D origin, direction;
+        float tMax = 1e30f;
+    };
+
+    struct Hit {
+        int triangle = -1; // index in the vertices given to build / 3, -1 for none
+        float t = 1e30f;
+        float u = 0, v = 0; // weights of the second and third vertices
+    };
+
+    struct Stats {
+        int triangles = 0, nodes = 0, leaves = 0, depth = 0;
+        qint64 buildNs = 0;
+    } stats;
+
+    /**
+     * @brief 3 vertices per triangle
+     */
+    void build(const QVector<QVector3D>& vertices);
+    void clear();
+    bool isEmpty() const { return nodes.isEmpty(); }
+
+    /**
+     * @brief nearest hit before ray.tMax
+     */
+    bool intersect(const Ray& ray, Hit& hit) const;
+
+    /**
+     * @brief any hit before ray.tMax, for the shadow rays
+     */
+    bool occluded(const Ray& ray) const;
+
+    /**
+     * @brief nearest hit of each ray, lanes without a hit keep triangle -1
+     */
+    void intersect4(const Ray rays[LANES], Hit hits[LANES]) const;
+
+private:
+    struct Node {
+        float min[3], max[3];
+        int index; // first triangle of a leaf, right child of an inner node (the left one is next to it)
+        int count; // triangles of a leaf, 0 for an inner node
+    };
+
+    struct Reference {
+        float min[3], max[3], center[3];
+        int triangle;
+    };
+
+    QVector<Node> nodes;
+
+    // in leaf order: first vertex and the two edges from it
+    QVector<float> p0[3], e1[3], e2[3];
+    QVector<int> triangles; // index given to build
+
+    int subdivide(QVector<Reference>& refs, int begin, int end, int depth);
+    void leaf(Node& node, const QVector<Reference>& refs, int begin, int end);
+
+    bool anyOrNearest(const Ray& ray, Hit* hit) const;
+};
+
+#endif // BVH_H
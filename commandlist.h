@@ -0,0 +1,111 @@
+#ifndef COMMANDLIST_H
+#define COMMANDLIST_H
+
+#include <QVector>
+#include <QVector3D>
+#include <QMatrix4x4>
+
+#include "GL/gl.h"
+
+#include <cstring>
+
+/**
+ * @brief one recorded GL operation, plain data, 16 bytes
+ * matrices and vectors live in CommandList::payload, a is then their offset there.
+ */
+struct Command {
+    enum Type : quint16 {
+        BIND_PROGRAM,   // a = program id
+        BIND_MESH,      // a = mesh id
+        BIND_TEXTURES,  // a = textures id, b = cubemap index
+        UNIFORM_MAT4,   // a = offset
+        UNIFORM_MAT3,   // a = offset
+        UNIFORM_VEC3,   // a = offset, b = count
+        UNIFORM_FLOAT,  // a = offset
+        UNIFORM_INT,    // a = value
+        DRAW_ARRAYS,    // a = mode, b = first, c = count
+        DRAW_MESH,      // a = mesh id
+        DEPTH,          // a = write, b = func
+        BEGIN_QUERY,
+        END_QUERY,
+        OBJECT,         // a = offset in the blocks, per draw data of a streamed program
+    };
+
+    quint16 type;
+    quint16 uniform; // uniform id, for UNIFORM_*
+    qint32 a, b, c;
+};
+
+/**
+ * @brief a frame (or a part of it) recorded without touching GL
+ * so it can be filled on any thread, then replayed by the thread owning the context.
+ */
+class CommandList
+{
+public:
+    QVector<Command> commands;
+    QVector<float> payload;
+    QVector<float> blocks; // std140 Object blocks, uploaded in one go to the stream buffer
+
+    void clear() {
+        commands.clear();
+        payload.clear();
+        blocks.clear();
+    }
+
+    void bindProgram(int program)                        { push(Command::BIND_PROGRAM, 0, program); }
+    void bindMesh(int mesh)                              { push(Command::BIND_MESH, 0, mesh); }
+    void bindTextures(int textures, int cubemap)         { push(Command::BIND_TEXTURES, 0, textures, cubemap); }
+    void drawArrays(GLenum mode, int first, int count)   { push(Command::DRAW_ARRAYS, 0, mode, first, count); }
+    void drawMesh(int mesh)                              { push(Command::DRAW_MESH, 0, mesh); }
+    void depth(bool write, GLenum func)                  { push(Command::DEPTH, 0, write, func); }
+    void beginQuery()                                    { push(Command::BEGIN_QUERY, 0); }
+    void endQuery()                                      { push(Command::END_QUERY, 0); }
+
+    void uniformInt(int uniform, int value)              { push(Command::UNIFORM_INT, uniform, value); }
+    void uniformFloat(int uniform, float value)          { push(Command::UNIFORM_FLOAT, uniform, write(&value, 1)); }
+    void uniformVec3(int uniform, QVector3D v)           { uniformVec3Array(uniform, &v, 1); }
+    void uniformMat3(int uniform, const QMatrix3x3& m)   { push(Command::UNIFORM_MAT3, uniform, write(m.constData(), 9)); }
+    void uniformMat4(int uniform, const QMatrix4x4& m)   { push(Command::UNIFORM_MAT4, uniform, write(m.constData(), 16)); }
+
+    void uniformVec3Array(int uniform, const QVector3D* v, int count) {
+        int offset = payload.size();
+        for(int i = 0; i < count; i++) {
+            const float xyz[3] = {v[i].x(), v[i].y(), v[i].z()};
+            write(xyz, 3);
+        }
+        push(Command::UNIFORM_VEC3, uniform, offset, count);
+    }
+
+    /**
+     * @brief per draw data of the Object uniform block (see chess.vert), stride in floats
+     * layout std140: mat4 matrix, mat4 model, mat4 normalMatrix (mat3 in the upper left), int color
+     */
+    void object(const QMatrix4x4& matrix, const QMatrix4x4& model, const QMatrix3x3& normal, int color, int stride) {
+        int offset = blocks.size();
+        blocks.resize(offset + stride);
+        float* b = blocks.data() + offset;
+        std::copy(matrix.constData(), matrix.constData() + 16, b);
+        std::copy(model.constData(), model.constData() + 16, b + 16);
+        const float* n = normal.constData();
+        for(int c = 0; c < 3; c++)
+            for(int r = 0; r < 3; r++)
+                b[32 + 4*c + r] = n[3*c + r];
+        std::memcpy(b + 48, &color, sizeof(int));
+        push(Command::OBJECT, 0, offset);
+    }
+
+private:
+    void push(Command::Type type, int uniform, int a = 0, int b = 0, int c = 0) {
+        commands.append({type, (quint16)uniform, a, b, c});
+    }
+
+    int write(const float* data, int n) {
+        int offset = payload.size();
+        payload.resize(offset + n);
+        std::copy(data, data + n, payload.data() + offset);
+        return offset;
+    }
+};
+
+#endif // COMMANDLIST_H
@@ -0,0 +1,125 @@
+#include "dynamicresolution.h"
+
+#include <QDebug>
+#include <QLoggingCategory>
+
+#include <algorithm>
+#include <cmath>
+
+#include "utils.h"
+
+Q_LOGGING_CATEGORY(resolutionLog, "chess.resolution", QtInfoMsg)
+
+bool DynamicResolution::create(GLExtensions* ext)
+{
+    destroy();
+    this->ext = ext;
+    reset();
+    return ext->framebufferObject;
+}
+
+void DynamicResolution::destroy()
+{
+    if(!fbo)
+        return;
+
+    ext->DeleteFramebuffers(1, &fbo);
+    GLuint textures[] = {color, depth};
+    glDeleteTextures(2, textures);
+    fbo = color = depth = 0;
+    targetWidth = targetHeight = 0;
+}
+
+void DynamicResolution::setWindow(int width, int height)
+{
+    windowWidth = std::max(1, width);
+    windowHeight = std::max(1, height);
+}
+
+int DynamicResolution::width() const
+{
+    return std::max(1, (int) std::lround(windowWidth * myScale));
+}
+
+int DynamicResolution::height() const
+{
+    return std::max(1, (int) std::lround(windowHeight * myScale));
+}
+
+void DynamicResolution::control(double frameMs, double targetMs, float minScale)
+{
+    // decided on smoothed times, not before they had time to follow the last change
+    if(++frames < 30 || frameMs <= 0)
+        return;
+    frames = 0;
+
+    // dead band between 80 % and 100 % of the target
+    if(frameMs <= targetMs && frameMs >= 0.8 * targetMs)
+        return;
+
+    // pixels are scale^2, aim a bit under the target, at most 10 % per decision, steps of 5 %
+    float wanted = myScale * std::sqrt(0.9 * targetMs / frameMs);
+    wanted = clamp(wanted, myScale - 0.1f, myScale + 0.1f);
+    wanted = std::round(wanted * 20) / 20;
+    myScale = clamp(wanted, std::min(minScale, 1.f), 1.f);
+}
+
+bool DynamicResolution::prepare()
+{
+    if(!ext || !ext->framebufferObject)
+        return false;
+
+    int w = width(), h = height();
+    if(fbo && w == targetWidth && h == targetHeight)
+        return true;
+
+    if(!fbo) {
+        ext->GenFramebuffers(1, &fbo);
+        glGenTextures(1, &color);
+        glGenTextures(1, &depth);
+    }
+
+    // linear, it is stretched to the window
+    glBindTexture(GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindTexture(GL_TEXTURE_2D, depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, w, h, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    ext->BindFramebuffer(GL_FRAMEBUFFER, fbo);
+    ext->FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    ext->FramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+
+    if(ext->CheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        qDebug() << "dynamic resolution target incomplete at" << w << "x" << h;
+        destroy();
+        return false;
+    }
+
+    targetWidth = w;
+    targetHeight = h;
+    stats.resizes++;
+    return true;
+}
+
+void DynamicResolution::bindTexture(int unit)
+{
+    ext->ActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, color);
+    ext->ActiveTexture(GL_TEXTURE0);
+}
+
+void DynamicResolution::report()
+{
+    qCDebug(resolutionLog) << "dynamic resolution:" << width() << "x" << height()
+                           << "scale:" << myScale
+                           << "reallocations:" << stats.resizes;
+    stats = Stats();
+}
@@ -0,0 +1,60 @@
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include "glextensions.h"
+
+/**
+ * @brief offscreen target for the scene whose size follows the frame time
+ *
+ * The scene is drawn at scale * the window size, then stretched to the window by the caller.
+ * control() is fed the measured frame times and moves the scale toward the one that gives the target time,
+ * assuming the cost is proportional to the pixels. Changes are decided every few frames, in steps,
+ * with a dead band under the target so it doesn't reallocate back and forth.
+ */
+class DynamicResolution
+{
+public:
+    struct Stats {
+        int resizes = 0; // reallocations of the target
+    } stats;
+
+    bool create(GLExtensions* ext);
+    void destroy();
+
+    void setWindow(int width, int height);
+    float scale() const { return myScale; }
+    void reset() { myScale = 1; frames = 0; }
+
+    // size the scene is drawn at
+    int width() const;
+    int height() const;
+
+    /**
+     * @brief moves the scale toward the target, no GL
+     */
+    void control(double frameMs, double targetMs, float minScale);
+
+    /**
+     * @brief (re)allocates the target at the current size, false if there can't be one
+     */
+    bool prepare();
+
+    GLuint framebuffer() const { return fbo; }
+    void bindTexture(int unit);
+
+    /**
+     * @brief size, scale and reallocations since the last report, on chess.resolution (debug)
+     */
+    void report();
+
+private:
+    GLExtensions* ext = nullptr;
+    GLuint fbo = 0, color = 0, depth = 0;
+    int targetWidth = 0, targetHeight = 0; // allocated
+    int windowWidth = 1, windowHeight = 1;
+
+    float myScale = 1;
+    int frames = 0; // since the last decision
+};
+
+#endif // DYNAMICRESOLUTION_H
@@ -0,0 +1,77 @@
+#include "gbuffer.h"
+
+#include <QDebug>
+
+bool GBuffer::create(GLExtensions* ext, int width, int height)
+{
+    destroy();
+    this->ext = ext;
+
+    if(!ext->framebufferObject)
+        return false;
+
+    struct {
+        GLint internal;
+        GLenum format, type, attachment;
+    } formats[NTARGET + 1] = {
+        {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT0}, // ALBEDO
+        {GL_RG16F, GL_RG, GL_FLOAT, GL_COLOR_ATTACHMENT1}, // NORMAL
+        {GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_COLOR_ATTACHMENT2}, // EMISSIVE
+        {GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, GL_DEPTH_ATTACHMENT},
+    };
+
+    ext->GenFramebuffers(1, &fbo);
+    ext->BindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glGenTextures(NTARGET + 1, textures);
+
+    for(int i = 0; i < NTARGET + 1; i++) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, formats[i].internal, width, height, 0, formats[i].format, formats[i].type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        ext->FramebufferTexture2D(GL_FRAMEBUFFER, formats[i].attachment, GL_TEXTURE_2D, textures[i], 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLenum status = ext->CheckFramebufferStatus(GL_FRAMEBUFFER);
+    ext->BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        qDebug() << "G-buffer incomplete" << status;
+        destroy();
+        return false;
+    }
+
+    myWidth = width;
+    myHeight = height;
+    return true;
+}
+
+void GBuffer::destroy()
+{
+    if(!fbo)
+        return;
+
+    ext->DeleteFramebuffers(1, &fbo);
+    glDeleteTextures(NTARGET + 1, textures);
+    fbo = 0;
+    myWidth = myHeight = 0;
+}
+
+void GBuffer::bind()
+{
+    static const GLenum targets[NTARGET] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+    ext->BindFramebuffer(GL_FRAMEBUFFER, fbo);
+    ext->DrawBuffers(NTARGET, targets);
+}
+
+void GBuffer::bindTextures(int firstUnit)
+{
+    for(int i = 0; i < NTARGET + 1; i++) {
+        ext->ActiveTexture(GL_TEXTURE0 + firstUnit + i);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+    }
+    ext->ActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,39 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include "glextensions.h"
+
+/**
+ * @brief render targets of the deferred path
+ *
+ * albedo (rgb) and material id (a), octahedral normal (rg, half floats),
+ * emissive: everything that doesn't depend on the lights (ambient, cubemap reflection and refraction)
+ * and the depth, as a texture so the lighting passes can rebuild the positions.
+ */
+class GBuffer
+{
+public:
+    enum { ALBEDO, NORMAL, EMISSIVE, NTARGET };
+
+    bool create(GLExtensions* ext, int width, int height);
+    void destroy();
+
+    bool isCreated() const { return fbo != 0; }
+    int width() const { return myWidth; }
+    int height() const { return myHeight; }
+
+    void bind();
+
+    /**
+     * @brief albedo, normal, emissive and depth textures on 4 units from firstUnit
+     */
+    void bindTextures(int firstUnit);
+
+private:
+    GLExtensions* ext = nullptr;
+    GLuint fbo = 0;
+    GLuint textures[NTARGET + 1] = {}; // + depth
+    int myWidth = 0, myHeight = 0;
+};
+
+#endif // GBUFFER_H
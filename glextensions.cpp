@@ -0,0 +1,84 @@
+#include "glextensions.h"
+
+template <typename T>
+static bool resolveOne(QOpenGLContext* context, T& f, const char* name) {
+    f = reinterpret_cast<T>(context->getProcAddress(name));
+    return f != nullptr;
+}
+
+static bool hasVersion(QOpenGLContext* context, int major, int minor) {
+    QSurfaceFormat format = context->format();
+    return format.majorVersion() > major || (format.majorVersion() == major && format.minorVersion() >= minor);
+}
+
+void GLExtensions::resolve(QOpenGLContext* context)
+{
+    bool ok = true;
+    ok &= resolveOne(context, GenQueries, "glGenQueries");
+    ok &= resolveOne(context, DeleteQueries, "glDeleteQueries");
+    ok &= resolveOne(context, BeginQuery, "glBeginQuery");
+    ok &= resolveOne(context, EndQuery, "glEndQuery");
+    ok &= resolveOne(context, GetQueryObjectuiv, "glGetQueryObjectuiv");
+    occlusionQuery = ok;
+
+    ok = resolveOne(context, GetQueryObjectui64v, "glGetQueryObjectui64v");
+    ok &= resolveOne(context, QueryCounter, "glQueryCounter");
+    timerQuery = ok && occlusionQuery && (hasVersion(context, 3, 3) || context->hasExtension("GL_ARB_timer_query"));
+
+    ok = true;
+    ok &= resolveOne(context, GenBuffers, "glGenBuffers");
+    ok &= resolveOne(context, DeleteBuffers, "glDeleteBuffers");
+    ok &= resolveOne(context, BindBuffer, "glBindBuffer");
+    ok &= resolveOne(context, BufferData, "glBufferData");
+    ok &= resolveOne(context, BufferSubData, "glBufferSubData");
+    ok &= resolveOne(context, MapBufferRange, "glMapBufferRange");
+    ok &= resolveOne(context, UnmapBuffer, "glUnmapBuffer");
+    ok &= resolveOne(context, BindBufferRange, "glBindBufferRange");
+    ok &= resolveOne(context, GetUniformBlockIndex, "glGetUniformBlockIndex");
+    ok &= resolveOne(context, UniformBlockBinding, "glUniformBlockBinding");
+    uniformBufferObject = ok && (hasVersion(context, 3, 1) || context->hasExtension("GL_ARB_uniform_buffer_object"));
+
+    ok = true;
+    ok &= resolveOne(context, FenceSync, "glFenceSync");
+    ok &= resolveOne(context, ClientWaitSync, "glClientWaitSync");
+    ok &= resolveOne(context, DeleteSync, "glDeleteSync");
+    sync = ok && (hasVersion(context, 3, 2) || context->hasExtension("GL_ARB_sync"));
+
+    ok = resolveOne(context, BufferStorage, "glBufferStorage");
+    bufferStorage = ok && sync && (hasVersion(context, 4, 4) || context->hasExtension("GL_ARB_buffer_storage"));
+
+    ok = true;
+    ok &= resolveOne(context, TexBuffer, "glTexBuffer") || resolveOne(context, TexBuffer, "glTexBufferARB");
+    ok &= resolveOne(context, ActiveTexture, "glActiveTexture");
+    textureBufferObject = ok && (hasVersion(context, 3, 1) || context->hasExtension("GL_ARB_texture_buffer_object"));
+
+    ok = true;
+    ok &= resolveOne(context, GenFramebuffers, "glGenFramebuffers");
+    ok &= resolveOne(context, DeleteFramebuffers, "glDeleteFramebuffers");
+    ok &= resolveOne(context, BindFramebuffer, "glBindFramebuffer");
+    ok &= resolveOne(context, FramebufferTexture2D, "glFramebufferTexture2D");
+    ok &= resolveOne(context, CheckFramebufferStatus, "glCheckFramebufferStatus");
+    ok &= resolveOne(context, DrawBuffers, "glDrawBuffers");
+    ok &= resolveOne(context, BindFragDataLocation, "glBindFragDataLocation");
+    ok &= resolveOne(context, BlitFramebuffer, "glBlitFramebuffer");
+    ok &= resolveOne(context, GenRenderbuffers, "glGenRenderbuffers");
+    ok &= resolveOne(context, DeleteRenderbuffers, "glDeleteRenderbuffers");
+    ok &= resolveOne(context, BindRenderbuffer, "glBindRenderbuffer");
+    ok &= resolveOne(context, RenderbufferStorageMultisample, "glRenderbufferStorageMultisample");
+    ok &= resolveOne(context, FramebufferRenderbuffer, "glFramebufferRenderbuffer");
+    ok &= resolveOne(context, ActiveTexture, "glActiveTexture");
+    framebufferObject = ok && (hasVersion(context, 3, 0) || context->hasExtension("GL_ARB_framebuffer_object"));
+
+    ok = true;
+    ok &= resolveOne(context, DrawArraysInstanced, "glDrawArraysInstanced") || resolveOne(context, DrawArraysInstanced, "glDrawArraysInstancedARB");
+    ok &= resolveOne(context, DrawElementsInstanced, "glDrawElementsInstanced") || resolveOne(context, DrawElementsInstanced, "glDrawElementsInstancedARB");
+    ok &= resolveOne(context, VertexAttribDivisor, "glVertexAttribDivisor") || resolveOne(context, VertexAttribDivisor, "glVertexAttribDivisorARB");
+    instancing = ok && (hasVersion(context, 3, 3) || context->hasExtension("GL_ARB_instanced_arrays"));
+
+    ok = true;
+    ok &= resolveOne(context, GetProgramiv, "glGetProgramiv");
+    ok &= resolveOne(context, GetProgramBinary, "glGetProgramBinary");
+    ok &= resolveOne(context, ProgramBinary, "glProgramBinary");
+    ok &= resolveOne(context, ProgramParameteri, "glProgramParameteri");
+    programBinary = ok && (hasVersion(context, 4, 1) || context->hasExtension("GL_ARB_get_program_binary"));
+}
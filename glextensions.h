@@ -0,0 +1,87 @@
+#ifndef GLEXTENSIONS_H
+#define GLEXTENSIONS_H
+
+#include <QOpenGLContext>
+
+/**
+ * @brief OpenGL entry points that GL/gl.h doesn't give us (it stops at 1.3)
+ * resolved from the current context, nullptr when the driver doesn't have them.
+ */
+struct GLExtensions {
+    // occlusion queries (1.5)
+    PFNGLGENQUERIESPROC GenQueries = nullptr;
+    PFNGLDELETEQUERIESPROC DeleteQueries = nullptr;
+    PFNGLBEGINQUERYPROC BeginQuery = nullptr;
+    PFNGLENDQUERYPROC EndQuery = nullptr;
+    PFNGLGETQUERYOBJECTUIVPROC GetQueryObjectuiv = nullptr;
+
+    // timer queries (3.3, ARB_timer_query)
+    PFNGLGETQUERYOBJECTUI64VPROC GetQueryObjectui64v = nullptr;
+    PFNGLQUERYCOUNTERPROC QueryCounter = nullptr;
+
+    // buffers (1.5, 3.0)
+    PFNGLGENBUFFERSPROC GenBuffers = nullptr;
+    PFNGLDELETEBUFFERSPROC DeleteBuffers = nullptr;
+    PFNGLBINDBUFFERPROC BindBuffer = nullptr;
+    PFNGLBUFFERDATAPROC BufferData = nullptr;
+    PFNGLBUFFERSUBDATAPROC BufferSubData = nullptr;
+    PFNGLMAPBUFFERRANGEPROC MapBufferRange = nullptr;
+    PFNGLUNMAPBUFFERPROC UnmapBuffer = nullptr;
+
+    // uniform buffer objects (3.1, ARB_uniform_buffer_object)
+    PFNGLBINDBUFFERRANGEPROC BindBufferRange = nullptr;
+    PFNGLGETUNIFORMBLOCKINDEXPROC GetUniformBlockIndex = nullptr;
+    PFNGLUNIFORMBLOCKBINDINGPROC UniformBlockBinding = nullptr;
+
+    // fences (3.2, ARB_sync)
+    PFNGLFENCESYNCPROC FenceSync = nullptr;
+    PFNGLCLIENTWAITSYNCPROC ClientWaitSync = nullptr;
+    PFNGLDELETESYNCPROC DeleteSync = nullptr;
+
+    // immutable storage (4.4, ARB_buffer_storage)
+    PFNGLBUFFERSTORAGEPROC BufferStorage = nullptr;
+
+    // texture buffers (3.1, ARB_texture_buffer_object)
+    PFNGLTEXBUFFERPROC TexBuffer = nullptr;
+    PFNGLACTIVETEXTUREPROC ActiveTexture = nullptr;
+
+    // framebuffers (3.0, ARB_framebuffer_object)
+    PFNGLGENFRAMEBUFFERSPROC GenFramebuffers = nullptr;
+    PFNGLDELETEFRAMEBUFFERSPROC DeleteFramebuffers = nullptr;
+    PFNGLBINDFRAMEBUFFERPROC BindFramebuffer = nullptr;
+    PFNGLFRAMEBUFFERTEXTURE2DPROC FramebufferTexture2D = nullptr;
+    PFNGLCHECKFRAMEBUFFERSTATUSPROC CheckFramebufferStatus = nullptr;
+    PFNGLDRAWBUFFERSPROC DrawBuffers = nullptr;
+    PFNGLBINDFRAGDATALOCATIONPROC BindFragDataLocation = nullptr;
+    PFNGLBLITFRAMEBUFFERPROC BlitFramebuffer = nullptr;
+    PFNGLGENRENDERBUFFERSPROC GenRenderbuffers = nullptr;
+    PFNGLDELETERENDERBUFFERSPROC DeleteRenderbuffers = nullptr;
+    PFNGLBINDRENDERBUFFERPROC BindRenderbuffer = nullptr;
+    PFNGLRENDERBUFFERSTORAGEMULTISAMPLEPROC RenderbufferStorageMultisample = nullptr;
+    PFNGLFRAMEBUFFERRENDERBUFFERPROC FramebufferRenderbuffer = nullptr;
+
+    // instancing (3.3, ARB_draw_instanced and ARB_instanced_arrays)
+    PFNGLDRAWARRAYSINSTANCEDPROC DrawArraysInstanced = nullptr;
+    PFNGLDRAWELEMENTSINSTANCEDPROC DrawElementsInstanced = nullptr;
+    PFNGLVERTEXATTRIBDIVISORPROC VertexAttribDivisor = nullptr;
+
+    // program binaries (4.1, ARB_get_program_binary)
+    PFNGLGETPROGRAMIVPROC GetProgramiv = nullptr;
+    PFNGLGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+    PFNGLPROGRAMBINARYPROC ProgramBinary = nullptr;
+    PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+
+    bool occlusionQuery = false;
+    bool timerQuery = false;
+    bool uniformBufferObject = false;
+    bool sync = false;
+    bool bufferStorage = false;
+    bool textureBufferObject = false;
+    bool framebufferObject = false;
+    bool programBinary = false;
+    bool instancing = false;
+
+    void resolve(QOpenGLContext* context);
+};
+
+#endif // GLEXTENSIONS_H
@@ -5,33 +5,185 @@
 #include <iostream>
 
 #include <QOpenGLContext>
+#include <QApplication>
 #include <QTimer>
 
-#include <QOpenGLPaintDevice>
-#include <QPainter>
+int MyGLDrawer::swapInterval = 1;
+bool MyGLDrawer::legacySurface = false;
+bool MyGLDrawer::softwareSurface = false;
 
-MyGLDrawer::MyGLDrawer(QWidget *parent)
-    : QGLWidget(parent),
-      scene(new Scene())
+GLWindow::GLWindow(MyGLDrawer* drawer)
+    : drawer(drawer)
 {
-    QGLFormat format;
-    format.setDepthBufferSize(24);
-    // format.setMajorVersion(3);
-    // format.setMinorVersion(0);
-    format.setSamples(4);
-    // format.setProfile(QSurfaceFormat::CoreProfile);
+    setSurfaceType(QWindow::OpenGLSurface);
+}
 
-    context()->setFormat(format);
-    context()->create();
+void GLWindow::exposeEvent(QExposeEvent *) {
+    drawer->requestFrame(); // shown or hidden, the drawer looks at isExposed
+}
 
-    printContextInfos();
-    resize(1000, 700);
+void GLWindow::resizeEvent(QResizeEvent *ev) {
+    // the viewport is in device pixels
+    drawer->resizeScene(ev->size().width() * devicePixelRatio(), ev->size().height() * devicePixelRatio());
+}
+
+void GLWindow::mouseMoveEvent(QMouseEvent *ev) {
+    drawer->handleMouseMove(ev);
+}
+
+void GLWindow::mousePressEvent(QMouseEvent *ev) {
+    drawer->handleMousePress(ev);
+}
 
-    QTimer *timer = new QTimer(this);
-    connect(timer, SIGNAL(timeout()), this, SLOT(updateScene()));
-    timer->start(20);
+void GLWindow::mouseReleaseEvent(QMouseEvent *ev) {
+    drawer->handleMouseRelease(ev);
+}
 
+void GLWindow::wheelEvent(QWheelEvent *ev) {
+    drawer->handleWheel(ev);
+}
+
+LegacyGLWidget::LegacyGLWidget(MyGLDrawer* drawer, const QGLFormat& format)
+    : QGLWidget(format, drawer),
+      drawer(drawer)
+{
     setAutoFillBackground(false);
+    setMouseTracking(true); // the moves without a button, for the picking
+}
+
+void LegacyGLWidget::initializeGL() {
+    drawer->initializeScene();
+}
+
+void LegacyGLWidget::resizeGL(int w, int h) {
+    drawer->resizeScene(w, h);
+}
+
+void LegacyGLWidget::paintGL() {
+    drawer->paintScene();
+    drawer->frameSwapped(); // swapped when paintGL returns
+}
+
+void LegacyGLWidget::mouseMoveEvent(QMouseEvent *ev) {
+    drawer->handleMouseMove(ev);
+}
+
+void LegacyGLWidget::mousePressEvent(QMouseEvent *ev) {
+    drawer->handleMousePress(ev);
+}
+
+void LegacyGLWidget::mouseReleaseEvent(QMouseEvent *ev) {
+    drawer->handleMouseRelease(ev);
+}
+
+void LegacyGLWidget::wheelEvent(QWheelEvent *ev) {
+    drawer->handleWheel(ev);
+}
+
+SoftwareWidget::SoftwareWidget(MyGLDrawer* drawer)
+    : QWidget(drawer),
+      drawer(drawer)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent); // the image covers the whole widget
+    setMouseTracking(true);
+}
+
+void SoftwareWidget::paintEvent(QPaintEvent *) {
+    drawer->paintScene();
+    QPainter painter(this);
+    painter.drawImage(rect(), drawer->getScene()->softwareImage());
+    drawer->frameSwapped();
+}
+
+void SoftwareWidget::resizeEvent(QResizeEvent *ev) {
+    drawer->resizeScene(ev->size().width(), ev->size().height());
+}
+
+void SoftwareWidget::mouseMoveEvent(QMouseEvent *ev) {
+    drawer->handleMouseMove(ev);
+}
+
+void SoftwareWidget::mousePressEvent(QMouseEvent *ev) {
+    drawer->handleMousePress(ev);
+}
+
+void SoftwareWidget::mouseReleaseEvent(QMouseEvent *ev) {
+    drawer->handleMouseRelease(ev);
+}
+
+void SoftwareWidget::wheelEvent(QWheelEvent *ev) {
+    drawer->handleWheel(ev);
+}
+
+MyGLDrawer::MyGLDrawer(QWidget *parent)
+    : QWidget(parent),
+      scene(new Scene())
+{
+    // no samples on the surface, the scene draws in its own anti-aliased target (see AntiAliasing), MSAA 4x by default
+    if(softwareSurface) {
+        software = new SoftwareWidget(this);
+        surface = software;
+        scene->initializeSoftware();
+    } else if(legacySurface) {
+        QGLFormat format;
+        format.setDepthBufferSize(24);
+        format.setAlpha(true); // rgba8 like the multisampled target of the scene
+        format.setSwapInterval(swapInterval);
+        legacy = new LegacyGLWidget(this, format);
+        surface = legacy;
+    } else {
+        QSurfaceFormat format;
+        format.setDepthBufferSize(24);
+        format.setAlphaBufferSize(8); // rgba8 like the multisampled target of the scene
+        format.setSwapInterval(swapInterval);
+        window = new GLWindow(this);
+        window->setFormat(format);
+        surface = QWidget::createWindowContainer(window, this);
+
+        // created here, then current on the render thread only
+        context.reset(new QOpenGLContext());
+        context->setFormat(format);
+        if(!context->create())
+            qCritical() << "the GL context can't be created";
+        renderer.reset(new RenderThread(window, context.data()));
+        context->moveToThread(renderer.data());
+        renderer->initialize = [this](){ initializeScene(); };
+        renderer->apply = [this](){ applyEdits(); };
+        renderer->paint = [this](){ paintScene(); };
+        renderer->swapped = [this](){
+            frameSwapped();
+            return continueFrames();
+        };
+        renderer->cleanup = [this](){
+            scene.reset(); // its GL objects, while the context is current
+        };
+    }
+
+    resize(1000, 700);
+    clock.start();
+
+    // no timer: each swap requests the next frame while the scene animates, the simulation wakes the loop when it resumes
+    connect(&scene->simulation, &Simulation::resumed, this, &MyGLDrawer::requestFrame, Qt::QueuedConnection);
+    connect(this, &MyGLDrawer::frameWanted, this, &MyGLDrawer::requestFrame, Qt::QueuedConnection);
+    connect(&scene->simulation, &Simulation::over, this, [](){
+        QApplication::quit(); // the threads stop with the drawer
+    }, Qt::QueuedConnection);
+
+    occludedTimer = new QTimer(this);
+    occludedTimer->setInterval(OCCLUDED_INTERVAL_MS);
+    connect(occludedTimer, &QTimer::timeout, [this](){
+        pollOccluded();
+    });
+}
+
+MyGLDrawer::~MyGLDrawer()
+{
+    if(renderer) {
+        renderer->stop(); // the scene is gone with its context, see cleanup
+    } else if(legacy) {
+        legacy->makeCurrent(); // for the GL objects of the scene
+        scene.reset();
+    }
 }
 
 void MyGLDrawer::infoGL()
@@ -48,63 +200,221 @@ void MyGLDrawer::infoGL()
     Scene::glCheckError();
 }
 
-void MyGLDrawer::printContextInfos() {
-    QGLContext* mContext = context();
+void MyGLDrawer::initializeScene() {
+    QSurfaceFormat format = QOpenGLContext::currentContext()->format();
+    std::cout << "Context format version is: "
+              << format.majorVersion() << "." << format.minorVersion()
+              << ", swap interval " << format.swapInterval()
+              << ", " << surfaceName() << std::endl;
+    infoGL();
 
-    if(!mContext->isValid())
-        std::cerr << "The OpenGL context is invalid!" << std::endl;
+    scene->initialize();
+}
 
-    std::cout << "Window format version is: "
-              << format().majorVersion() << "."
-              << format().minorVersion() << std::endl;
+void MyGLDrawer::resizeScene(int w, int h) {
+    post([this, w, h](){
+        scene->resize(w, h);
+    });
+    requestFrame();
+}
 
-    std::cout << "Context format version is: "
-              << mContext->format().majorVersion()
-              << "." << mContext->format().minorVersion() << std::endl;
-    makeCurrent();
-    infoGL();
+void MyGLDrawer::resizeEvent(QResizeEvent *ev) {
+    surface->resize(ev->size());
 }
 
-void MyGLDrawer::initializeGL() {
-    context()->makeCurrent();
-    scene->initialize();
+void MyGLDrawer::post(std::function<void()> edit)
+{
+    if(!renderer) {
+        edit(); // one thread, nothing to hand over
+        return;
+    }
+
+    // full: the render thread is in a long frame, it drains the queue before the next one
+    while(!edits.push(edit)) {
+        if(!renderer->isRunning()) {
+            applyEdits(); // not started, or stopped: the scene is this thread's, nothing else drains them
+            continue;
+        }
+        renderer->wake();
+        QThread::yieldCurrentThread();
+    }
+    renderer->wake();
 }
 
-void MyGLDrawer::paintGL() {
-    scene->render();
+void MyGLDrawer::applyEdits()
+{
+    std::function<void()> edit;
+    while(edits.pop(edit))
+        edit();
+}
+
+const MyGLDrawer::Status& MyGLDrawer::status()
+{
+    statuses.fetch();
+    return statuses.front();
+}
+
+void MyGLDrawer::advance()
+{
+    // the edits and the input of the frame
+    applyEdits();
+    if(!orbit.isNull())
+        scene->applyDelta(orbit);
+    if(!pan.isNull())
+        scene->applyMove(pan);
+    orbit = pan = QPointF();
+    if(hoverPending)
+        scene->hover(hoverPos);
+    hoverPending = false;
+
+    // the simulation steps on its own thread, the frame blends its two latest snapshots
+    scene->interpolate();
+}
+
+void MyGLDrawer::requestFrame()
+{
+    // hidden, minimized or covered: the simulation goes on by itself, the frames wait until the surface shows again
+    bool shown = surfaceVisible();
+    visible.store(shown);
+    if(!shown) {
+        if(!occludedTimer->isActive())
+            occludedTimer->start();
+        return;
+    }
+    occludedTimer->stop();
+
+    // the latency is counted from the first request of a frame
+    requestedNs.testAndSetOrdered(-1, clock.nsecsElapsed());
+
+    if(window) {
+        // coalesced, painted and swapped by the render thread; it starts once the window can be drawn
+        if(!renderer->isRunning() && !renderer->isFinished())
+            renderer->start();
+        renderer->request();
+    } else if(legacy) {
+        legacy->update(); // coalesced too, paintGL tells the swap
+    } else {
+        software->update(); // coalesced like the window
+    }
+}
+
+void MyGLDrawer::scheduleNext()
+{
+    // else the same picture until an input, a parameter or the simulation resumes
+    if(scene->isAnimating())
+        requestFrame();
+}
+
+bool MyGLDrawer::continueFrames()
+{
+    // the render thread goes on by itself, paced by the swap, without a round trip through the gui
+    if(!scene->isAnimating())
+        return false;
+    if(visible.load())
+        return true;
+    emit frameWanted(); // the gui polls the surface until it shows again
+    return false;
+}
+
+void MyGLDrawer::pollOccluded()
+{
+    requestFrame(); // stops the timer once the surface shows again
+}
+
+bool MyGLDrawer::surfaceVisible() const
+{
+    if(QWidget::window()->isMinimized() || !isVisible())
+        return false;
+    if(window)
+        return window->isExposed();
+    return !surface->visibleRegion().isEmpty();
 }
 
-void MyGLDrawer::paintEvent(QPaintEvent * ev) {
-    QGLWidget::paintEvent(ev);
+const char* MyGLDrawer::surfaceName() const
+{
+    return window ? "QWindow on a render thread" : legacy ? "QGLWidget" : "software";
 }
 
-void MyGLDrawer::resizeGL(int w, int h) {
-    context()->makeCurrent();
-    scene->resize(w, h);
+void MyGLDrawer::paintScene()
+{
+    QElapsedTimer timer;
+    timer.start();
+    advance();
+    scene->render();
+    publishStatus();
+
+    const double k = 0.05;
+    times.paintMs += k * (timer.nsecsElapsed() / 1e6 - times.paintMs);
 }
 
-float MyGLDrawer::currentTime() {
-    return tick * 20.0 / 1000.0;
+void MyGLDrawer::publishStatus()
+{
+    Status& s = statuses.back();
+    s.times = scene->frameTimes();
+    s.lowered = scene->qualityGovernor ? scene->loweredQuality() : QString();
+    s.length = scene->length;
+    s.angleOnGround = scene->angleOnGround;
+    s.angleFromUp = scene->angleFromUp;
+    s.lookAt = scene->lookAt;
+    statuses.publish();
+
+    // the sliders of the camera follow it, once the frame is drawn
+    if(cameraMoved) {
+        cameraMoved = false;
+        emit paramChanged();
+    }
 }
 
-void MyGLDrawer::updateScene()
+void MyGLDrawer::frameSwapped()
 {
-    scene->update(currentTime());
-    tick++;
-    updateGL();
+    const double k = 0.05;
+    std::clock_t cpu = std::clock(); // of the process, what the paint doesn't count: the swap, the composition
+    if(swapCpu >= 0)
+        times.processCpuMs += k * ((cpu - swapCpu) * 1000.0 / CLOCKS_PER_SEC - times.processCpuMs);
+    swapCpu = cpu;
+
+    qint64 requested = requestedNs.fetchAndStoreOrdered(-1);
+    if(requested >= 0) {
+        times.presentMs += k * ((clock.nsecsElapsed() - requested) / 1e6 - times.presentMs);
+
+        if(++times.frames % 250 == 0)
+            qDebug() << "surface:" << surfaceName()
+                     << "swap interval" << swapInterval
+                     << "paint" << times.paintMs << "ms cpu,"
+                     << "process" << times.processCpuMs << "ms cpu per frame,"
+                     << "request to swap" << times.presentMs << "ms";
+    }
+
+    // the next frame, paced by the swap; the widgets are still in their paint event, so after it
+    if(!renderer)
+        QTimer::singleShot(0, this, [this](){ scheduleNext(); });
 }
 
-void MyGLDrawer::mouseMoveEvent(QMouseEvent *ev) {
+void MyGLDrawer::handleMouseMove(QMouseEvent *ev) {
+    // kept for the next frame, however many events come before it
+    if(ev->buttons() == Qt::NoButton) {
+        // what is under the mouse, for the hud; the events are in logical pixels, the scene in the ones of its viewport
+        QPointF pos = QPointF(ev->pos()) * (window ? window->devicePixelRatio() : legacy ? legacy->devicePixelRatio() : 1);
+        post([this, pos](){
+            hoverPos = pos;
+            hoverPending = true;
+        });
+    }
+
     if(ev->buttons() & Qt::LeftButton) {
         QPointF delta = ev->pos() - lastPosL;
-        scene->applyDelta(delta);
         lastPosL = ev->pos();
+        post([this, delta](){
+            orbit += delta;
+        });
     }
 
     if(ev->buttons() & Qt::RightButton) {
         QPointF delta = ev->pos() - lastPosR;
-        scene->applyMove(delta);
         lastPosR = ev->pos();
+        post([this, delta](){
+            pan += delta;
+        });
     }
 
 
@@ -116,28 +426,31 @@ void MyGLDrawer::mouseMoveEvent(QMouseEvent *ev) {
         */
     }
 
-    updateGL();
+    requestFrame();
 }
 
-void MyGLDrawer::mousePressEvent(QMouseEvent *ev) {
+void MyGLDrawer::handleMousePress(QMouseEvent *ev) {
     if(ev->button() == Qt::LeftButton)
         lastPosL = ev->pos();
     if(ev->button() == Qt::RightButton)
         lastPosR = ev->pos();
     if(ev->button() == Qt::MiddleButton)
         lastPosM = ev->pos();
-    updateGL();
+    requestFrame();
 }
 
-void MyGLDrawer::mouseReleaseEvent(QMouseEvent *ev) {
-    emit paramChanged();
-}
-
-void MyGLDrawer::keyPressEvent(QKeyEvent *ev) {
-
+void MyGLDrawer::handleMouseRelease(QMouseEvent *ev) {
+    post([this](){
+        cameraMoved = true;
+    });
+    requestFrame();
 }
 
-void MyGLDrawer::wheelEvent(QWheelEvent * ev) {
-    scene->applyZoom(ev->delta() / 120.0);
-    emit paramChanged();
+void MyGLDrawer::handleWheel(QWheelEvent * ev) {
+    float zoom = ev->delta() / 120.0;
+    post([this, zoom](){
+        scene->applyZoom(zoom);
+        cameraMoved = true;
+    });
+    requestFrame();
 }
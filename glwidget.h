@@ -7,49 +7,224 @@
 #include <QMouseEvent>
 #include <QKeyEvent>
 #include <QWheelEvent>
+#include <QResizeEvent>
+#include <QElapsedTimer>
 #include <QtGui>
 
-// My version beign 5.2, there is no QOpenGLWidget
+#include <QOpenGLContext>
+
+#include <functional>
+#include <ctime>
+
+#include "renderthread.h"
+#include "spscqueue.h"
+#include "triplebuffer.h"
+
+// the old surface, kept to compare against (--qglwidget)
 #include <QGLWidget>
 
 #include <QMainWindow>
 
-class MyGLDrawer : public QGLWidget
+class MyGLDrawer;
+
+/**
+ * @brief the GL surface, a window of its own embedded in the widgets with createWindowContainer
+ *
+ * The scene redraws the whole frame, so the window is drawn straight to its back buffer and presented by the swap,
+ * without the extra framebuffer and the copy to the backing store that QGLWidget and QOpenGLWidget go through
+ * when they are composed with the other widgets. The frames are drawn by the RenderThread of the drawer,
+ * the window only passes its events.
+ */
+class GLWindow : public QWindow
 {
     Q_OBJECT
 
 public:
-    MyGLDrawer(QWidget *parent = nullptr);
+    GLWindow(MyGLDrawer* drawer);
 
-    Scene* getScene() { return scene.data(); }
+protected:
+    void exposeEvent(QExposeEvent *) override;
+    void resizeEvent(QResizeEvent *) override;
+
+    void mouseMoveEvent(QMouseEvent *) override;
+    void mousePressEvent(QMouseEvent *) override;
+    void mouseReleaseEvent(QMouseEvent *) override;
+    void wheelEvent(QWheelEvent *) override;
+
+private:
+    MyGLDrawer* drawer;
+};
+
+/**
+ * @brief the surface before GLWindow, painted synchronously by updateGL
+ */
+class LegacyGLWidget : public QGLWidget
+{
+    Q_OBJECT
+
+public:
+    LegacyGLWidget(MyGLDrawer* drawer, const QGLFormat& format);
 
-signals:
-    void paramChanged();
 protected:
     void initializeGL() override;
     void resizeGL(int w, int h) override;
     void paintGL() override;
 
-    void printContextInfos();
+    void mouseMoveEvent(QMouseEvent *) override;
+    void mousePressEvent(QMouseEvent *) override;
+    void mouseReleaseEvent(QMouseEvent *) override;
+    void wheelEvent(QWheelEvent *) override;
+
+private:
+    MyGLDrawer* drawer;
+};
+
+/**
+ * @brief no GL at all, paints the image of the software rasterizer (--software)
+ */
+class SoftwareWidget : public QWidget
+{
+    Q_OBJECT
 
-protected slots:
-    void updateScene();
+public:
+    SoftwareWidget(MyGLDrawer* drawer);
 
 protected:
+    void paintEvent(QPaintEvent *) override;
+    void resizeEvent(QResizeEvent *) override;
+
     void mouseMoveEvent(QMouseEvent *) override;
     void mousePressEvent(QMouseEvent *) override;
     void mouseReleaseEvent(QMouseEvent *) override;
-    void keyPressEvent(QKeyEvent *) override;
     void wheelEvent(QWheelEvent *) override;
 
-    void paintEvent(QPaintEvent *) override;
+private:
+    MyGLDrawer* drawer;
+};
+
+/**
+ * @brief the scene and the mouse, whatever the surface that draws it
+ *
+ * With GLWindow the scene belongs to a RenderThread: the gui thread doesn't touch it, it posts edits
+ * (the parameters of the panel, the mouse) through a lock-free queue applied before the next frame,
+ * and reads back the Status published after each frame. The other surfaces draw on the gui thread, the edits apply at once.
+ */
+class MyGLDrawer : public QWidget
+{
+    Q_OBJECT
 
 public:
-    float currentTime();
+    MyGLDrawer(QWidget *parent = nullptr);
+    ~MyGLDrawer(); // stops the render thread
+
+    /**
+     * @brief the fields are read at the construction only, then changed by post (see Parameters for the simulation ones)
+     */
+    Scene* getScene() { return scene.data(); }
+
+    /**
+     * @brief gui thread: runs the edit on the thread of the frames, before the next one, in the order of the posts
+     */
+    void post(std::function<void()> edit);
+
+    /**
+     * @brief what the panel shows of the scene, published after each frame
+     */
+    struct Status {
+        Scene::FrameTimes times;
+        QString lowered; // Scene::loweredQuality, while the governor is on
+        float length = 0, angleOnGround = 0, angleFromUp = 0; // the camera, moved by the mouse
+        QVector3D lookAt;
+    };
+
+    /**
+     * @brief gui thread, the latest
+     */
+    const Status& status();
+
+    // before the drawer is created, from the command line
+    static int swapInterval; // 0 doesn't wait for the vertical blank
+    static bool legacySurface; // QGLWidget instead of GLWindow
+    static bool softwareSurface; // SoftwareWidget, the scene is drawn on the cpu
+
+    /**
+     * @brief smoothed, printed every few hundred frames to compare the surfaces and the swap intervals
+     */
+    struct SurfaceTimes {
+        double paintMs = 0; // cpu of the paint
+        double presentMs = 0; // from the request of the frame to its swap
+        double processCpuMs = 0; // cpu of the whole process between two swaps, all the threads and the composition
+        qint64 frames = 0;
+    };
+    const SurfaceTimes& surfaceTimes() const { return times; } // thread of the frames
+
+    enum { OCCLUDED_INTERVAL_MS = 100 }; // polls of the visibility while the surface can't be seen
+    enum { MAX_EDITS = 1024 }; // posted and not applied yet, past it the gui waits for the render thread
+
+    /**
+     * @brief something changed (the input, a parameter): draws the next frame, coalesced with the other requests.
+     * The frames go on by themselves while the scene animates, else they stop until the next request.
+     */
+    void requestFrame();
+
+signals:
+    void paramChanged(); // the camera moved with the mouse, emitted after the frame that shows it, see status
+    void frameWanted(); // by the render thread: the scene animates behind a hidden surface
+
+protected:
+    void resizeEvent(QResizeEvent *) override;
+
+public:
+    // called by the surface, on the thread of the frames
+    void initializeScene();
+    void resizeScene(int w, int h);
+    void paintScene();
+    void frameSwapped();
+
+    // gui thread
+    void handleMouseMove(QMouseEvent *);
+    void handleMousePress(QMouseEvent *);
+    void handleMouseRelease(QMouseEvent *);
+    void handleWheel(QWheelEvent *);
+
 private:
     QScopedPointer<Scene> scene;
-    int tick = 0;
+    GLWindow* window = nullptr;
+    LegacyGLWidget* legacy = nullptr;
+    SoftwareWidget* software = nullptr;
+    QWidget* surface = nullptr; // the container of the window or the legacy widget
+
+    // the window only
+    QScopedPointer<QOpenGLContext> context;
+    QScopedPointer<RenderThread> renderer;
+    SpscQueue<std::function<void()>, MAX_EDITS> edits;
+    TripleBuffer<Status> statuses;
+
+    // gui thread
     QPointF lastPosL, lastPosR, lastPosM;
+    QTimer* occludedTimer;
+
+    // thread of the frames: the input since the last frame, applied all at once before it
+    QPointF orbit, pan;
+    QPointF hoverPos;
+    bool hoverPending = false;
+    bool cameraMoved = false;
+    SurfaceTimes times;
+    std::clock_t swapCpu = -1; // of the process at the last swap
+
+    // both
+    QElapsedTimer clock;
+    QAtomicInteger<qint64> requestedNs {-1}; // on the clock, of the first request of the frame not swapped yet
+    QAtomicInt visible {0}; // the surface, as the gui saw it at the last request
+
+    void applyEdits();
+    void advance();
+    void publishStatus();
+    void scheduleNext();
+    bool continueFrames();
+    void pollOccluded();
+    bool surfaceVisible() const;
+    const char* surfaceName() const;
 
     static void infoGL();
 };
@@ -0,0 +1,51 @@
+#include "gputimer.h"
+
+void GpuTimer::create(GLExtensions* ext)
+{
+    destroy();
+    this->ext = ext;
+    if(ext->timerQuery)
+        ext->GenQueries(2, queries);
+}
+
+void GpuTimer::destroy()
+{
+    if(queries[0])
+        ext->DeleteQueries(2, queries);
+    queries[0] = queries[1] = 0;
+    running = pending = false;
+}
+
+void GpuTimer::begin()
+{
+    running = queries[0] && !pending;
+    if(running)
+        ext->QueryCounter(queries[0], GL_TIMESTAMP);
+}
+
+void GpuTimer::end()
+{
+    if(!running)
+        return;
+    ext->QueryCounter(queries[1], GL_TIMESTAMP);
+    running = false;
+    pending = true;
+}
+
+bool GpuTimer::collect()
+{
+    if(!pending)
+        return false;
+
+    GLuint available = 0;
+    ext->GetQueryObjectuiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if(!available)
+        return false;
+
+    GLuint64 t0 = 0, t1 = 0;
+    ext->GetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &t0);
+    ext->GetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &t1);
+    pending = false;
+    lastNs = t1 - t0;
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include "glextensions.h"
+
+/**
+ * @brief gpu time of a part of the frame, between two timestamp queries
+ *
+ * Unlike GL_TIME_ELAPSED, timestamps can be taken inside the query of the whole frame.
+ * The result is read back when it is ready, a new measure only starts once the previous one has been read.
+ */
+class GpuTimer
+{
+public:
+    void create(GLExtensions* ext);
+    void destroy();
+
+    void begin();
+    void end();
+
+    /**
+     * @brief true when a new measure has been read, never waits
+     */
+    bool collect();
+
+    qint64 ns() const { return lastNs; }
+
+private:
+    GLExtensions* ext = nullptr;
+    GLuint queries[2] = {};
+    bool running = false; // this frame
+    bool pending = false;
+    qint64 lastNs = 0;
+};
+
+#endif // GPUTIMER_H
@@ -0,0 +1,47 @@
+#include "hud.h"
+
+#include "utils.h"
+
+HUD::HUD()
+{
+    auto add = [this](char c, const QVector<QVector2D>& glyph) {
+        first[(int) c] = segments.size();
+        count[(int) c] = glyph.size();
+        segments += glyph;
+    };
+
+    // 26 letters then 10 digits
+    QVector<QVector<QVector2D>> letters = makeLetters();
+    for(int i = 0; i < 26; i++)
+        add('A' + i, letters[i]);
+    for(int i = 0; i < 10; i++)
+        add('0' + i, letters[26 + i]);
+
+    // what the stats need beyond them
+    add('.', {{0.4f, 1}, {0.6f, 1}});
+    add(':', {{0.5f, 0.2f}, {0.5f, 0.35f}, {0.5f, 0.65f}, {0.5f, 0.8f}});
+    add('-', {{0, 0.5f}, {1, 0.5f}});
+    add('/', {{0, 1}, {1, 0}});
+    add('%', {{0, 1}, {1, 0}, {0, 0}, {0.2f, 0.2f}, {0.8f, 0.8f}, {1, 1}});
+    add('+', {{0, 0.5f}, {1, 0.5f}, {0.5f, 0.2f}, {0.5f, 0.8f}});
+}
+
+float HUD::width(const QString& s, float size) const
+{
+    // letters are 0.6 as wide as high, with a gap of 0.3
+    return s.size() * 0.9f * size;
+}
+
+void HUD::text(const QString& s, float x, float y, float size, QVector3D color)
+{
+    for(QChar qc : s.toUpper()) {
+        int c = qc.toLatin1();
+        if(c > 0 && c < 128) {
+            for(int i = first[c]; i < first[c] + count[c]; i++) {
+                const QVector2D& p = segments[i];
+                data << x + p.x() * 0.6f * size << y + p.y() * size << color.x() << color.y() << color.z();
+            }
+        }
+        x += 0.9f * size;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <QVector>
+#include <QVector2D>
+#include <QVector3D>
+#include <QString>
+
+/**
+ * @brief text over the scene with the 15-segment letters of makeLetters
+ *
+ * The segments of every glyph are built once. Each frame the texts are appended as colored
+ * line segments in window pixels (y down) to one vertex array, that the scene uploads and draws
+ * with a single GL_LINES call. No GL here.
+ */
+class HUD
+{
+public:
+    HUD();
+
+    void clear() { data.clear(); }
+
+    /**
+     * @brief s from its top left corner, size is the height of a letter in pixels,
+     * letters, digits, space and . : - / %
+     */
+    void text(const QString& s, float x, float y, float size, QVector3D color);
+    float width(const QString& s, float size) const;
+
+    const QVector<float>& vertices() const { return data; } // x y r g b
+    int vertexCount() const { return data.size() / FLOATS; }
+
+    enum { FLOATS = 5 };
+
+private:
+    QVector<QVector2D> segments; // all the glyphs, 2 points per segment in a 1 x 1 box, y down
+    int first[128] = {}, count[128] = {}; // ascii, in segments
+    QVector<float> data;
+};
+
+#endif // HUD_H
@@ -0,0 +1,210 @@
+#include "lightclusters.h"
+
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <QDebug>
+#include <QLoggingCategory>
+
+#include <algorithm>
+#include <cmath>
+
+#include "utils.h"
+
+using std::min;
+
+Q_LOGGING_CATEGORY(clusterLog, "chess.clusters", QtInfoMsg)
+using std::max;
+
+bool LightClusters::create(GLExtensions* ext)
+{
+    destroy();
+    this->ext = ext;
+
+    if(!ext->textureBufferObject)
+        return false;
+
+    ext->GenBuffers(1, &lightsBuffer);
+    ext->GenBuffers(1, &itemsBuffer);
+    glGenTextures(1, &lightsTexture);
+    glGenTextures(1, &itemsTexture);
+
+    // 2 texels per light: position radius, color
+    ext->BindBuffer(GL_TEXTURE_BUFFER, lightsBuffer);
+    ext->BufferData(GL_TEXTURE_BUFFER, 8 * sizeof(float), nullptr, GL_STREAM_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, lightsTexture);
+    ext->TexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightsBuffer);
+
+    ext->BindBuffer(GL_TEXTURE_BUFFER, itemsBuffer);
+    ext->BufferData(GL_TEXTURE_BUFFER, 2 * COUNT * sizeof(quint32), nullptr, GL_STREAM_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, itemsTexture);
+    ext->TexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, itemsBuffer);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    ext->BindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    items.fill(0, 2 * COUNT);
+    slices.resize(Z);
+
+    qDebug() << "light clusters:" << X << "x" << Y << "x" << Z;
+    return true;
+}
+
+void LightClusters::destroy()
+{
+    if(!itemsBuffer)
+        return;
+
+    GLuint buffers[] = {lightsBuffer, itemsBuffer}, textures[] = {lightsTexture, itemsTexture};
+    ext->DeleteBuffers(2, buffers);
+    glDeleteTextures(2, textures);
+    lightsBuffer = itemsBuffer = 0;
+    lightsTexture = itemsTexture = 0;
+}
+
+void LightClusters::build(const PointLights& lights, const QMatrix4x4& view, const QMatrix4x4& projection, float zNear, float zFar)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const int n = lights.size();
+    x0.resize(n); x1.resize(n);
+    y0.resize(n); y1.resize(n);
+    z0.resize(n); z1.resize(n);
+
+    // to view space, straight loops on plain arrays so the compiler can vectorize them
+    QVector<float> vxs(n), vys(n), ds(n);
+    const float* m = view.constData(); // column major
+    const float *x = lights.x.constData(), *y = lights.y.constData(), *z = lights.z.constData();
+    float *vx = vxs.data(), *vy = vys.data(), *d = ds.data();
+    for(int i = 0; i < n; i++) {
+        vx[i] = m[0] * x[i] + m[4] * y[i] + m[8] * z[i] + m[12];
+        vy[i] = m[1] * x[i] + m[5] * y[i] + m[9] * z[i] + m[13];
+        d[i] = -(m[2] * x[i] + m[6] * y[i] + m[10] * z[i] + m[14]); // distance in front of the camera
+    }
+
+    // froxels touched by the bounding box of each sphere
+    const float sx = projection(0, 0), sy = projection(1, 1);
+    const float slicesPerLog = Z / std::log(zFar / zNear);
+    const float* radius = lights.radius.constData();
+    auto tile = [](float ndc, int tiles) {
+        return clamp((int) std::floor((ndc + 1) / 2 * tiles), 0, tiles - 1);
+    };
+
+    for(int i = 0; i < n; i++) {
+        float r = radius[i], ndc[4];
+        if(!sphereBounds(vx[i], vy[i], d[i], r, sx, sy, zNear, zFar, ndc)) {
+            z0[i] = 1; z1[i] = 0; // outside of the frustum
+            continue;
+        }
+
+        x0[i] = tile(ndc[0], X); x1[i] = tile(ndc[2], X);
+        y0[i] = tile(ndc[1], Y); y1[i] = tile(ndc[3], Y);
+        z0[i] = clamp((int) (std::log(max(zNear, d[i] - r) / zNear) * slicesPerLog), 0, Z - 1);
+        z1[i] = clamp((int) (std::log(min(zFar, d[i] + r) / zNear) * slicesPerLog), 0, Z - 1);
+    }
+
+    // slices are independent, a handful of lights isn't worth the thread pool
+    if(n >= 64) {
+        QVector<QFuture<void>> jobs(Z);
+        for(int s = 0; s < Z; s++)
+            jobs[s] = QtConcurrent::run([this, s]() {
+                binSlice(s);
+            });
+        for(QFuture<void>& job : jobs)
+            job.waitForFinished();
+    } else {
+        for(int s = 0; s < Z; s++)
+            binSlice(s);
+    }
+
+    // concatenate the slices behind the offset, count table
+    int total = 0;
+    for(const Slice& s : slices)
+        total += s.items.size();
+    items.resize(2 * COUNT + total);
+
+    quint32* out = items.data();
+    quint32 offset = 2 * COUNT;
+    stats.maxItems = 0;
+    for(int s = 0; s < Z; s++) {
+        const Slice& slice = slices[s];
+        for(int c = 0; c < X * Y; c++) {
+            int cluster = s * X * Y + c;
+            quint32 count = slice.offsets[c + 1] - slice.offsets[c];
+            out[2 * cluster] = offset + slice.offsets[c];
+            out[2 * cluster + 1] = count;
+            stats.maxItems = max<int>(stats.maxItems, count);
+        }
+        std::copy(slice.items.begin(), slice.items.end(), out + offset);
+        offset += slice.items.size();
+    }
+
+    stats.lights = n;
+    stats.items = total;
+    stats.binNs = timer.nsecsElapsed();
+}
+
+void LightClusters::binSlice(int s)
+{
+    // counting sort of the (cluster, light) pairs of the slice: count, prefix sum, fill
+    Slice& slice = slices[s];
+    slice.offsets.fill(0, X * Y + 1);
+    quint32* offsets = slice.offsets.data();
+
+    const int n = z0.size();
+    for(int i = 0; i < n; i++)
+        if(z0[i] <= s && s <= z1[i])
+            for(int y = y0[i]; y <= y1[i]; y++)
+                for(int x = x0[i]; x <= x1[i]; x++)
+                    offsets[y * X + x + 1]++;
+
+    for(int c = 1; c <= X * Y; c++)
+        offsets[c] += offsets[c - 1];
+
+    slice.items.resize(offsets[X * Y]);
+    QVector<quint32> cursor = slice.offsets;
+    for(int i = 0; i < n; i++)
+        if(z0[i] <= s && s <= z1[i])
+            for(int y = y0[i]; y <= y1[i]; y++)
+                for(int x = x0[i]; x <= x1[i]; x++)
+                    slice.items[cursor[y * X + x]++] = i;
+}
+
+void LightClusters::upload(const PointLights& lights, int lightsUnit, int itemsUnit)
+{
+    const int n = lights.size();
+    QVector<float> data(8 * max(1, n));
+    for(int i = 0; i < n; i++) {
+        float* texels = data.data() + 8 * i;
+        texels[0] = lights.x[i];
+        texels[1] = lights.y[i];
+        texels[2] = lights.z[i];
+        texels[3] = lights.radius[i];
+        texels[4] = lights.color[i].x();
+        texels[5] = lights.color[i].y();
+        texels[6] = lights.color[i].z();
+    }
+
+    // new storage each frame, the driver keeps the old one for the frames still in flight
+    ext->BindBuffer(GL_TEXTURE_BUFFER, lightsBuffer);
+    ext->BufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(float), data.constData(), GL_STREAM_DRAW);
+    ext->BindBuffer(GL_TEXTURE_BUFFER, itemsBuffer);
+    ext->BufferData(GL_TEXTURE_BUFFER, items.size() * sizeof(quint32), items.constData(), GL_STREAM_DRAW);
+    ext->BindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    ext->ActiveTexture(GL_TEXTURE0 + lightsUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, lightsTexture);
+    ext->ActiveTexture(GL_TEXTURE0 + itemsUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, itemsTexture);
+    ext->ActiveTexture(GL_TEXTURE0);
+}
+
+void LightClusters::report() const
+{
+    // a snapshot of the last frame, built again each frame: nothing to reset
+    qCDebug(clusterLog) << "light clusters: last build"
+                        << "lights:" << stats.lights
+                        << "items:" << stats.items
+                        << "max per cluster:" << stats.maxItems
+                        << "binning:" << stats.binNs / 1000 << "us";
+}
@@ -0,0 +1,107 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <QVector>
+#include <QVector3D>
+#include <QMatrix4x4>
+
+#include <algorithm>
+
+#include "glextensions.h"
+
+/**
+ * @brief point lights stored as structure of arrays, so the binning loops run on plain floats
+ */
+struct PointLights {
+    QVector<float> x, y, z, radius;
+    QVector<QVector3D> color;
+
+    int size() const { return x.size(); }
+    void resize(int n) {
+        x.resize(n);
+        y.resize(n);
+        z.resize(n);
+        radius.resize(n);
+        color.resize(n);
+    }
+};
+
+/**
+ * @brief clustered forward lighting
+ *
+ * The view frustum is cut in X * Y tiles on screen and Z slices in depth (exponential, finer near the camera),
+ * each froxel gets the list of the lights whose sphere touches it. Binning runs on the cpu every frame,
+ * one depth slice per job on the thread pool, and the result goes to two texture buffers
+ * so fragments only loop on the lights of their froxel (see shaders/clusters.glsl).
+ */
+class LightClusters
+{
+public:
+    enum { X = 16, Y = 9, Z = 24, COUNT = X * Y * Z };
+
+    struct Stats {
+        int lights = 0;
+        int items = 0;     // light indices in all the clusters
+        int maxItems = 0;  // in the fullest cluster
+        qint64 binNs = 0;  // last build
+    } stats;
+
+    bool create(GLExtensions* ext);
+    void destroy();
+    bool isCreated() const { return itemsBuffer != 0; }
+
+    /**
+     * @brief bins the lights in the froxels of the camera, no GL, can be called from any thread
+     * projection must be a symmetric perspective with these planes
+     */
+    void build(const PointLights& lights, const QMatrix4x4& view, const QMatrix4x4& projection, float zNear, float zFar);
+
+    /**
+     * @brief rectangle in normalized device coordinates [x0, y0, x1, y1] that contains a sphere
+     * given in view space (vx, vy, distance in front of the camera), false if it is out of the frustum.
+     * sx, sy are the (0,0) and (1,1) terms of a symmetric perspective.
+     */
+    static bool sphereBounds(float vx, float vy, float d, float r, float sx, float sy, float zNear, float zFar, float ndc[4]) {
+        // x / depth is monotonic in depth, so the extremes of the box on screen are at its nearest or farthest depth
+        float dmin = std::max(zNear, d - r), dmax = std::min(zFar, d + r);
+        if(dmin > dmax)
+            return false;
+
+        float left = vx - r, right = vx + r, bottom = vy - r, top = vy + r;
+        ndc[0] = sx * std::min(left / dmin, left / dmax);
+        ndc[1] = sy * std::min(bottom / dmin, bottom / dmax);
+        ndc[2] = sx * std::max(right / dmin, right / dmax);
+        ndc[3] = sy * std::max(top / dmin, top / dmax);
+        return ndc[2] >= -1 && ndc[0] <= 1 && ndc[3] >= -1 && ndc[1] <= 1;
+    }
+
+    /**
+     * @brief sends the lights and the last build to the texture buffers, then binds them on the two units
+     */
+    void upload(const PointLights& lights, int lightsUnit, int itemsUnit);
+
+    /**
+     * @brief the counts of the last build, on chess.clusters (debug)
+     */
+    void report() const;
+
+private:
+    GLExtensions* ext = nullptr;
+    GLuint lightsBuffer = 0, itemsBuffer = 0;
+    GLuint lightsTexture = 0, itemsTexture = 0;
+
+    // per light, range of froxels touched, inclusive
+    QVector<int> x0, x1, y0, y1, z0, z1;
+
+    struct Slice {
+        QVector<quint32> offsets; // [X * Y + 1], in items
+        QVector<quint32> items;
+    };
+    QVector<Slice> slices; // [Z]
+
+    QVector<quint32> items; // [cluster] = offset, count, then the light indices of all the clusters
+
+    void binSlice(int z);
+};
+
+#endif // LIGHTCLUSTERS_H
@@ -1,10 +1,21 @@
 #include <QApplication>
 #include "mainwindow.h"
+#include "glwidget.h"
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
 
+    // --swap-interval N, 0 doesn't wait for the vertical blank
+    // --qglwidget, the old surface, to compare its timings
+    // --software, no GL, the scene is rasterized on the cpu
+    QStringList args = a.arguments();
+    int i = args.indexOf("--swap-interval");
+    if(i >= 0 && i + 1 < args.size())
+        MyGLDrawer::swapInterval = args[i + 1].toInt();
+    MyGLDrawer::legacySurface = args.contains("--qglwidget");
+    MyGLDrawer::softwareSurface = args.contains("--software");
+
     MainWindow w;
     // MyGLDrawer w;
     // Window w;
@@ -5,6 +5,9 @@
 
 #include <stdexcept>
 #include <QMessageBox>
+#include <QFileDialog>
+#include <QSignalBlocker>
+#include <QTimer>
 #include <functional>
 
 template <typename T>
@@ -24,19 +27,27 @@ static void addChildren(QList<QSlider*> & sliders, QList<T*> & rawLabels, QWidge
 
 namespace mapvari {
 
-template <typename T>
-void general(T & value, QSlider* slider) {
-    value = slider->value();
-    QObject::connect(slider, &QSlider::valueChanged, [&value](int x){
-        value = x;
-    });
-}
+// the fields belong to the thread of the frames once it runs, the changes are posted to it;
+// the registry hands those the simulation reads on to its thread (see Parameters::own)
+static MyGLDrawer* drawer = nullptr;
 
+// registered under the name of the slider, the registry maps the value and tracks its version
 template <typename T, typename F>
 void general(T & value, QSlider* slider, F f) {
-    value = f(slider->value());
-    QObject::connect(slider, &QSlider::valueChanged, [&value, f](int x){
-        value = f(x);
+    Parameters* params = &drawer->getScene()->params;
+    int id = params->add(slider->objectName(), value, f);
+    params->set(id, slider->value());
+    QObject::connect(slider, &QSlider::valueChanged, [params, id](int x){
+        drawer->post([params, id, x](){
+            params->set(id, x);
+        });
+    });
+}
+
+template <typename T>
+void general(T & value, QSlider* slider) {
+    general(value, slider, [](int x) {
+        return x;
     });
 }
 
@@ -75,7 +86,6 @@ MainWindow::MainWindow(QWidget* parent) :
 
     addChildren(sliders, rawLabels, ui->controls);
 
-    QList<MyLabel*> labels;
     for(QSlider* slider : sliders) {
         MyLabel* savedLabel = nullptr;
         QMutableListIterator<MyLabel*> it(rawLabels);
@@ -121,6 +131,7 @@ MainWindow::MainWindow(QWidget* parent) :
                       f.arg(QString("-%1.%2").arg((-x)/100).arg((-x)%100, 2, 10, QChar('0')));
     };
     Scene* scene = getScene();
+    mapvari::drawer = ui->gl;
 
     mapvari::linear(scene->lightHeight, ui->lightHeight, DM);
     mapvari::linear(scene->lightRadius, ui->lightRadius, DM);
@@ -170,8 +181,9 @@ MainWindow::MainWindow(QWidget* parent) :
 
     mapvari::linear(scene->falling.g, ui->fallingGravity);
     mapvari::linear(scene->falling.k, ui->fallingK);
-    mapvari::general(scene->falling.timeCutOff, ui->fallingMaxT, [this](int x){
-        return x == ui->fallingMaxT->maximum() ? 1e6 : x;
+    const int maxT = ui->fallingMaxT->maximum(); // mapped on the simulation thread, not read from the slider there
+    mapvari::general(scene->falling.timeCutOff, ui->fallingMaxT, [maxT](int x){
+        return x == maxT ? 1e6 : x;
     });
     ui->fallingMaxTLabel->setFunc([this](QString s, int x) -> QString {
         return x == ui->fallingMaxT->maximum() ? s.arg("∞") : s.arg(x);
@@ -186,29 +198,145 @@ MainWindow::MainWindow(QWidget* parent) :
     mapvari::general(scene->currentCubeMap, ui->cubemapTexture);
 
     connect(ui->buttonBoing, &QPushButton::clicked, [this, scene](){
-        scene->falling.start(ui->gl->currentTime());
+        scene->startFalling();
     });
 
-    ui->animModeLabel->setFunc([scene](QString format, int x){
+    ui->animModeLabel->setFunc([](QString format, int x){
         x = std::max(1,x);
-        return format.arg(x % 2 == 1 ? "p3" : "p4").arg(scene->anim.mode.getHeight(x));
+        return format.arg(x % 2 == 1 ? "p3" : "p4").arg(Scene::KnightAnimation::modeHeight(x));
     });
 
     auto convertAngle = [ANGLE](float rad) {
         return (((int)(rad / ANGLE)) % 360 + 360) % 360;
     };
 
-    // link gl and ui
-    connect(ui->gl, &MyGLDrawer::paramChanged, [this, scene, DM, convertAngle](){
-        ui->cameraR->setValue((int)(scene->length / DM));
-        ui->onGround->setValue(convertAngle(scene->angleOnGround));
-        ui->toUp->setValue(convertAngle(scene->angleFromUp));
-        ui->panX->setValue((int)(scene->lookAt[0]/DM));
-        ui->panY->setValue((int)(scene->lookAt[1]/DM));
-    });
+    // link gl and ui, the camera as the last frame drew it; the scene already has it, only the registry learns it
+    connect(ui->gl, &MyGLDrawer::paramChanged, this, [this, DM, convertAngle](){
+        const MyGLDrawer::Status& s = ui->gl->status();
+        setSliders({
+            {ui->cameraR->objectName(), (int)(s.length / DM)},
+            {ui->onGround->objectName(), convertAngle(s.angleOnGround)},
+            {ui->toUp->objectName(), convertAngle(s.angleFromUp)},
+            {ui->panX->objectName(), (int)(s.lookAt[0]/DM)},
+            {ui->panY->objectName(), (int)(s.lookAt[1]/DM)},
+        }, false);
+    }, Qt::QueuedConnection);
 
     mapvari::linear(scene->nLights, ui->nLights, 1);
 
+    mapvari::linear(scene->clusterLights, ui->clusterLights, 16);
+    ui->clusterLightsLabel->setFunc([](QString f, int x){
+        return f.arg(16 * x);
+    });
+
+    mapvari::linear(scene->renderPath, ui->renderPath);
+    ui->renderPathLabel->setFunc([](QString f, int x){
+        const char* values[] = {"forward", "deferred"};
+        return f.arg(values[x]);
+    });
+
+    mapvari::linear(scene->shadows, ui->shadows);
+    ui->shadowsLabel->setFunc([](QString f, int x){
+        const char* values[] = {"off", "on"};
+        return f.arg(values[x]);
+    });
+
+    mapvari::linear(scene->planarReflections, ui->planarReflections);
+    ui->planarReflectionsLabel->setFunc([](QString f, int x){
+        const char* values[] = {"off", "every frame", "on change"};
+        return f.arg(values[x]);
+    });
+
+    mapvari::linear(scene->dynamicResolution, ui->dynamicResolution);
+    ui->dynamicResolutionLabel->setFunc([](QString f, int x){
+        const char* values[] = {"full", "dynamic, bilinear", "dynamic, sharpen"};
+        return f.arg(values[x]);
+    });
+    mapvari::linear(scene->targetFrameMs, ui->targetFrameMs, DM);
+    ui->targetFrameMsLabel->setFunc(dmFormat);
+    mapvari::linear(scene->minResolutionScale, ui->minResolutionScale, CM);
+
+    mapvari::linear(scene->antiAliasing, ui->antiAliasing);
+    ui->antiAliasingLabel->setFunc([](QString f, int x){
+        const char* values[] = {"off", "MSAA 2x", "MSAA 4x", "MSAA 8x", "FXAA"};
+        return f.arg(values[x]);
+    });
+
+    mapvari::linear(scene->multiView, ui->multiView);
+    ui->multiViewLabel->setFunc([](QString f, int x){
+        return f.arg(x ? "knight and top insets" : "off");
+    });
+
+    mapvari::linear(scene->hud, ui->hud);
+    ui->hudLabel->setFunc([](QString f, int x){
+        return f.arg(x ? "on" : "off");
+    });
+
+    // 0, then 1 to 1024 boards by powers of 4
+    auto boards = [](int x){
+        return x ? 1 << 2 * (x - 1) : 0;
+    };
+    mapvari::general(scene->tournamentBoards, ui->tournamentBoards, boards);
+    ui->tournamentBoardsLabel->setFunc([boards](QString f, int x){
+        return f.arg(x ? QString::number(boards(x)) : "off");
+    });
+    connect(ui->wallBenchmark, &QPushButton::clicked, [this, scene](){
+        ui->gl->post([scene](){
+            scene->startWallBenchmark();
+        });
+    });
+    connect(ui->softwareBenchmark, &QPushButton::clicked, [this, scene](){
+        ui->gl->post([scene](){
+            scene->startSoftwareBenchmark();
+        });
+    });
+    connect(ui->pathTrace, &QPushButton::clicked, [this, scene](){
+        ui->gl->post([scene](){
+            scene->startPathTrace();
+        });
+    });
+
+    // the label follows the level of the governor, refreshed with the frame times
+    mapvari::linear(scene->qualityGovernor, ui->qualityGovernor);
+    ui->qualityGovernorLabel->setFunc([this](QString f, int x){
+        if(!x)
+            return f.arg("off");
+        const Scene::FrameTimes& t = ui->gl->status().times;
+        return f.arg(QString("on, level %1 / %2").arg(t.qualityLevel).arg(t.qualityLevels));
+    });
+
+    // frame times of the render path, averaged by the scene; the parameters from the sliders, the scene is on its thread
+    QTimer* frameTimes = new QTimer(this);
+    connect(frameTimes, &QTimer::timeout, [this, scene, boards](){
+        const char* paths[] = {"forward", "deferred"};
+        const MyGLDrawer::Status& status = ui->gl->status();
+        const Scene::FrameTimes& t = status.times;
+        QString message = QString("%1: cpu %2 ms, gpu %3 ms")
+            .arg(scene->isSoftware() ? "software" : paths[ui->renderPath->value()])
+            .arg(t.cpuMs, 0, 'f', 2)
+            .arg(t.gpuMs, 0, 'f', 2);
+        const char* aa[] = {"no AA", "MSAA 2x", "MSAA 4x", "MSAA 8x", "FXAA"};
+        message += QString(" | %1").arg(aa[ui->antiAliasing->value()]);
+        if(ui->antiAliasing->value())
+            message += QString(" %1 ms").arg(t.antiAliasingMs, 0, 'f', 2);
+        if(ui->qualityGovernor->value()) {
+            ui->qualityGovernorLabel->formatInt(ui->qualityGovernor->value());
+            if(t.qualityLevel)
+                message += QString(" | lowered: %1").arg(status.lowered);
+        }
+        if(ui->tournamentBoards->value())
+            message += QString(" | wall %1 boards").arg(boards(ui->tournamentBoards->value()));
+        if(ui->dynamicResolution->value())
+            message += QString(" | scale %1 %").arg((int) (100 * t.resolutionScale));
+        if(ui->planarReflections->value())
+            message += QString(" | reflection: cpu %1 ms, gpu %2 ms, %3% of the frames")
+                .arg(t.reflectionCpuMs, 0, 'f', 2)
+                .arg(t.reflectionGpuMs, 0, 'f', 2)
+                .arg((int) (100 * t.reflectionRate));
+        ui->statusbar->showMessage(message);
+    });
+    frameTimes->start(500);
+
     auto it = labels.begin();
     for(QSlider* slider : sliders) {
         auto label = *it++;
@@ -220,10 +348,35 @@ MainWindow::MainWindow(QWidget* parent) :
         });
     }
 
+    // the frames are drawn on demand, any parameter or button of the panel asks for one
+    for(QSlider* slider : sliders)
+        connect(slider, &QSlider::valueChanged, ui->gl, &MyGLDrawer::requestFrame);
+    for(QAbstractButton* button : ui->controls->findChildren<QAbstractButton*>())
+        connect(button, &QAbstractButton::clicked, ui->gl, &MyGLDrawer::requestFrame);
+
     connect(ui->defaultButton, &QPushButton::clicked, [this](){
+        Preset defaults;
         QListIterator<int> it(defaultSliderValues);
         for(QSlider* s : sliders)
-            s->setValue(it.next());
+            defaults.values.append({s->objectName(), it.next()});
+        setSliders(defaults.values, true);
+    });
+
+    // presets: the positions of all the sliders, applied in one edit
+    connect(ui->savePresetButton, &QPushButton::clicked, [this](){
+        QString fileName = QFileDialog::getSaveFileName(this, tr("Save preset"), QString(), tr("Presets (*.preset)"));
+        if(fileName.isEmpty())
+            return;
+        Preset preset;
+        for(QSlider* s : sliders)
+            preset.values.append({s->objectName(), s->value()});
+        preset.save(fileName);
+    });
+    connect(ui->loadPresetButton, &QPushButton::clicked, [this](){
+        QString fileName = QFileDialog::getOpenFileName(this, tr("Load preset"), QString(), tr("Presets (*.preset)"));
+        Preset preset;
+        if(!fileName.isEmpty() && preset.load(fileName))
+            setSliders(preset.values, true);
     });
 
     connect(ui->helpButton, &QPushButton::clicked, [this](){
@@ -291,6 +444,39 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
+void MainWindow::setSliders(const QVector<QPair<QString, int>>& values, bool apply)
+{
+    QVector<QPair<QString, int>> moved;
+    for(const auto& v : values) {
+        int i = 0;
+        while(i < sliders.size() && sliders[i]->objectName() != v.first)
+            i++;
+        if(i == sliders.size() || sliders[i]->value() == v.second)
+            continue; // gone since the preset was saved, or unchanged
+
+        // the labels only, the registry gets them all at once below
+        {
+            QSignalBlocker blocker(sliders[i]);
+            sliders[i]->setValue(v.second);
+        }
+        labels[i]->formatInt(sliders[i]->value());
+        moved.append({v.first, sliders[i]->value()});
+    }
+    if(moved.isEmpty())
+        return;
+
+    Parameters* params = &getScene()->params;
+    ui->gl->post([params, moved, apply](){
+        for(const auto& m : moved) {
+            if(apply)
+                params->set(params->find(m.first), m.second);
+            else
+                params->sync(params->find(m.first), m.second);
+        }
+    });
+    ui->gl->requestFrame();
+}
+
 Scene *MainWindow::getScene() {
     return ui->gl->getScene();
 }
@@ -5,6 +5,8 @@
 #include <QList>
 #include <QSlider>
 #include <QString>
+#include <QVector>
+#include <QPair>
 
 #include "customwidgets.h"
 
@@ -33,6 +35,12 @@ private:
 
 private:
     Scene* getScene();
+
+    /**
+     * @brief moves the sliders by name without their signals, then sends the values to Scene::params in one edit
+     * @param apply maps them to the fields, else only records them: the scene already has them (the camera after the mouse)
+     */
+    void setSliders(const QVector<QPair<QString, int>>& values, bool apply);
 };
 
 #endif // MAINWINDOW_H
@@ -83,11 +83,11 @@ void OBJObject::loadBuffers() {
 void OBJObject::draw() {
     if(triangles.length()) {
         bufferTriangles.bind();
-        glDrawElements(GL_TRIANGLES, 3 * triangles.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_TRIANGLES, triangles.size(), GL_UNSIGNED_INT, 0);
     }
     if(quads.length()) {
         bufferQuads.bind();
-        glDrawElements(GL_QUADS, 4 * quads.size(), GL_UNSIGNED_INT, 0);
+        glDrawElements(GL_QUADS, quads.size(), GL_UNSIGNED_INT, 0);
     }
 }
 
@@ -0,0 +1,118 @@
+#include "parameters.h"
+
+#include <QFile>
+#include <QDebug>
+
+#include <cstring>
+
+namespace {
+    // file = Header + count * (quint8 length, latin1 name, qint32 value)
+    struct Header {
+        char magic[4];
+        quint32 count;
+    };
+
+    const char MAGIC[4] = {'F', 'C', 'P', 'R'};
+}
+
+bool Parameters::set(int id, int raw)
+{
+    if(id < 0 || id >= entries.size())
+        return false;
+    Entry& e = entries[id];
+    if(e.known && e.raw == raw)
+        return false;
+    if(deliveries[e.thread]) {
+        auto apply = e.apply;
+        deliveries[e.thread]([apply, raw](){
+            apply(raw);
+        });
+    } else {
+        e.apply(raw);
+    }
+    e.raw = raw;
+    bump(e);
+    return true;
+}
+
+void Parameters::sync(int id, int raw)
+{
+    if(id < 0 || id >= entries.size())
+        return;
+    Entry& e = entries[id];
+    e.raw = raw;
+    bump(e);
+}
+
+bool Parameters::changed(Block block, quint32& seen) const
+{
+    if(seen == blocks[block])
+        return false;
+    seen = blocks[block];
+    return true;
+}
+
+void Parameters::bump(Entry& e)
+{
+    e.known = true;
+    e.version = ++counter;
+    blocks[e.block] = counter;
+}
+
+bool Preset::save(const QString& fileName) const
+{
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.count = values.size();
+
+    QByteArray data(reinterpret_cast<const char*>(&header), sizeof(header));
+    for(const auto& v : values) {
+        QByteArray name = v.first.toLatin1().left(255);
+        qint32 value = v.second;
+        data.append((char) name.size());
+        data.append(name);
+        data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        qDebug() << "Can't write the preset" << fileName;
+        return false;
+    }
+    return true;
+}
+
+bool Preset::load(const QString& fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Can't read the preset" << fileName;
+        return false;
+    }
+    QByteArray data = file.readAll();
+
+    Header header;
+    if(data.size() < (int) sizeof(header))
+        return false;
+    std::memcpy(&header, data.constData(), sizeof(header));
+    if(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        qDebug() << "Not a preset" << fileName;
+        return false;
+    }
+
+    QVector<QPair<QString, int>> read;
+    int at = sizeof(header);
+    for(quint32 i = 0; i < header.count; i++) {
+        if(at >= data.size())
+            return false;
+        int length = (quint8) data[at++];
+        if(at + length + (int) sizeof(qint32) > data.size())
+            return false;
+        qint32 value;
+        std::memcpy(&value, data.constData() + at + length, sizeof(value));
+        read.append({QString::fromLatin1(data.constData() + at, length), value});
+        at += length + sizeof(value);
+    }
+    values = read;
+    return true;
+}
@@ -0,0 +1,132 @@
+#ifndef PARAMETERS_H
+#define PARAMETERS_H
+
+#include <QVector>
+#include <QHash>
+#include <QPair>
+#include <QString>
+
+#include <functional>
+
+/**
+ * @brief the parameters of the panel by name: the raw value of the slider, the field it drives and a version
+ *
+ * set keeps the raw value, maps it to the field and bumps the version of the parameter and of the uniform block
+ * the field feeds, only when the raw value changes. The renderer asks changed() per block, so a block is uploaded
+ * again only after one of its parameters moved. Not thread safe: it belongs to the thread of the frames,
+ * but a field owned by another thread (the simulation) is only written on that thread, through its delivery.
+ */
+class Parameters
+{
+public:
+    enum Block {
+        BLOCK_NONE,     // the features, the simulation, the camera: read as they are
+        BLOCK_MATERIAL, // the Material uniform block of the streamed programs
+        NBLOCK
+    };
+
+    enum Thread {
+        THREAD_FRAMES,      // the one of set, the field is written at once
+        THREAD_SIMULATION,  // the steps read it, see Simulation::post
+        NTHREAD
+    };
+
+    /**
+     * @brief before add: the field feeds the block, for the parameters registered on it later
+     */
+    template <typename T>
+    void feed(const T& field, Block block) {
+        feeds.insert(&field, block);
+    }
+
+    /**
+     * @brief before add: the field is written on the thread, for the parameters registered on it later
+     */
+    template <typename T>
+    void own(const T& field, Thread thread) {
+        owners.insert(&field, thread);
+    }
+
+    /**
+     * @brief how the writes of the fields reach the thread, in the order of set; none runs them on the thread of set
+     */
+    void deliver(Thread thread, std::function<void(std::function<void()>)> through) {
+        deliveries[thread] = through;
+    }
+
+    /**
+     * @brief field = map(raw) on each change, on the thread of the field, the raw value starts unknown
+     * @return the id of the parameter
+     */
+    template <typename T, typename F>
+    int add(const QString& name, T& field, F map) {
+        Entry e;
+        e.name = name;
+        e.block = feeds.value(&field, BLOCK_NONE);
+        e.thread = owners.value(&field, THREAD_FRAMES);
+        e.apply = [&field, map](int raw) {
+            field = map(raw);
+        };
+        entries.append(e);
+        ids.insert(name, entries.size() - 1);
+        return entries.size() - 1;
+    }
+
+    int find(const QString& name) const { return ids.value(name, -1); }
+    int size() const { return entries.size(); }
+    const QString& name(int id) const { return entries[id].name; }
+    int raw(int id) const { return entries[id].raw; }
+
+    /**
+     * @brief maps the raw value to the field if it changed, at once or on the thread of the field
+     * @return false for the same value or an unknown id
+     */
+    bool set(int id, int raw);
+
+    /**
+     * @brief the field was moved by something else (the mouse): the raw value and the versions only
+     */
+    void sync(int id, int raw);
+
+    quint32 version(int id) const { return entries[id].version; }
+    quint32 version(Block block) const { return blocks[block]; }
+
+    /**
+     * @brief true once per change of the block since seen, seen is then the current version
+     */
+    bool changed(Block block, quint32& seen) const;
+
+private:
+    struct Entry {
+        QString name;
+        Block block;
+        Thread thread;
+        int raw = 0;
+        bool known = false;
+        quint32 version = 0;
+        std::function<void(int)> apply;
+    };
+
+    QVector<Entry> entries;
+    QHash<QString, int> ids;
+    QHash<const void*, Block> feeds;
+    QHash<const void*, Thread> owners;
+    std::function<void(std::function<void()>)> deliveries[NTHREAD];
+    quint32 blocks[NBLOCK] = {};
+    quint32 counter = 0;
+
+    void bump(Entry& e);
+};
+
+/**
+ * @brief raw values by name, in a small binary file: a header, then for each one its name and its value
+ * Read and written in one go, the names that don't exist anymore are skipped by who applies it.
+ */
+struct Preset {
+    QVector<QPair<QString, int>> values;
+
+    bool save(const QString& fileName) const;
+    bool load(const QString& fileName);
+};
+
+#endif // PARAMETERS_H
@@ -0,0 +1,296 @@
+#include "pathtracer.h"
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtConcurrent>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+#include "softrasterizer.h"
+#include "utils.h"
+
+using std::min;
+using std::max;
+
+static Bvh::Ray makeRay(QVector3D origin, QVector3D direction, float tMax = 1e30f)
+{
+    Bvh::Ray ray;
+    ray.origin = origin;
+    ray.direction = direction;
+    ray.tMax = tMax;
+    return ray;
+}
+
+PathTracer::PathTracer()
+{
+    pool.setMaxThreadCount(max(1, QThread::idealThreadCount()));
+}
+
+PathTracer::~PathTracer()
+{
+    cancel();
+    running.waitForFinished();
+}
+
+void PathTracer::clear()
+{
+    vertices.clear();
+    surfaces.clear();
+    lights.clear();
+}
+
+void PathTracer::addMesh(const OBJObject* obj, const QMatrix4x4& model, QVector3D albedo, float shininess)
+{
+    QMatrix4x4 normalMatrix = model.inverted().transposed();
+    QVector<QVector3D> positions(obj->vertices.size()), normals(obj->vertices.size());
+    for(int i = 0; i < positions.size(); i++) {
+        positions[i] = model.map(obj->vertices[i]);
+        normals[i] = normalMatrix.mapVector(i < obj->normals.size() ? obj->normals[i] : QVector3D(0, 0, 1)).normalized();
+    }
+
+    auto triangle = [&](int a, int b, int c) {
+        vertices << positions[a] << positions[b] << positions[c];
+        surfaces.append({{normals[a], normals[b], normals[c]}, albedo, shininess, 0});
+    };
+    for(int i = 0; i + 2 < obj->triangles.size(); i += 3)
+        triangle(obj->triangles[i], obj->triangles[i+1], obj->triangles[i+2]);
+    for(int i = 0; i + 3 < obj->quads.size(); i += 4) {
+        triangle(obj->quads[i], obj->quads[i+1], obj->quads[i+2]);
+        triangle(obj->quads[i], obj->quads[i+2], obj->quads[i+3]);
+    }
+}
+
+void PathTracer::addSquare(const QMatrix4x4& model, QVector3D albedo, float shininess, float mirror)
+{
+    QVector3D p[4] = {
+        model.map({-0.5, -0.5, 0}), model.map({0.5, -0.5, 0}),
+        model.map({0.5, 0.5, 0}), model.map({-0.5, 0.5, 0}),
+    };
+    QVector3D n = model.inverted().transposed().mapVector({0, 0, 1}).normalized();
+
+    vertices << p[0] << p[1] << p[2] << p[0] << p[2] << p[3];
+    surfaces.append({{n, n, n}, albedo, shininess, mirror});
+    surfaces.append({{n, n, n}, albedo, shininess, mirror});
+}
+
+void PathTracer::addLight(QVector3D position, QVector3D color)
+{
+    lights.append({position, color});
+}
+
+void PathTracer::setEnvironment(const QVector<QImage>& faces)
+{
+    environment.clear();
+    for(const QImage& face : faces)
+        environment.append(face.convertToFormat(QImage::Format_RGBA8888));
+}
+
+void PathTracer::setCamera(const QMatrix4x4& pv)
+{
+    inversePV = pv.inverted();
+}
+
+bool PathTracer::start(int width, int height, int samples, QString fileName)
+{
+    if(isRunning() || width <= 0 || height <= 0)
+        return false;
+
+    this->width = width;
+    this->height = height;
+    tilesX = (width + TILE - 1) / TILE;
+    tilesY = (height + TILE - 1) / TILE;
+    accumulated.fill(QVector3D(), width * height);
+
+    cancelled.store(0);
+    rays.store(0);
+    steals.store(0);
+
+    // the passes are driven from the global pool, the tiles go to the pool of the tracer
+    running = QtConcurrent::run([this, samples, fileName]() {
+        trace(samples, fileName);
+    });
+    return true;
+}
+
+void PathTracer::cancel()
+{
+    cancelled.store(1);
+}
+
+void PathTracer::trace(int samples, QString fileName)
+{
+    bvh.build(vertices);
+    qDebug() << "path tracer:" << bvh.stats.triangles << "triangles," << bvh.stats.nodes << "nodes,"
+             << bvh.stats.leaves << "leaves, depth" << bvh.stats.depth << ", built in" << bvh.stats.buildNs / 1e6 << "ms,"
+             << width << "x" << height << "," << pool.maxThreadCount() << "threads";
+
+    QElapsedTimer timer;
+    timer.start();
+    for(int sample = 0; sample < samples && !cancelled.load(); sample++) {
+        pass(sample);
+
+        // progressive, the file is rewritten as the noise halves
+        int done = sample + 1;
+        if((done & (done - 1)) == 0 || done == samples) {
+            double seconds = timer.nsecsElapsed() / 1e9;
+            bool saved = image(done).save(fileName);
+            qDebug() << "path tracer:" << done << "samples per pixel,"
+                     << (double) width * height * done / seconds / 1e6 << "M samples/s,"
+                     << rays.load() / seconds / 1e6 << "M rays/s,"
+                     << steals.load() << "tiles stolen,"
+                     << (saved ? "written to" : "could not write") << fileName;
+        }
+    }
+}
+
+void PathTracer::pass(int sample)
+{
+    // each worker starts on its own range of tiles, then steals from the ranges of the others
+    const int tiles = tilesX * tilesY;
+    const int workers = max(1, min(pool.maxThreadCount(), tiles));
+    QVector<QAtomicInt> next(workers);
+    QVector<int> end(workers);
+    for(int w = 0; w < workers; w++) {
+        next[w].store(tiles * w / workers);
+        end[w] = tiles * (w + 1) / workers;
+    }
+
+    QVector<QFuture<void>> jobs(workers);
+    for(int w = 0; w < workers; w++)
+        jobs[w] = QtConcurrent::run(&pool, [this, w, workers, sample, &next, &end]() {
+            for(int k = 0; k < workers && !cancelled.load(); k++) {
+                int victim = (w + k) % workers;
+                for(int t = next[victim].fetchAndAddRelaxed(1); t < end[victim]; t = next[victim].fetchAndAddRelaxed(1)) {
+                    traceTile(t, sample);
+                    if(victim != w)
+                        steals.fetchAndAddRelaxed(1);
+                }
+            }
+        });
+    for(QFuture<void>& job : jobs)
+        job.waitForFinished();
+}
+
+Bvh::Ray PathTracer::cameraRay(float x, float y) const
+{
+    // from the near plane to the far one, whatever the projection
+    float nx = 2 * x / width - 1, ny = 1 - 2 * y / height;
+    QVector3D near = inversePV.map(QVector3D(nx, ny, -1));
+    QVector3D far = inversePV.map(QVector3D(nx, ny, 1));
+    return makeRay(near, (far - near).normalized());
+}
+
+void PathTracer::traceTile(int tile, int sample)
+{
+    const int left = tile % tilesX * TILE, top = tile / tilesX * TILE;
+    const int right = min(left + TILE, width), bottom = min(top + TILE, height);
+    Random random = {(quint32) (tile * 9781 + sample * 6271 + 1) * 2654435761u | 1};
+    qint64 count = 0;
+
+    // 2x2 packets of primary rays, jittered in their pixel
+    for(int y = top; y < bottom; y += 2) {
+        for(int x = left; x < right; x += 2) {
+            Bvh::Ray primary[Bvh::LANES];
+            Bvh::Hit hits[Bvh::LANES];
+            int px[Bvh::LANES], py[Bvh::LANES];
+            for(int l = 0; l < Bvh::LANES; l++) {
+                px[l] = min(x + l % 2, right - 1);
+                py[l] = min(y + l / 2, bottom - 1);
+                primary[l] = cameraRay(px[l] + random.next(), py[l] + random.next());
+            }
+            bvh.intersect4(primary, hits);
+            count += Bvh::LANES;
+
+            for(int l = 0; l < Bvh::LANES; l++)
+                if(x + l % 2 < right && y + l / 2 < bottom)
+                    accumulated[py[l] * width + px[l]] += radiance(primary[l], hits[l], random, count);
+        }
+    }
+
+    rays.fetchAndAddRelaxed(count);
+}
+
+QVector3D PathTracer::radiance(Bvh::Ray ray, Bvh::Hit hit, Random& random, qint64& count) const
+{
+    QVector3D L, throughput(1, 1, 1);
+
+    for(int bounce = 0; ; bounce++) {
+        if(hit.triangle < 0) {
+            L += throughput * SoftRasterizer::sampleCube(environment, ray.direction);
+            break;
+        }
+
+        const Surface& s = surfaces[hit.triangle];
+        QVector3D P = ray.origin + hit.t * ray.direction;
+        float w = 1 - hit.u - hit.v;
+        QVector3D N = (w * s.normals[0] + hit.u * s.normals[1] + hit.v * s.normals[2]).normalized();
+        if(QVector3D::dotProduct(N, ray.direction) > 0)
+            N = -N; // both sides, like the GL path that doesn't cull
+        QVector3D V = -ray.direction;
+        QVector3D origin = P + 1e-4f * N;
+
+        Bvh::Ray next;
+        if(s.mirror > 0 && random.next() < s.mirror) {
+            next = makeRay(origin, ray.direction - 2 * QVector3D::dotProduct(ray.direction, N) * N);
+        } else {
+            // the lights, lambert and phong like the shaders, the intensities are the light colors
+            for(const Light& light : lights) {
+                QVector3D toLight = light.position - P;
+                float d = toLight.length();
+                QVector3D Ld = toLight / d;
+                float cosine = QVector3D::dotProduct(N, Ld);
+                if(cosine <= 0)
+                    continue;
+                count++;
+                if(bvh.occluded(makeRay(origin, Ld, d)))
+                    continue;
+                QVector3D R = 2 * cosine * N - Ld;
+                float specular = std::pow(max(0.f, QVector3D::dotProduct(R, V)), s.shininess);
+                L += throughput * s.albedo * float(M_1_PI) * (cosine + specular) * light.color; // brdf albedo / pi
+            }
+
+            // cosine weighted, the weight of the bounce is the albedo: the pdf cos / pi cancels the cos and the 1 / pi of the brdf
+            throughput *= s.albedo;
+            float phi = M_2PI * random.next(), r2 = random.next(), r = std::sqrt(r2);
+            QVector3D T = QVector3D::crossProduct(std::abs(N.x()) > 0.5f ? QVector3D(0, 1, 0) : QVector3D(1, 0, 0), N).normalized();
+            QVector3D B = QVector3D::crossProduct(N, T);
+            next = makeRay(origin, (std::cos(phi) * r * T + std::sin(phi) * r * B + std::sqrt(1 - r2) * N).normalized());
+        }
+
+        if(bounce == MAX_BOUNCES)
+            break;
+        if(bounce >= 2) {
+            // russian roulette
+            float p = clamp(max(throughput.x(), max(throughput.y(), throughput.z())), 0.05f, 1.f);
+            if(random.next() > p)
+                break;
+            throughput /= p;
+        }
+
+        ray = next;
+        hit = Bvh::Hit();
+        count++;
+        bvh.intersect(ray, hit);
+    }
+
+    return L;
+}
+
+QImage PathTracer::image(int samples) const
+{
+    // linear, no gamma, like the shaders write it
+    QImage result(width, height, QImage::Format_RGB32);
+    auto unorm = [samples](float c) {
+        return (int) (clamp(c / samples, 0.f, 1.f) * 255 + 0.5f);
+    };
+    for(int y = 0; y < height; y++) {
+        QRgb* row = reinterpret_cast<QRgb*>(result.scanLine(y));
+        for(int x = 0; x < width; x++) {
+            const QVector3D& c = accumulated[y * width + x];
+            row[x] = qRgb(unorm(c.x()), unorm(c.y()), unorm(c.z()));
+        }
+    }
+    return result;
+}
@@ -0,0 +1,97 @@
+#ifndef PATHTRACER_H
+#define PATHTRACER_H
+
+#include <QVector>
+#include <QVector3D>
+#include <QMatrix4x4>
+#include <QImage>
+#include <QString>
+#include <QThreadPool>
+#include <QFuture>
+#include <QAtomicInt>
+
+#include "bvh.h"
+#include "objloader.h"
+
+/**
+ * @brief offline reference of the scene, path traced on the cpu in the background and written to a png
+ *
+ * A copy of the pieces, the board, the lights and the cubemap is taken when the trace starts, so the live scene goes on.
+ * All the triangles go in one Bvh. Each pass adds one sample per pixel: the pixels are traced by 2x2 packets of primary rays
+ * (Bvh::intersect4), then each path goes on alone with a shadow ray per light and a cosine weighted bounce.
+ * The tiles of a pass are split in one contiguous range per worker, a worker that is done steals the tiles left in the others.
+ *
+ * The materials follow the shaders: lambert and the phong lobe of the lights with the colors of chess.frag and board.frag,
+ * the lights don't fall off, the board mirrors with its reflection factor, and the paths that leave light with the cubemap.
+ */
+class PathTracer
+{
+public:
+    enum { TILE = 16, MAX_BOUNCES = 5 };
+
+    PathTracer();
+    ~PathTracer(); // cancels and waits
+
+    // the scene, only while not running
+    void clear();
+    void addMesh(const OBJObject* obj, const QMatrix4x4& model, QVector3D albedo, float shininess);
+    void addSquare(const QMatrix4x4& model, QVector3D albedo, float shininess, float mirror); // [-0.5, 0.5] in x and y
+    void addLight(QVector3D position, QVector3D color);
+    void setEnvironment(const QVector<QImage>& faces); // see SoftRasterizer::setCubeMap
+    void setCamera(const QMatrix4x4& pv);
+
+    /**
+     * @brief builds the BVH and traces in the background, the image is written after 1, 2, 4 ... samples per pixel and at the end
+     */
+    bool start(int width, int height, int samples, QString fileName);
+    void cancel();
+    bool isRunning() const { return running.isRunning(); }
+
+private:
+    struct Surface {
+        QVector3D normals[3];
+        QVector3D albedo;
+        float shininess;
+        float mirror; // probability of a perfect reflection
+    };
+
+    struct Light {
+        QVector3D position, color;
+    };
+
+    // xorshift, one per tile and pass
+    struct Random {
+        quint32 state;
+        float next() {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return (state >> 8) * (1.f / 16777216);
+        }
+    };
+
+    QVector<QVector3D> vertices; // 3 per triangle
+    QVector<Surface> surfaces;   // per triangle
+    QVector<Light> lights;
+    QVector<QImage> environment;
+    QMatrix4x4 inversePV;
+
+    Bvh bvh;
+    int width = 0, height = 0, tilesX = 0, tilesY = 0;
+    QVector<QVector3D> accumulated; // [width * height], sum of the samples
+
+    QThreadPool pool;
+    QFuture<void> running;
+    QAtomicInt cancelled;
+    QAtomicInteger<qint64> rays;
+    QAtomicInt steals; // tiles traced by another worker than the one of their range
+
+    void trace(int samples, QString fileName);
+    void pass(int sample);
+    void traceTile(int tile, int sample);
+    Bvh::Ray cameraRay(float x, float y) const;
+    QVector3D radiance(Bvh::Ray ray, Bvh::Hit hit, Random& random, qint64& count) const;
+    QImage image(int samples) const;
+};
+
+#endif // PATHTRACER_H
@@ -0,0 +1,68 @@
+#ifndef PIECES_H
+#define PIECES_H
+
+#include <QVector>
+#include <QPoint>
+
+#include "objloader.h"
+
+/**
+ * @brief the pieces of the board as parallel arrays, one per field, indexed by a handle
+ *
+ * A handle is the index of the piece in every array, stable since the pieces are never removed (a capture would
+ * only move one off the board). The arrays are reserved once for the whole set, so the loops of the moves, of the
+ * fall and of the frame walk contiguous memory, and no piece is allocated on its own.
+ * The type, the color and the rest height don't change after add; the squares and the fall belong to the simulation.
+ */
+class Pieces
+{
+public:
+    typedef int Handle;
+    enum { NONE = -1, CAPACITY = 32 };
+
+    Pieces() {
+        types.reserve(CAPACITY);
+        squares.reserve(CAPACITY);
+        colors.reserve(CAPACITY);
+        tops.reserve(CAPACITY);
+        heights.reserve(CAPACITY);
+        velocities.reserve(CAPACITY);
+        masses.reserve(CAPACITY);
+    }
+
+    Handle add(OBJObject* type, QPoint square, int color) {
+        types.append(type);
+        squares.append(square);
+        colors.append(color);
+        tops.append(type->geom.size.z());
+        heights.append(tops.last());
+        velocities.append(0);
+        masses.append(type->geom.size.x() * type->geom.size.y() * type->geom.size.z());
+        return types.size() - 1;
+    }
+
+    int size() const { return types.size(); }
+
+    /**
+     * @brief the piece on the square, NONE if it is empty
+     */
+    Handle at(QPoint square) const {
+        for(Handle h = 0; h < squares.size(); h++)
+            if(squares[h] == square)
+                return h;
+        return NONE;
+    }
+
+    // what the piece is
+    QVector<OBJObject*> types;
+    QVector<QPoint> squares;   // (0,0): A1; (1,0): B1;
+    QVector<int> colors;       // 0 is white
+    QVector<float> tops;       // height of the mesh, where its top point rests
+
+    // the fall (see Scene::Falling), of the top point
+    QVector<float> heights;
+    QVector<float> velocities;
+    QVector<float> masses;     // for a density of 1
+};
+
+#endif // PIECES_H
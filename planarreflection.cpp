@@ -0,0 +1,109 @@
+#include "planarreflection.h"
+
+#include <QOpenGLContext>
+#include <QDebug>
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(reflectionLog, "chess.reflection", QtInfoMsg)
+
+bool PlanarReflection::create(GLExtensions* ext, int screenWidth, int screenHeight, int divisor)
+{
+    destroy();
+    this->ext = ext;
+
+    if(!ext->framebufferObject)
+        return false;
+
+    int width = qMax(1, screenWidth / divisor), height = qMax(1, screenHeight / divisor);
+
+    glGenTextures(1, &color);
+    glBindTexture(GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // upscaled by the board
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(1, &depth);
+    glBindTexture(GL_TEXTURE_2D, depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    ext->GenFramebuffers(1, &fbo);
+    ext->BindFramebuffer(GL_FRAMEBUFFER, fbo);
+    ext->FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    ext->FramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+    GLenum status = ext->CheckFramebufferStatus(GL_FRAMEBUFFER);
+    ext->BindFramebuffer(GL_FRAMEBUFFER, QOpenGLContext::currentContext()->defaultFramebufferObject());
+
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        qDebug() << "planar reflection incomplete" << status;
+        destroy();
+        return false;
+    }
+
+    gpuTimer.create(ext);
+
+    myWidth = width;
+    myHeight = height;
+    myScreenWidth = screenWidth;
+    myScreenHeight = screenHeight;
+    return true;
+}
+
+void PlanarReflection::destroy()
+{
+    if(!fbo)
+        return;
+
+    ext->DeleteFramebuffers(1, &fbo);
+    GLuint textures[] = {color, depth};
+    glDeleteTextures(2, textures);
+    gpuTimer.destroy();
+
+    fbo = color = depth = 0;
+    myWidth = myHeight = myScreenWidth = myScreenHeight = 0;
+}
+
+void PlanarReflection::begin()
+{
+    cpuTimer.start();
+    gpuTimer.begin();
+
+    ext->BindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, myWidth, myHeight);
+    glClearColor(0, 0, 0, 0); // alpha 0 where there is no piece
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void PlanarReflection::end()
+{
+    gpuTimer.end();
+    stats.refreshes++;
+    stats.cpuNs = cpuTimer.nsecsElapsed();
+}
+
+void PlanarReflection::bindTexture(int unit)
+{
+    ext->ActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, color);
+    ext->ActiveTexture(GL_TEXTURE0);
+}
+
+void PlanarReflection::collect()
+{
+    if(gpuTimer.collect())
+        stats.gpuNs = gpuTimer.ns();
+}
+
+void PlanarReflection::report()
+{
+    qCDebug(reflectionLog) << "planar reflection:" << myWidth << "x" << myHeight
+                           << "refreshes:" << stats.refreshes
+                           << "reuses:" << stats.reuses
+                           << "last refresh: cpu" << stats.cpuNs / 1000 << "us"
+                           << "gpu" << stats.gpuNs / 1000 << "us";
+    stats.refreshes = stats.reuses = 0; // the times are the ones of the last refresh, kept
+}
@@ -0,0 +1,70 @@
+#ifndef PLANARREFLECTION_H
+#define PLANARREFLECTION_H
+
+#include <QElapsedTimer>
+
+#include "glextensions.h"
+#include "gputimer.h"
+
+/**
+ * @brief mirror image of the pieces under the board, at a reduced resolution
+ *
+ * The pieces are drawn once more mirrored by the plane z = 0 into a color texture, alpha 1 where there is a piece,
+ * that board.frag samples at the screen position of its fragments. The texture can be kept across frames
+ * when nothing it shows has changed. Its cpu and gpu times are measured apart from the frame.
+ */
+class PlanarReflection
+{
+public:
+    struct Stats {
+        int refreshes = 0;
+        int reuses = 0;      // frames that kept the previous texture
+        qint64 cpuNs = 0;    // last refresh
+        qint64 gpuNs = 0;    // last refresh that has been measured, 0 without timer queries
+    } stats;
+
+    /**
+     * @brief divisor of the screen size on both axes, 2 is a quarter of the pixels
+     */
+    bool create(GLExtensions* ext, int screenWidth, int screenHeight, int divisor = 2);
+    void destroy();
+    bool isCreated() const { return fbo != 0; }
+
+    int width() const { return myWidth; }
+    int height() const { return myHeight; }
+    int screenWidth() const { return myScreenWidth; }
+    int screenHeight() const { return myScreenHeight; }
+
+    /**
+     * @brief targets the texture, cleared, with its own viewport
+     */
+    void begin();
+
+    /**
+     * @brief ends the measure, the caller binds its framebuffer and viewport back
+     */
+    void end();
+
+    void bindTexture(int unit);
+
+    /**
+     * @brief reads the gpu time of a previous refresh if it is ready, never waits
+     */
+    void collect();
+
+    /**
+     * @brief refreshes and reuses since the last report and the times of the last refresh, on chess.reflection (debug)
+     */
+    void report();
+
+private:
+    GLExtensions* ext = nullptr;
+    GLuint fbo = 0, color = 0, depth = 0;
+    int myWidth = 0, myHeight = 0;
+    int myScreenWidth = 0, myScreenHeight = 0;
+
+    GpuTimer gpuTimer;
+    QElapsedTimer cpuTimer;
+};
+
+#endif // PLANARREFLECTION_H
@@ -0,0 +1,141 @@
+#include "programcache.h"
+
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+#include <cstring>
+
+namespace {
+    // file = Header + binary
+    struct Header {
+        char magic[4];
+        quint32 format;
+        qint64 compileNs;
+    };
+
+    const char MAGIC[4] = {'F', 'C', 'P', 'B'};
+}
+
+void ProgramCache::initialize(GLExtensions* ext)
+{
+    this->ext = ext;
+    directory.clear();
+
+    if(!ext->programBinary)
+        return;
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if(formats <= 0)
+        return;
+
+    for(GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        driver += reinterpret_cast<const char*>(glGetString(name)) + QByteArray("\n");
+
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if(dir.isEmpty() || !QDir().mkpath(dir + "/shaders"))
+        return;
+    directory = dir + "/shaders";
+}
+
+QByteArray ProgramCache::key(const QByteArray& vertex, const QByteArray& fragment) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(driver);
+    hash.addData(vertex);
+    hash.addData("\0", 1);
+    hash.addData(fragment);
+    return hash.result().toHex();
+}
+
+QString ProgramCache::filename(const QByteArray& key) const
+{
+    return directory + "/" + QString::fromLatin1(key) + ".bin";
+}
+
+bool ProgramCache::load(QOpenGLShaderProgram& prog, const QByteArray& key)
+{
+    if(!enabled())
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(filename(key));
+    if(!file.open(QIODevice::ReadOnly)) {
+        stats.misses++;
+        return false;
+    }
+
+    QByteArray data = file.readAll();
+    file.close();
+
+    Header header;
+    if(data.size() <= (int) sizeof(header)) {
+        stats.misses++;
+        file.remove();
+        return false;
+    }
+    std::memcpy(&header, data.constData(), sizeof(header));
+    if(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        stats.misses++;
+        file.remove();
+        return false;
+    }
+
+    // with no shader attached, link() only checks the status the binary gave
+    ext->ProgramBinary(prog.programId(), header.format, data.constData() + sizeof(header), data.size() - sizeof(header));
+    if(!prog.link()) {
+        stats.rejected++;
+        file.remove();
+        return false;
+    }
+
+    qint64 ns = timer.nsecsElapsed();
+    stats.hits++;
+    stats.loadNs += ns;
+    stats.savedNs += header.compileNs - ns;
+    return true;
+}
+
+void ProgramCache::prepare(QOpenGLShaderProgram& prog)
+{
+    if(enabled())
+        ext->ProgramParameteri(prog.programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::save(QOpenGLShaderProgram& prog, const QByteArray& key, qint64 compileNs)
+{
+    if(!enabled())
+        return;
+
+    GLint length = 0;
+    ext->GetProgramiv(prog.programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0)
+        return;
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.compileNs = compileNs;
+
+    QByteArray data(sizeof(header) + length, '\0');
+    GLenum format = 0;
+    ext->GetProgramBinary(prog.programId(), length, &length, &format, data.data() + sizeof(header));
+    header.format = format;
+    std::memcpy(data.data(), &header, sizeof(header));
+    data.resize(sizeof(header) + length);
+
+    // written aside then renamed, a crash never leaves half a binary
+    QFile file(filename(key) + ".tmp");
+    if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        qDebug() << "Can't write the program cache" << file.fileName();
+        return;
+    }
+    file.close();
+    QFile::remove(filename(key));
+    file.rename(filename(key));
+}
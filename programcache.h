@@ -0,0 +1,54 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <QOpenGLShaderProgram>
+#include <QByteArray>
+#include <QString>
+
+#include "glextensions.h"
+
+/**
+ * @brief linked programs saved on disk with glGetProgramBinary, reloaded on the next launches
+ *
+ * A binary is found by a hash of the sources (defines included) and of the driver strings,
+ * a new driver or an edited shader simply misses. A binary the driver rejects is deleted
+ * and the program compiled from source again.
+ */
+class ProgramCache
+{
+public:
+    struct Stats {
+        int hits = 0;
+        int misses = 0;
+        int rejected = 0;   // found on disk but refused by the driver
+        qint64 loadNs = 0;  // spent loading the hits
+        qint64 savedNs = 0; // compile time of the hits when they were compiled, minus loadNs
+    } stats;
+
+    void initialize(GLExtensions* ext);
+    bool enabled() const { return !directory.isEmpty(); }
+
+    QByteArray key(const QByteArray& vertex, const QByteArray& fragment) const;
+
+    /**
+     * @brief links prog from the binary of key
+     * @return false if there is none or the driver rejects it, prog then has no shader and can be built from source
+     */
+    bool load(QOpenGLShaderProgram& prog, const QByteArray& key);
+
+    /**
+     * @brief call before linking a program that will be saved
+     */
+    void prepare(QOpenGLShaderProgram& prog);
+
+    void save(QOpenGLShaderProgram& prog, const QByteArray& key, qint64 compileNs);
+
+private:
+    GLExtensions* ext = nullptr;
+    QByteArray driver; // vendor, renderer and version strings
+    QString directory; // empty when disabled
+
+    QString filename(const QByteArray& key) const;
+};
+
+#endif // PROGRAMCACHE_H
@@ -0,0 +1,130 @@
+#include "qualitygovernor.h"
+
+#include <QStringList>
+#include <QLoggingCategory>
+
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(governorLog, "chess.governor", QtInfoMsg)
+
+bool QualityGovernor::Settings::operator ==(const Settings& o) const
+{
+    return nLights == o.nLights && lightingModel == o.lightingModel
+        && reflectFactor == o.reflectFactor && refractFactor == o.refractFactor
+        && antiAliasing == o.antiAliasing;
+}
+
+const QVector<QualityGovernor::Step>& QualityGovernor::defaultLadder()
+{
+    // cheap losses first, the lights last as they change the look of the scene the most
+    static const QVector<Step> ladder = {
+        ANTI_ALIASING, ANTI_ALIASING, REFRACTION, LIGHTING_MODEL,
+        ANTI_ALIASING, REFLECTION, LIGHTS, LIGHTS, ANTI_ALIASING,
+    };
+    return ladder;
+}
+
+void QualityGovernor::setLadder(const QVector<Step>& steps)
+{
+    rungs = steps;
+    reset();
+}
+
+void QualityGovernor::reset()
+{
+    myLevel = 0;
+    frames = 0;
+    beforeMs = -1;
+    savedMs.fill(0, rungs.size());
+}
+
+QualityGovernor::Settings QualityGovernor::apply(const Settings& wanted, int level) const
+{
+    // anti-aliasing modes from the cheapest
+    static const int aaOrder[] = {0, 4, 1, 2, 3};
+    auto aaRank = [](int mode) {
+        return int(std::find(aaOrder, aaOrder + 5, mode) - aaOrder);
+    };
+
+    Settings s = wanted;
+    for(int i = 0; i < level && i < rungs.size(); i++) {
+        switch(rungs[i]) {
+        case ANTI_ALIASING:
+            s.antiAliasing = aaOrder[std::max(0, aaRank(s.antiAliasing) - 1)];
+            break;
+        case REFRACTION:
+            s.refractFactor = 0;
+            break;
+        case REFLECTION:
+            s.reflectFactor = 0;
+            break;
+        case LIGHTING_MODEL:
+            if(s.lightingModel == 2)
+                s.lightingModel = 0;
+            break;
+        case LIGHTS:
+            s.nLights = std::max(1, s.nLights - 1);
+            break;
+        }
+    }
+    return s;
+}
+
+void QualityGovernor::control(double frameMs, double targetMs, const Settings& wanted, bool lower, bool raise)
+{
+    if(savedMs.size() != rungs.size())
+        reset();
+
+    // decided on smoothed times, after they had time to follow the last change
+    if(++frames < 60 || frameMs <= 0)
+        return;
+    frames = 0;
+
+    // what the last step down saved, known now that the times followed it
+    if(beforeMs >= 0) {
+        savedMs[myLevel - 1] = std::max(0.0, beforeMs - frameMs);
+        beforeMs = -1;
+    }
+
+    // rungs that change nothing with the user settings are passed over in both directions
+    if(frameMs > targetMs) {
+        if(!lower)
+            return;
+        Settings current = apply(wanted);
+        int next = myLevel;
+        do
+            next++;
+        while(next < rungs.size() && apply(wanted, next) == current);
+        if(apply(wanted, next) != current) {
+            myLevel = next;
+            beforeMs = frameMs;
+        }
+        return;
+    }
+
+    if(raise && myLevel > 0 && frameMs + savedMs[myLevel - 1] < 0.8 * targetMs) {
+        Settings current = apply(wanted);
+        do
+            myLevel--;
+        while(myLevel > 0 && apply(wanted) == current);
+    }
+}
+
+QString QualityGovernor::describe(const Settings& wanted) const
+{
+    static const char* names[] = {"anti-aliasing", "refraction", "reflection", "lighting model", "lights"};
+
+    QStringList lowered;
+    for(int i = 0; i < myLevel && i < rungs.size(); i++) {
+        QString name = names[rungs[i]];
+        if(!lowered.contains(name) && apply(wanted, i + 1) != apply(wanted, i))
+            lowered << name;
+    }
+    return lowered.join(", ");
+}
+
+void QualityGovernor::report(const Settings& wanted) const
+{
+    qCDebug(governorLog) << "quality governor: level" << myLevel << "/" << rungs.size()
+                         << "lowered:" << describe(wanted);
+}
@@ -0,0 +1,74 @@
+#ifndef QUALITYGOVERNOR_H
+#define QUALITYGOVERNOR_H
+
+#include <QVector>
+#include <QString>
+
+/**
+ * @brief steps the costly shading features down and back up to keep the frame time under a target
+ *
+ * The ladder is the order in which the features are given up, a feature can be on it several times
+ * to lose one notch each time. The level is the number of rungs taken down, 0 is the quality the user chose.
+ * Each decision waits for the smoothed times to follow the last change. Going down remembers what the rung saved,
+ * a rung is only taken back when the frame time plus that saving stays well under the target,
+ * so a rung that didn't pay is not taken back and forth.
+ */
+class QualityGovernor
+{
+public:
+    enum Step {
+        ANTI_ALIASING,  // one notch: MSAA 8x, 4x, 2x, FXAA, off
+        REFRACTION,     // refractFactor to 0, a cubemap fetch
+        REFLECTION,     // reflectFactor to 0, a cubemap fetch and the planar reflection
+        LIGHTING_MODEL, // Cook-Torrance to Phong
+        LIGHTS,         // one main light less, down to 1
+    };
+
+    struct Settings {
+        int nLights = 1;
+        int lightingModel = 0; // PHONG BLING-PHONG COOK
+        float reflectFactor = 0;
+        float refractFactor = 0;
+        int antiAliasing = 0;  // OFF MSAA_2X MSAA_4X MSAA_8X FXAA
+
+        bool operator ==(const Settings& o) const;
+        bool operator !=(const Settings& o) const { return !(*this == o); }
+    };
+
+    static const QVector<Step>& defaultLadder();
+
+    void setLadder(const QVector<Step>& steps);
+    const QVector<Step>& ladder() const { return rungs; }
+    int level() const { return myLevel; }
+    void reset();
+
+    /**
+     * @brief one decision every few frames, lower or raise false keep the level from going that way
+     */
+    void control(double frameMs, double targetMs, const Settings& wanted, bool lower = true, bool raise = true);
+
+    /**
+     * @brief the user settings with the rungs of the current level applied
+     */
+    Settings apply(const Settings& wanted) const { return apply(wanted, myLevel); }
+    Settings apply(const Settings& wanted, int level) const;
+
+    /**
+     * @brief features given up at the current level, for the UI
+     */
+    QString describe(const Settings& wanted) const;
+
+    /**
+     * @brief the level and what it gave up, on chess.governor (debug)
+     */
+    void report(const Settings& wanted) const;
+
+private:
+    QVector<Step> rungs = defaultLadder();
+    QVector<double> savedMs; // per rung, frame time it saved when it was taken down
+    int myLevel = 0;
+    int frames = 0;          // since the last decision
+    double beforeMs = -1;    // frame time before the last step down, until its saving is known
+};
+
+#endif // QUALITYGOVERNOR_H
@@ -0,0 +1,19 @@
+#include "renderqueue.h"
+
+void RenderQueue::sort()
+{
+    std::sort(queue.begin(), queue.end(), [](const Item& a, const Item& b) {
+        return a.key < b.key;
+    });
+
+    stats.items = queue.size();
+    stats.programChanges = stats.textureChanges = stats.meshChanges = 0;
+    for(int i = 0; i < queue.size(); i++) {
+        quint64 key = queue[i].key, last = i ? queue[i-1].key : 0;
+        bool programChanged = !i || programOf(key) != programOf(last);
+        stats.programChanges += programChanged;
+        stats.textureChanges += programChanged || textureOf(key) != textureOf(last);
+        stats.meshChanges += programChanged || meshOf(key) != meshOf(last);
+    }
+    stats.frames++;
+}
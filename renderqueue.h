@@ -0,0 +1,99 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <QVector>
+#include <QtGlobal>
+
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @brief list of draws sorted by a 64 bits key
+ * key = layer (4) | program (8) | texture (8) | mesh (12) | depth (32), most significant first
+ * so sorting groups the state changes and draws the items of a same state front to back.
+ */
+class RenderQueue
+{
+public:
+    enum Layer {
+        GBUFFER_LAYER = 0, // deferred path, lit in screen space before the other layers
+        OPAQUE_LAYER = 1,
+        LINES_LAYER = 2,
+        SKY_LAYER = 3, // last, at the far plane, only fills what is left
+    };
+
+    struct Item {
+        quint64 key;
+        int index; // given back at draw time, meaning depends on the program
+    };
+
+    struct Stats {
+        int items = 0;
+        int programChanges = 0;
+        int textureChanges = 0;
+        int meshChanges = 0;
+
+        // sky drawn last with GL_LEQUAL, samples it still had to shade and samples it didn't
+        qint64 skySamplesDrawn = 0;
+        qint64 skySamplesSaved = 0;
+        int skyFrames = 0; // frames counted in the two above
+        qint64 frames = 0;
+    } stats;
+
+    static quint64 makeKey(int layer, int program, int texture, int mesh, float depth) {
+        quint32 d; // positive floats keep their order when read as unsigned int
+        depth = std::max(0.f, depth);
+        std::memcpy(&d, &depth, sizeof(d));
+        return (quint64)(layer & 0xF) << 60
+             | (quint64)(program & 0xFF) << 52
+             | (quint64)(texture & 0xFF) << 44
+             | (quint64)(mesh & 0xFFF) << 32
+             | d;
+    }
+
+    static int layerOf(quint64 key)   { return (key >> 60) & 0xF; }
+    static int programOf(quint64 key) { return (key >> 52) & 0xFF; }
+    static int textureOf(quint64 key) { return (key >> 44) & 0xFF; }
+    static int meshOf(quint64 key)    { return (key >> 32) & 0xFFF; }
+
+    void clear() { queue.clear(); }
+    void push(quint64 key, int index) { queue.append({key, index}); }
+    int size() const { return queue.size(); }
+
+    /**
+     * @brief index of the first item of layer or of a later one, once sorted
+     */
+    int layerBegin(int layer) const {
+        quint64 key = (quint64)(layer & 0xF) << 60;
+        return std::lower_bound(queue.begin(), queue.end(), key, [](const Item& item, quint64 key) {
+            return item.key < key;
+        }) - queue.begin();
+    }
+
+    /**
+     * @brief sorts the keys and counts the state changes of the frame
+     */
+    void sort();
+
+    /**
+     * @brief calls draw(item, programChanged, textureChanged, meshChanged) on [begin, end) in key order
+     * the first item of the range always changes everything, so ranges can be drawn independently.
+     * Doesn't modify the queue, different ranges can be executed by different threads.
+     */
+    template <typename F>
+    void execute(int begin, int end, F draw) const {
+        for(int i = begin; i < end; i++) {
+            const Item& item = queue[i];
+            quint64 last = i == begin ? 0 : queue[i-1].key;
+            bool programChanged = i == begin || programOf(item.key) != programOf(last);
+            bool textureChanged = programChanged || textureOf(item.key) != textureOf(last);
+            bool meshChanged = programChanged || meshOf(item.key) != meshOf(last);
+            draw(item, programChanged, textureChanged, meshChanged);
+        }
+    }
+
+private:
+    QVector<Item> queue;
+};
+
+#endif // RENDERQUEUE_H
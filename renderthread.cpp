@@ -0,0 +1,72 @@
+#include "renderthread.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+
+RenderThread::RenderThread(QWindow* window, QOpenGLContext* context)
+    : window(window),
+      context(context)
+{
+}
+
+RenderThread::~RenderThread()
+{
+    stop();
+}
+
+void RenderThread::request()
+{
+    QMutexLocker lock(&mutex);
+    requested = true;
+    condition.wakeAll();
+}
+
+void RenderThread::wake()
+{
+    QMutexLocker lock(&mutex);
+    woken = true;
+    condition.wakeAll();
+}
+
+void RenderThread::stop()
+{
+    {
+        QMutexLocker lock(&mutex);
+        stopping = true;
+        condition.wakeAll();
+    }
+    wait();
+}
+
+void RenderThread::run()
+{
+    if(!context->makeCurrent(window)) {
+        qCritical() << "render thread: the context can't be made current on the window";
+        return;
+    }
+    initialize();
+
+    bool next = false;
+    for(;;) {
+        {
+            QMutexLocker lock(&mutex);
+            while(!requested && !woken && !next && !stopping)
+                condition.wait(&mutex);
+            if(stopping)
+                break;
+            next = next || requested;
+            requested = woken = false;
+        }
+
+        apply();
+        if(next) {
+            paint();
+            context->swapBuffers(window);
+            next = swapped();
+        }
+    }
+
+    cleanup();
+    context->doneCurrent();
+    context->moveToThread(QCoreApplication::instance()->thread()); // deleted there
+}
@@ -0,0 +1,57 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QOpenGLContext>
+#include <QWindow>
+
+#include <functional>
+
+/**
+ * @brief a thread that owns the GL context of a window: draws and swaps its frames, away from the event loop
+ *
+ * The context is created on the gui thread and moved here, then stays current on the window until stop.
+ * The thread sleeps until a request or a wake; on each wake it applies the edits sent to it, and on a request
+ * it paints and swaps. The swap waits for the vertical blank, so the frames that follow each other are paced by it.
+ */
+class RenderThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    RenderThread(QWindow* window, QOpenGLContext* context);
+    ~RenderThread(); // stops
+
+    // set before start, called on the thread with the context current
+    std::function<void()> initialize; // once, before the first frame
+    std::function<void()> apply; // on each wake, before the frame if any
+    std::function<void()> paint;
+    std::function<bool()> swapped; // true: the next frame right away
+    std::function<void()> cleanup; // last, before the context goes back to the gui thread
+
+    /**
+     * @brief any thread: a frame, coalesced with the other requests
+     */
+    void request();
+
+    /**
+     * @brief any thread: applies the edits without a frame
+     */
+    void wake();
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    QWindow* window;
+    QOpenGLContext* context;
+
+    QMutex mutex;
+    QWaitCondition condition;
+    bool requested = false, woken = false, stopping = false; // under the mutex
+};
+
+#endif // RENDERTHREAD_H
@@ -20,19 +20,33 @@
 #include <QRegularExpression>
 #include <QMap>
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
 
 #include <QOpenGLPixelTransferOptions>
+#include <QThread>
+#include <QLoggingCategory>
+#include <QElapsedTimer>
+#include <QDateTime>
 
 using std::min;
 using std::max;
 
 static const QVector<QVector<QVector2D>> letters = makeLetters();
 
+Q_LOGGING_CATEGORY(sceneLog, "chess.scene", QtInfoMsg)
+
 Scene::Scene()
     : surfVertexBuf(QOpenGLBuffer::VertexBuffer)
     , surfColorBuf(QOpenGLBuffer::VertexBuffer)
 {
     anim.scene = falling.scene = this;
+    simulation.step = [this](double t, double wall) {
+        step(t, wall);
+    };
+    simulation.idle = [this](double t) {
+        return idleTime(t);
+    };
     srand(time(0));
     lightColorsParam.scene = this;
     length = 3;
@@ -54,11 +68,35 @@ Scene::Scene()
 
     lights[1].pos = {4, 0, 0.5};
     lights[2].pos = {-4, 0, 0.5};
+
+    // the fields behind the Material block, see uploadMaterial
+    params.feed(chessShininess, Parameters::BLOCK_MATERIAL);
+    params.feed(cookLambda, Parameters::BLOCK_MATERIAL);
+    params.feed(cookRoughness, Parameters::BLOCK_MATERIAL);
+    params.feed(reflectFactor, Parameters::BLOCK_MATERIAL);
+    params.feed(refractFactor, Parameters::BLOCK_MATERIAL);
+    params.feed(refractIndice, Parameters::BLOCK_MATERIAL);
+
+    // the fields the steps read, written on the simulation thread once it runs
+    params.deliver(Parameters::THREAD_SIMULATION, [this](std::function<void()> edit){
+        simulation.post(edit);
+    });
+    for(const float* field : {&lightHeight, &lightRadius, &lightSpeed, &lightInitPos, &movementWaiting, &anim.duration,
+                              &falling.g, &falling.k, &falling.alpha, &falling.timeCutOff, &falling.startingHeight})
+        params.own(*field, Parameters::THREAD_SIMULATION);
+    params.own(anim.mode, Parameters::THREAD_SIMULATION);
 }
 
 Scene::~Scene() {
-    for(ChessPiece* p : chessPieces)
-        delete p;
+    simulation.stop(); // before the state it steps
+    qDeleteAll(programCache);
+
+    // the buffers of ext, the other GL objects free themselves; the context is current (see MyGLDrawer)
+    if(QOpenGLContext::currentContext()) {
+        if(materialBuffer)
+            ext.DeleteBuffers(1, &materialBuffer);
+        stream.destroy(); // the buffer and its fences
+    }
 }
 
 void Scene::glCheckError() {
@@ -108,30 +146,8 @@ void Scene::loadTextures() {
         glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTexture);
         */
 
-        QList<QStringList> names = {
-            {"1", "2", "3", "4", "5", "6"},
-            {"x", "-x", "y", "-y", "z", "-z"},
-            {"+x", "-x", "+y", "-y", "+z", "-z"},
-            {"right", "left", "back", "front", "up", "down"},
-            {"right", "left", "back", "front", "top", "bottom"},
-            {"R", "L", "B", "F", "U", "D"}, // rubix
-        };
-
         for(int i = 0; i < 6; i++) {
-            QImage image;
-
-            for(QStringList l: names)
-                if(image.isNull())
-                    image.load(F(":/textures/") + QString(cubeMapFilenames[n]).arg(l[i]));
-
-            if(image.isNull()) {
-                qCritical() << "Error loading cubemap " << (n+1) << "th cube map face " << names[0][i] << "(" << names[2][i] << ")";
-                exit(1); // two lines to flush the qCritical buffer !
-            }
-
-            image = image.mirrored(); // opengl convention y to up
-
-            QImage glImage = image.convertToFormat(QImage::Format_RGBA8888);
+            QImage glImage = cubeMapFace(n, i).convertToFormat(QImage::Format_RGBA8888);
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, glImage.width(), glImage.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, glImage.bits());
         }
 
@@ -146,56 +162,108 @@ void Scene::loadTextures() {
     glCheckError();
 }
 
+QImage Scene::cubeMapFace(int n, int face) const
+{
+    QList<QStringList> names = {
+        {"1", "2", "3", "4", "5", "6"},
+        {"x", "-x", "y", "-y", "z", "-z"},
+        {"+x", "-x", "+y", "-y", "+z", "-z"},
+        {"right", "left", "back", "front", "up", "down"},
+        {"right", "left", "back", "front", "top", "bottom"},
+        {"R", "L", "B", "F", "U", "D"}, // rubix
+    };
+
+    QImage image;
+
+    for(QStringList l: names)
+        if(image.isNull())
+            image.load(F(":/textures/") + QString(cubeMapFilenames[n]).arg(l[face]));
+
+    if(image.isNull()) {
+        qCritical() << "Error loading cubemap " << (n+1) << "th cube map face " << names[0][face] << "(" << names[2][face] << ")";
+        exit(1); // two lines to flush the qCritical buffer !
+    }
+
+    return image.mirrored(); // opengl convention y to up
+}
+
 void Scene::initialize()
 {
     glEnable(GL_DEPTH_TEST);
     // glEnable(GL_CULL_FACE); // default is glFrontFace​(GL_CCW);
 
+    ext.resolve(QOpenGLContext::currentContext());
+    if(ext.occlusionQuery)
+        ext.GenQueries(1, &skyQuery);
+    if(ext.timerQuery)
+        ext.GenQueries(1, &timeQuery);
+    glGetIntegerv(GL_SAMPLES, &viewportSamples);
+    viewportSamples = max(1, viewportSamples);
+
+    // per frame data goes through a stream buffer of uniform blocks when possible
+    streamed = ext.uniformBufferObject;
+    clusters.create(&ext);
+    resolution.create(&ext);
+    shadowMaps.create(&ext);
+
     prepareShaderProgram();
+
+    if(streamed) {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        uniformAlignment = max(16, alignment);
+        objectStride = (OBJECT_BYTES + uniformAlignment - 1) / uniformAlignment * uniformAlignment / sizeof(float);
+        streamed = stream.create(&ext, GL_UNIFORM_BUFFER, 256 * 1024);
+    }
     loadTextures();
     loadModels();
     prepareVertexBuffers();
 
+    simulation.applyEdits(); // the parameters posted before the thread runs
+    falling.start(0);
+    publish(0, simulation.clock());
+    simulation.start();
+}
+
+void Scene::initializeSoftware()
+{
+    // what initialize loads without GL, the images are loaded at the first frame
+    softwareBackend = true;
+    loadModels();
+
+    simulation.applyEdits();
     falling.start(0);
+    publish(0, simulation.clock());
+    simulation.start();
+    qDebug() << "software rasterizer:" << softRaster.threads() << "threads,"
+             << SoftRasterizer::TILE << "x" << SoftRasterizer::TILE << "tiles";
 }
 
 void Scene::loadModels() {
     chess.load(F(":/models/chess-one.obj"));
+    meshes = chess.objects.values().toVector();
 
-    chessPieces.reserve(16);
     for(int color = 0; color < 2; color++) {
-        for(int i = 0; i < 8; i++) {
-            chessPieces.append(new ChessPiece {
-                chess.beginOrder[i],
-                {i, color == 0 ? 0 : 7},
-                color
-            });
-        }
-
-        knights.append({
-            chessPieces[chessPieces.length() - 2],
-            chessPieces[chessPieces.length() - 7]
-        });
-
-        for(int i = 0; i < 8; i++) {
-            chessPieces.append(new ChessPiece {
-                chess.pawn,
-                {i, color == 0 ? 1 : 6},
-                color
-            });
-        }
+        for(int i = 0; i < 8; i++)
+            pieces.add(chess.beginOrder[i], {i, color == 0 ? 0 : 7}, color);
+        for(int i = 0; i < 8; i++)
+            pieces.add(chess.pawn, {i, color == 0 ? 1 : 6}, color);
     }
 }
 
-void Scene::update(double t)
+void Scene::updateCamera()
 {
     camera = lookAt + length * spherical(angleFromUp, angleOnGround);
-    light = vec3(lightRadius * polar(lightInitPos + linearAngle(t * lightSpeed)), lightHeight);
-
     v.setToIdentity();
     v.lookAt(camera, lookAt, {0, 0, 1});
+}
+
+void Scene::step(double t, double wall)
+{
+    if(fallRequested.fetchAndStoreOrdered(0))
+        falling.start(t);
 
-    if(!falling.running && t > timeEndKnightAnimation + movementWaiting && anim.state == anim.WAIT) {
+    if(!drawn && !falling.running && t > timeEndKnightAnimation + movementWaiting && anim.state == anim.WAIT) {
         // start anim
         int color = colorTurn;
         ++colorTurn %= 2;
@@ -222,20 +290,17 @@ void Scene::update(double t)
             proba.removeAt(types.indexOf(typ));
             types.removeOne(typ);
 
-            QList<ChessPiece*> myPieces;
-            for(ChessPiece* c : chessPieces)
-                if(c->color == color && c->type == typ)
-                    myPieces << c;
+            QList<Pieces::Handle> myPieces;
+            for(Pieces::Handle h = 0; h < pieces.size(); h++)
+                if(pieces.colors[h] == color && pieces.types[h] == typ)
+                    myPieces << h;
 
             auto inRange = [](QPoint p){
                 return 0 <= p.x() && p.x() < 8 && 0 <= p.y() && p.y() < 8;
             };
 
             auto emptyCase = [this](QPoint p) {
-                for(ChessPiece* c : chessPieces)
-                    if(c->position == p)
-                        return false;
-                return true;
+                return pieces.at(p) == Pieces::NONE;
             };
 
             QList<QPoint> mov = typ == chess.knight ? kni :
@@ -248,15 +313,16 @@ void Scene::update(double t)
             int baseRange = (typ == chess.pawn || typ == chess.king || typ == chess.knight) ? 1 : 10000;
 
             QList<QList<QPoint>> possib;
-            QMutableListIterator<ChessPiece*> it(myPieces);
+            QMutableListIterator<Pieces::Handle> it(myPieces);
             while(it.hasNext()){
                 possib.push_back({});
-                ChessPiece* pi = it.next();
-                int range = pi->type == chess.pawn && (pi->color == 0 && pi->position.y() == 1 || pi->color == 1 && pi->position.y() == 6) ? 2 : baseRange;
+                Pieces::Handle pi = it.next();
+                QPoint position = pieces.squares[pi];
+                int range = typ == chess.pawn && (color == 0 && position.y() == 1 || color == 1 && position.y() == 6) ? 2 : baseRange;
 
                 for(QPoint d : mov) {
                     int r = 1;
-                    QPoint p = pi->position + d;
+                    QPoint p = position + d;
                     while(r <= range && inRange(p) && emptyCase(p)) {
                         possib.back() << p;
                         p += d;
@@ -276,13 +342,22 @@ void Scene::update(double t)
                 anim.piece = myPieces[n];
                 anim.type = typ == chess.knight ? anim.preffered : anim.LIN;
                 anim.startTo(possib[n][rand() % possib[n].length()]);
+                auto square = [](QPoint p) {
+                    return QString(QChar('A' + p.x())) + QString::number(p.y() + 1);
+                };
+                moves << QString("%1 %2-%3").arg(played / 2 + 1).arg(square(anim.fr)).arg(square(anim.to));
+                if(moves.size() > HUD_MOVES)
+                    moves.removeFirst();
+                played++;
+                placement++; // the piece leaves the cached shadows
                 done = true;
             }
         }
 
         if(types.empty()) {
             qCritical() << "Draw ! Color " << color << " is PAT.";
-            exit(0);
+            drawn = true;
+            emit simulation.over(); // the gui quits
         }
     }
 
@@ -290,89 +365,353 @@ void Scene::update(double t)
         anim.update(t);
         if(anim.state == anim.DONE) {
             timeEndKnightAnimation = t;
+            placement++; // back in the cached shadows
             anim.state = anim.WAIT;
         }
     }
 
-    if(falling.running)
+    if(falling.running) {
         falling.update(t);
+        placement++;
+    }
+
+    publish(t, wall);
+}
+
+double Scene::idleTime(double t) const
+{
+    if(anim.state == anim.RUN || falling.running || lightSpeed != 0 || fallRequested.load())
+        return 0;
+    if(anim.state == anim.WAIT && !drawn)
+        return timeEndKnightAnimation + movementWaiting - t; // the next move
+    return -1;
+}
+
+void Scene::publish(double t, double wall)
+{
+    Snapshot& s = snapshots.back();
+    s.t = t;
+    s.wall = wall;
+    s.light = vec3(lightRadius * polar(lightInitPos + linearAngle(t * lightSpeed)), lightHeight);
+    s.lightSpeed = lightSpeed;
+
+    const Matrix boardA1 = Matrix().translate(-3.5, -3.5, 0);
+    s.models.resize(pieces.size());
+    s.squares = pieces.squares;
+    for(int ip = 0; ip < pieces.size(); ip++) {
+        auto m = boardA1;
+
+        if(anim.state == anim.RUN && anim.piece == ip)
+            m.translate(anim.pos3D);
+        else
+            m.translate(vec2(pieces.squares[ip]));
+
+        if(anim.state == anim.RUN && anim.piece == ip)
+            m.rotate(-90 + degrees(angle2D(vec2(anim.to - anim.fr))));
+        else
+            if(pieces.colors[ip] == 1)
+                m.rotate(180);
+
+        if(falling.running) {
+            float pos = pieces.heights[ip], top = pieces.tops[ip];
+            float diff = top - pos;
+            if(diff < 0) {
+                m.translate(0, 0, pos - top);
+            } else {
+                m.scale(1, 1, 1 - diff / top);
+            }
+        }
+
+        s.models[ip] = m;
+    }
+
+    s.piece = anim.piece;
+    s.moving = anim.state == anim.RUN;
+    s.curve = anim.type;
+    for(int i = 0; i < 4; i++)
+        s.points[i] = anim.P[i];
+    s.position = anim.pos3D;
+    s.from = anim.fr;
+    s.to = anim.to;
+    s.progress = anim.elapsed / anim.duration;
+    s.falling = falling.running;
+    s.animating = idleTime(t) == 0;
+    s.placement = placement;
+    s.moves = moves;
+    s.played = played;
+
+    snapshots.publish();
+}
+
+QVector3D Scene::Snapshot::rightVector() const
+{
+    return vec3(polar(angle2D(vec2(to - from)) - M_PI/2), 0);
+}
+
+bool Scene::isAnimating() const
+{
+    return latestState.animating || frameState.wall < latestState.wall // not drawn up to the last step yet
+        || latestState.lightSpeed != 0 // the cluster lights turn with the main one
+        || tournamentBoards > 0 || wallBenchmark.step >= 0
+        || softwareBenchmark || pathTracePending; // at the next frame
+}
+
+void Scene::startFalling()
+{
+    fallRequested.store(1);
+    simulation.wake();
+}
+
+void Scene::interpolate()
+{
+    updateCamera();
+
+    if(snapshots.fetch()) {
+        olderState = latestState;
+        latestState = snapshots.front();
+        if(olderState.models.isEmpty())
+            olderState = latestState; // the first one
+        if(latestState.played != olderState.played && onKnightAnim.isRunning)
+            onKnightAnim.start(); // a new move, the knight view looks ahead again
+    }
+
+    // a step behind the clock, so that it is between the two last steps
+    const Snapshot& a = olderState;
+    const Snapshot& b = latestState;
+    double wall = simulation.clock() - 1.0 / Simulation::STEPS_PER_SECOND;
+    float alpha = b.wall > a.wall ? clamp((wall - a.wall) / (b.wall - a.wall), 0.0, 1.0) : 1;
+
+    frameState = b;
+    frameState.t = a.t + alpha * (b.t - a.t);
+    frameState.wall = alpha < 1 ? a.wall + alpha * (b.wall - a.wall) : b.wall;
+    frameState.light = a.light + alpha * (b.light - a.light);
+    if(a.piece == b.piece && a.moving && b.moving)
+        frameState.position = a.position + alpha * (b.position - a.position);
+    if(a.models.size() == b.models.size()) {
+        // the blend of the matrices is the one of the translation and the scale while the rotation stays,
+        // the piece turns at once when its move starts or lands (see publish)
+        for(int ip = 0; ip < b.models.size(); ip++) {
+            bool turnsA = a.moving && a.piece == ip, turnsB = b.moving && b.piece == ip;
+            if(turnsA != turnsB || (turnsA && a.to - a.from != b.to - b.from))
+                continue; // b as it is
+            const float* ma = a.models[ip].constData();
+            const float* mb = b.models[ip].constData();
+            float* m = frameState.models[ip].data();
+            for(int k = 0; k < 16; k++)
+                m[k] = ma[k] + alpha * (mb[k] - ma[k]);
+        }
+    }
+
+    light = frameState.light;
+    if(frameState.placement != shadowPlacement) {
+        shadowMaps.invalidate();
+        shadowPlacement = frameState.placement;
+    }
+
+    // what only the frames draw, at the time of the frame
+    updatePointLights(frameState.t);
+    if(tournamentBoards > 0) {
+        if(tournament.boards() != tournamentBoards)
+            setupTournament(frameState.t);
+        tournament.update(frameState.t);
+    }
+}
+
+void Scene::setupTournament(double t)
+{
+    // the initial position of the scene on every board, a piece without its mesh stays off the boards
+    QVector<TournamentWall::Piece> pieces;
+    auto piece = [this, &pieces](OBJObject* type, int color, int square, bool king, bool pawn) {
+        int mesh = meshes.indexOf(type);
+        if(mesh < 0)
+            qDebug() << "tournament wall: a piece without mesh, left out";
+        pieces.append({(quint8) max(0, mesh), (quint8) color, (quint8) (mesh < 0 ? TournamentWall::NONE : square), king, pawn});
+    };
+    for(int color = 0; color < 2; color++) {
+        for(int i = 0; i < 8; i++)
+            piece(chess.beginOrder[i], color, (color == 0 ? 0 : 7) * 8 + i, chess.beginOrder[i] == chess.king, false);
+        for(int i = 0; i < 8; i++)
+            piece(chess.pawn, color, (color == 0 ? 1 : 6) * 8 + i, false, true);
+    }
+    tournament.setup(tournamentBoards, pieces, meshes.size(), t);
+}
+
+void Scene::updatePointLights(double t)
+{
+    // 4 rings over the board turning in alternate directions, rainbow colored
+    const int n = clusterLights;
+    const int rings = 4, perRing = (n + rings - 1) / rings;
+    pointLights.resize(n);
+
+    for(int i = 0; i < n; i++) {
+        int ring = i % rings;
+        float a = M_2PI * (i / rings) / perRing + (ring % 2 ? 1 : -1) * linearAngle(t * frameState.lightSpeed / (ring + 1));
+        float r = 1 + ring;
+
+        pointLights.x[i] = r * std::cos(a);
+        pointLights.y[i] = r * std::sin(a);
+        pointLights.z[i] = 0.3;
+        pointLights.radius[i] = 0.75;
+        pointLights.color[i] = 0.5 * vColor(QColor::fromHsvF((float) i / n, 1, 1));
+    }
 }
 
 void Scene::applyZoom(float zoom) {
     length = max(0.5, length - zoom * 0.25);
 }
 
-void Scene::render()
+const char* Scene::uniformNames[NUNIFORM] = {
+    "matrix", "model", "normalMatrix", "color", "camera", "light",
+    "shininess", "cookRoughness", "cookLambda",
+    "lights", "lightColors", "normalMap", "cubemap",
+    "reflectFactor", "refractFactor", "refractIndice", "degree", "P",
+    "clusterLights", "clusterItems", "clusterViewport", "clusterDepth",
+    "inversePV", "lightSphere", "lightColor", "boardOnly",
+    "gAlbedo", "gNormal", "gEmissive", "gDepth",
+    "shadowMap0", "shadowMap1", "shadowMap2", "shadowDepth", "shadowIndex",
+    "shadowOrigin0", "shadowOrigin1", "shadowOrigin2",
+    "planarReflection", "reflectionViewport", "sceneColor", "texelSize",
+};
+
+Scene::Frame Scene::beginFrame() const
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    Frame frame;
+    frame.camera = this->camera;
 
-    const QVector3D A1Coord = vec3(-3.5, -3.5, 0);
-    const Matrix boardA1 = Matrix().translate(A1Coord);
+    frame.pv = p * v;
 
-    QVector3D camera = this->camera;
+    QMatrix4x4 vPrime = v;
+    frame.view = v;
 
-    auto X = vec3(1,0,0), Y = vec3(0,1,0), Z = vec3(0,0,1);
+    if(onKnightAnim.isRunning && frameState.piece >= 0) {
+        vPrime = knightView(frame.camera);
+        frame.pv = p * vPrime;
+        frame.view = vPrime;
+    }
 
-    auto pv = p * v;
+    QMatrix4x4 newView = vPrime;
+    newView.setColumn(3, {0,0,0,1}); // remove translation
+    frame.sky = p * newView;
 
-    QMatrix4x4 vPrime = v;
+    return frame;
+}
 
-    if(onKnightAnim.isRunning && anim.piece) {
-        auto T = vec2(anim.to - anim.fr).normalized();
-        auto R = anim.rightVector();
-        auto t = anim.piece->type;
-        auto H = t->geom.size.z();
-        auto e = A1Coord + -T*0.2 + anim.pos3D + Z * (t == chess.knight ? 2 : H + 0.5 );
-        auto d = vec3(T, -1);
-        QMatrix4x4 dt;
-
-        dt.rotate(degrees(onKnightAnim.lookAround), Z);
-        // dt.rotate(5 * std::sin(2 * 2 * M_PI * anim.elapsed / anim.duration), Z);
-        dt.rotate(degrees(onKnightAnim.inclinaison), R);
-        d = dt.mapVector(d);
-        vPrime.setToIdentity();
-        vPrime.lookAt(e, e + d, Z);
-        pv = p * vPrime;
-        camera = e;
-    }
-
-    // first, cube map
-    {
-        glDepthMask(GL_FALSE);// Remember to turn depth writing off
+QMatrix4x4 Scene::knightView(QVector3D& eye) const
+{
+    const QVector3D A1Coord = vec3(-3.5, -3.5, 0);
+    auto Z = vec3(0,0,1);
+
+    auto T = vec2(frameState.to - frameState.from).normalized();
+    auto R = frameState.rightVector();
+    auto t = pieces.types[frameState.piece];
+    auto H = t->geom.size.z();
+    auto e = A1Coord + -T*0.2 + frameState.position + Z * (t == chess.knight ? 2 : H + 0.5 );
+    auto d = vec3(T, -1);
+    QMatrix4x4 dt;
+
+    dt.rotate(degrees(onKnightAnim.lookAround), Z);
+    // dt.rotate(5 * std::sin(2 * 2 * M_PI * anim.elapsed / anim.duration), Z);
+    dt.rotate(degrees(onKnightAnim.inclinaison), R);
+    d = dt.mapVector(d);
+
+    QMatrix4x4 view;
+    view.lookAt(e, e + d, Z);
+    eye = e;
+    return view;
+}
 
-        auto& prog = cubeMapProg;
-        auto& vao = cubeMapVAO;
-        prog.bind();
-        vao.bind();
+Scene::Frame Scene::insetFrame(int view, float aspect) const
+{
+    Frame frame;
+    QMatrix4x4 perspective;
+    perspective.perspective(fovy, aspect, zNear, zFar);
 
-        QMatrix4x4 newView = vPrime;
-        newView.setColumn(3, {0,0,0,1}); // remove translation
+    if(view == KNIGHT_VIEW) {
+        frame.view = knightView(frame.camera);
+        frame.pv = perspective * frame.view;
+    } else {
+        // straight down on the board and its border
+        const float half = 5;
+        QMatrix4x4 ortho;
+        ortho.ortho(-half * max(1.f, aspect), half * max(1.f, aspect), -half / min(1.f, aspect), half / min(1.f, aspect), 1, 20);
+        frame.camera = vec3(0, 0, 10);
+        frame.view.lookAt(frame.camera, vec3(0, 0, 0), vec3(0, 1, 0));
+        frame.pv = ortho * frame.view;
+    }
 
-        prog.setUniformValue("matrix", p * newView);
-        prog.setUniformValue("cubemap", 0);
+    // the cubemap needs a perspective, whatever the projection of the view
+    QMatrix4x4 rotation = frame.view;
+    rotation.setColumn(3, {0,0,0,1});
+    frame.sky = perspective * rotation;
 
-        glActiveTexture(GL_TEXTURE0);
-        cubeMapTextures[currentCubeMap]->bind(0);
-        glDrawArrays(GL_QUADS, 0, 6 * 4);
+    return frame;
+}
 
-        vao.release();
-        prog.release();
+void Scene::render()
+{
+    if(softwareBackend) {
+        renderSoftware();
+        return;
+    }
 
-        glDepthMask(GL_TRUE);
+    QElapsedTimer cpuTime;
+    cpuTime.start();
+    if(wallBenchmark.step >= 0)
+        stepWallBenchmark();
+    bool timing = ext.timerQuery && !timeQueryPending;
+    if(timing)
+        ext.BeginQuery(GL_TIME_ELAPSED, timeQuery);
+
+    // with the dynamic resolution the scene is drawn offscreen at the size the controller chose
+    scaled = dynamicResolution > 0 && ext.framebufferObject;
+    if(scaled) {
+        resolution.control(max(myFrameTimes.cpuMs, myFrameTimes.gpuMs), targetFrameMs, minResolutionScale);
+        scaled = resolution.prepare();
+    } else {
+        resolution.reset();
+    }
+    viewportWidth = scaled ? resolution.width() : windowWidth;
+    viewportHeight = scaled ? resolution.height() : windowHeight;
+    outputFramebuffer = scaled ? resolution.framebuffer() : QOpenGLContext::currentContext()->defaultFramebufferObject();
+    myFrameTimes.resolutionScale = scaled ? resolution.scale() : 1;
+
+    // the governor gives up features after the dynamic resolution gave up pixels, and takes them back first
+    QualityGovernor::Settings wanted = wantedQuality();
+    if(qualityGovernor) {
+        bool lower = !scaled || resolution.scale() <= minResolutionScale;
+        bool raise = !scaled || resolution.scale() >= 1;
+        governor.control(max(myFrameTimes.cpuMs, myFrameTimes.gpuMs), targetFrameMs, wanted, lower, raise);
+    } else {
+        governor.reset();
     }
+    quality = governor.apply(wanted);
+    myFrameTimes.qualityLevel = governor.level();
+    myFrameTimes.qualityLevels = governor.ladder().size();
+
+    // anti-aliasing in its own target, resolved or filtered to the output at the end
+    aaMode = quality.antiAliasing == 0 ? AntiAliasing::OFF : quality.antiAliasing == 4 ? AntiAliasing::FXAA : AntiAliasing::MSAA;
+    if(aaMode != AntiAliasing::OFF && !aaTarget.prepare(&ext, aaMode, 1 << quality.antiAliasing, viewportWidth, viewportHeight))
+        aaMode = AntiAliasing::OFF;
+    sceneFramebuffer = aaMode != AntiAliasing::OFF ? aaTarget.framebuffer() : outputFramebuffer;
+    viewportSamples = aaMode == AntiAliasing::MSAA ? aaTarget.samples() : 1;
+
+    bindSceneFramebuffer();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    Frame frame = beginFrame();
 
     // surface
     for(;;){
         break;
-        auto& prog = surfProg;
+        auto& prog = *surfProg;
         QMatrix4x4 m;
         surfVAO.bind(); // glBindVertexArray(vao)
         prog.bind();
 
-        prog.setUniformValue("camera", camera);
+        prog.setUniformValue("camera", frame.camera);
         prog.setUniformValue("light", light);
 
-        prog.setUniformValue("matrix", pv * m);
+        prog.setUniformValue("matrix", frame.pv * m);
         prog.setUniformValue("normMatrix", m.normalMatrix()); // m.inverted().transposed());
 
         prog.setUniformValue("diag", 0); // texture unit 0
@@ -387,154 +726,1360 @@ void Scene::render()
         // mShaderProgram.release(); // glUseProgram(0)
     }
 
-    // lamp
-    {
-        auto& prog = lightProg;
+    selectPrograms();
+    if(walled)
+        drawTournament();
+    else
+        drawBoard(frame);
+
+    if(aaMode != AntiAliasing::OFF)
+        resolveAntiAliasing();
+
+    // the cpu draws the same frame, compared to the GL one before the upscale and the overlays
+    if(softwareBenchmark && !walled) {
+        softwareBenchmark = false;
+        benchmarkSoftware(frame);
+    }
+    if(pathTracePending && !walled)
+        beginPathTrace(frame);
+
+    if(scaled)
+        upscale();
+
+    if(multiView && !walled)
+        renderInsets();
+
+    if(streamed && !walled)
+        stream.endFrame(); // begun by drawBoard, the insets use the same region
+
+    if(hud)
+        drawHUD(frame);
+
+    if(timing) {
+        ext.EndQuery(GL_TIME_ELAPSED);
+        timeQueryPending = true;
+    }
+
+    countSkySamples();
+    countFrameTime(cpuTime.nsecsElapsed());
+    if(++reportFrames == REPORT_FRAMES)
+        report();
+}
+
+void Scene::drawBoard(const Frame& frame)
+{
+    fillRenderQueue(frame);
+    renderQueue.sort();
+
+    if(shadowLights)
+        updateShadows();
+
+    reflectionRefreshed = false;
+    if(reflected)
+        updateReflection(frame);
+
+    if(clustered) {
+        clusters.build(pointLights, frame.view, p, zNear, zFar);
+        clusters.upload(pointLights, CLUSTER_LIGHTS_UNIT, CLUSTER_ITEMS_UNIT);
+    }
+
+    int n = renderQueue.size();
+
+    if(streamed) {
+        // bezier draws 3 objects, each list may lose an alignment, the deferred path draws the queue in two ranges,
+        // the insets draw the same queue again in the same region
+        int lists = 2;
+        int needed = (FRAME_BYTES + (n + 3) * objectStride * sizeof(float)) + (lists + 1) * uniformAlignment;
+        needed *= multiView ? 1 + NINSET : 1;
+        if(needed > stream.regionSize())
+            stream.create(&ext, GL_UNIFORM_BUFFER, 2 * needed);
+    }
+
+    if(streamed) {
+        stream.beginFrame();
+        uploadFrame(frame);
+        uploadMaterial();
+    }
+
+    if(deferred) {
+        // pieces and board to the G-buffer, lit in screen space, then the forward draws on top
+        if(gbuffer.width() != viewportWidth || gbuffer.height() != viewportHeight)
+            gbuffer.create(&ext, viewportWidth, viewportHeight);
+
+        int split = renderQueue.layerBegin(RenderQueue::OPAQUE_LAYER);
+        gbuffer.bind();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawRange(frame, 0, split);
+        bindSceneFramebuffer();
+
+        lightGBuffer(frame);
+        drawRange(frame, split, n);
+    } else {
+        drawRange(frame, 0, n);
+    }
+}
+
+Scene::Frame Scene::wallFrame() const
+{
+    // the camera of the scene, pulled back in proportion to the wall
+    float scale = max(1.f, tournament.extent() / 10);
+    Frame frame;
+    frame.camera = lookAt + scale * (camera - lookAt);
+    frame.view.lookAt(frame.camera, lookAt, {0, 0, 1});
+
+    QMatrix4x4 projection;
+    projection.perspective(fovy, (float) viewportWidth / viewportHeight, zNear * scale, zFar * scale);
+    frame.pv = projection * frame.view;
+    frame.sky = frame.pv; // no sky on the wall
+    return frame;
+}
+
+void Scene::drawTournament()
+{
+    Frame frame = wallFrame();
+    tournament.instances(wallData, wallFirst, wallCount);
+    const int boards = meshes.size();
+
+    // new storage each frame, the driver keeps the old one for the frames still in flight
+    wallInstances.bind();
+    wallInstances.allocate(wallData.constData(), wallData.size() * sizeof(float));
+
+    wallVAO.bind();
+    auto use = [this, &frame](Program* p) -> QOpenGLShaderProgram& {
+        QOpenGLShaderProgram& prog = p->program;
         prog.bind();
-        lightVAO.bind();
+        prog.setUniformValue(p->uniformLocations[U_MATRIX], frame.pv);
+        prog.setUniformValue(p->uniformLocations[U_CAMERA], frame.camera);
+        prog.setUniformValue(p->uniformLocations[U_LIGHT], light.normalized());
+        return prog;
+    };
+    auto instances = [this](QOpenGLShaderProgram& prog, int first) {
+        wallInstances.bind();
+        prog.setAttributeBuffer(4, GL_FLOAT, first * 4 * sizeof(float), 4);
+    };
 
-        // grid and lamp
-        {
-            /*
-            prog.setUniformValue("matrix", pv);
-            glDrawArrays(GL_LINES, 6 * 3 * 4, 9 * 4);
-            */
+    // the pieces of every board, one draw per mesh
+    QOpenGLShaderProgram& pieces = use(programs[PROG_WALL]);
+    for(int mesh = 0; mesh < meshes.size(); mesh++) {
+        int count = wallCount[mesh];
+        if(!count)
+            continue;
+
+        OBJObject* obj = meshes[mesh];
+        obj->bufferVertices.bind();
+        pieces.setAttributeBuffer(0, GL_FLOAT, 0, 3);
+        obj->bufferNormals.bind();
+        pieces.setAttributeBuffer(1, GL_FLOAT, 0, 3);
+        instances(pieces, wallFirst[mesh]);
+
+        if(obj->triangles.size()) {
+            obj->bufferTriangles.bind();
+            ext.DrawElementsInstanced(GL_TRIANGLES, obj->triangles.size(), GL_UNSIGNED_INT, nullptr, count);
+        }
+        if(obj->quads.size()) {
+            obj->bufferQuads.bind();
+            ext.DrawElementsInstanced(GL_QUADS, obj->quads.size(), GL_UNSIGNED_INT, nullptr, count);
+        }
+    }
 
-            for(int i = 0; i < nLights; i++) {
-                QMatrix4x4 m;
+    // the boards, the quad of the screen space passes
+    QOpenGLShaderProgram& board = use(programs[PROG_WALL_BOARD]);
+    quadBuffer.bind();
+    board.setAttributeBuffer(0, GL_FLOAT, 0, 2);
+    board.disableAttributeArray(1);
+    instances(board, wallFirst[boards]);
+    ext.DrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, wallCount[boards]);
+    board.enableAttributeArray(1);
+}
 
-                m.translate(lights[i].pos);
-                m.scale(0.1);
+void Scene::startWallBenchmark()
+{
+    auto& bench = wallBenchmark;
+    if(bench.step >= 0)
+        return;
+    if(!ext.instancing) {
+        qDebug() << "tournament wall benchmark: no instancing, the wall falls back to the board, nothing to measure";
+        return;
+    }
 
-                prog.setUniformValue("color", lights[i].color);
-                prog.setUniformValue("matrix", pv * m);
-                glDrawArrays(GL_QUADS, 0, 6 * 3 * 4);
-            }
+    bench.boards = tournamentBoards;
+    bench.step = 0;
+    bench.frames = WALL_BENCHMARK_FRAMES - 1; // the first step starts at the next frame
+    qDebug() << "tournament wall benchmark:" << WALL_BENCHMARK_WARMUP << "frames of warmup," << WALL_BENCHMARK_FRAMES - WALL_BENCHMARK_WARMUP << "measured";
+}
+
+void Scene::stepWallBenchmark()
+{
+    static const int counts[] = {1, 4, 16, 64, 256, 1024};
+    const int steps = sizeof(counts) / sizeof(*counts);
+    auto& bench = wallBenchmark;
+
+    if(++bench.frames < WALL_BENCHMARK_FRAMES)
+        return;
+
+    // report the step that ends, then start the next one
+    if(bench.step > 0)
+        qDebug() << "  " << tournamentBoards << "boards," << tournamentBoards * TournamentWall::PIECES << "pieces"
+                 << (walled ? ":" : "not drawn, the board instead:")
+                 << "cpu" << (bench.cpuFrames ? bench.cpuNs / bench.cpuFrames / 1e6 : 0) << "ms"
+                 << "gpu" << (bench.gpuFrames ? bench.gpuNs / bench.gpuFrames / 1e6 : 0) << "ms";
+
+    bench.frames = 0;
+    bench.cpuNs = bench.gpuNs = 0;
+    bench.cpuFrames = bench.gpuFrames = 0;
+
+    if(bench.step == steps) {
+        tournamentBoards = bench.boards;
+        bench.step = -1;
+        return;
+    }
+    tournamentBoards = counts[bench.step++];
+}
+
+void Scene::renderSoftware()
+{
+    QElapsedTimer cpuTime;
+    cpuTime.start();
+
+    // no governor nor dynamic resolution, the frame time is the one of the cpu
+    quality = wantedQuality();
+    viewportWidth = windowWidth;
+    viewportHeight = windowHeight;
+
+    Frame frame = beginFrame();
+    if(softwareBenchmark) {
+        softwareBenchmark = false;
+        benchmarkSoftware(frame);
+    }
+    if(pathTracePending)
+        beginPathTrace(frame);
+    drawSoftware(frame, viewportWidth, viewportHeight);
+
+    countFrameTime(cpuTime.nsecsElapsed());
+}
+
+const QImage& Scene::drawSoftware(const Frame& frame, int width, int height)
+{
+    if(softwareCubeMap < 0)
+        softRaster.setNormalMap(QImage(F(":/textures/normal-map.png")));
+    if(softwareCubeMap != currentCubeMap.v) {
+        QVector<QImage> faces;
+        for(int i = 0; i < 6; i++)
+            faces.append(cubeMapFace(currentCubeMap.v, i));
+        softRaster.setCubeMap(faces);
+        softwareCubeMap = currentCubeMap.v;
+    }
+
+    // the uniforms of the forward programs
+    SoftRasterizer::Settings settings;
+    settings.pv = frame.pv;
+    settings.sky = frame.sky;
+    settings.camera = frame.camera;
+    for(int i = 0; i < clamp(quality.nLights, 1, 10); i++)
+        settings.lights.append({lights[i].pos, lights[i].color});
+    settings.lightingModel = clamp(quality.lightingModel, 0, 2);
+    settings.shininess = chessShininess;
+    settings.cookLambda = cookLambda;
+    settings.cookRoughness = cookRoughness;
+    settings.reflectFactor = quality.reflectFactor;
+    settings.refractFactor = quality.refractFactor;
+    settings.refractIndice = refractIndice;
+
+    // the queue of the GL path, without the lamps and the bezier, the sky is where nothing was drawn
+    const Matrix boardA1 = Matrix().translate(-3.5, -3.5, 0);
+    fillRenderQueue(frame);
+    softRaster.begin(width, height, settings);
+    renderQueue.execute(0, renderQueue.size(), [this, &boardA1](const RenderQueue::Item& item, bool, bool, bool) {
+        switch(RenderQueue::programOf(item.key)) {
+        case PROG_CHESS: {
+            softRaster.drawMesh(pieces.types[item.index], pieceModels[item.index], pieces.colors[item.index]);
+            break;
+        }
+        case PROG_BOARD: {
+            int i = item.index / 8, j = item.index % 8;
+            softRaster.drawSquare(boardA1.translated(i, j), (i + j) % 2);
+            break;
+        }
         }
+    });
+    return softRaster.end();
+}
+
+void Scene::beginPathTrace(const Frame& frame)
+{
+    pathTracePending = false;
+    if(pathTracer.isRunning()) {
+        qDebug() << "path tracer: still busy with the last still";
+        return;
     }
 
-    // chess
-    {
-        auto& prog = chessProg;
-        prog.bind();
-        chessVAO.bind();
+    // a copy of what the frame shows, the scene goes on while it traces
+    pathTracer.clear();
+    pathTracer.setCamera(frame.pv);
+    QVector<QImage> faces;
+    for(int i = 0; i < 6; i++)
+        faces.append(cubeMapFace(currentCubeMap.v, i));
+    pathTracer.setEnvironment(faces);
+    for(int i = 0; i < clamp(quality.nLights, 1, 10); i++)
+        pathTracer.addLight(lights[i].pos, lights[i].color);
+
+    // the colors of chess.frag and board.frag
+    fillRenderQueue(frame);
+    const Matrix boardA1 = Matrix().translate(-3.5, -3.5, 0);
+    renderQueue.execute(0, renderQueue.size(), [this, &boardA1](const RenderQueue::Item& item, bool, bool, bool) {
+        switch(RenderQueue::programOf(item.key)) {
+        case PROG_CHESS: {
+            QVector3D albedo = pieces.colors[item.index] == 0 ? QVector3D(1, 0.5, 0) : QVector3D(0, 0.5, 1);
+            pathTracer.addMesh(pieces.types[item.index], pieceModels[item.index], albedo, chessShininess);
+            break;
+        }
+        case PROG_BOARD: {
+            int i = item.index / 8, j = item.index % 8;
+            QVector3D albedo = (i + j) % 2 == 0 ? QVector3D(0.29, 0.15, 0) : QVector3D(0.8, 0.8, 0.8);
+            pathTracer.addSquare(boardA1.translated(i, j), albedo, 32, quality.reflectFactor);
+            break;
+        }
+        }
+    });
 
-        prog.setUniformValue("light", light);
-        prog.setUniformValue("camera", camera);
-        prog.setUniformValue("shininess", chessShininess);
-        prog.setUniformValue("cookRoughness", cookRoughness);
-        prog.setUniformValue("cookLambda", cookLambda);
-        prog.setUniformValue("lightingModel", (int)lightingModel);
-
-        int ip = 0;
-        for(ChessPiece* p : chessPieces) {
-            auto m = boardA1;
-            auto obj = p->type;
-
-            if(anim.state == anim.RUN && anim.piece == p)
-                m.translate(anim.pos3D);
-            else
-                m.translate(vec2(p->position));
-
-            if(anim.state == anim.RUN && anim.piece == p)
-                m.rotate(-90 + degrees(angle2D(vec2(anim.to - anim.fr))));
-            else
-                if(p->color == 1)
-                    m.rotate(180);
-
-            if(falling.running) {
-                auto& pos = falling.positions[ip];
-                float diff = obj->geom.size.z() - pos;
-                if(diff < 0) {
-                    m.translate(0, 0, pos - obj->geom.size.z());
-                } else {
-                    m.scale(1, 1, 1 - diff / obj->geom.size.z());
-                }
-            }
+    QString fileName = QDateTime::currentDateTime().toString("'still-'yyyyMMdd-hhmmss'.png'");
+    if(pathTracer.start(viewportWidth, viewportHeight, PATH_TRACE_SAMPLES, fileName))
+        qDebug() << "path tracer:" << PATH_TRACE_SAMPLES << "samples per pixel to" << fileName;
+}
 
-            prog.setUniformValue("color", p->color);
-            prog.setUniformValue("model", m);
-            prog.setUniformValue("matrix", pv * m);
-            prog.setUniformValue("normalMatrix", m.normalMatrix());
+Scene::Pick Scene::pick(QPointF pixel)
+{
+    QElapsedTimer timer;
+    timer.start();
+    Pick result;
+
+    // from the near plane to the far one, p * vPrime when the camera rides the knight
+    Frame frame = beginFrame();
+    QMatrix4x4 inverse = frame.pv.inverted();
+    float x = 2 * pixel.x() / windowWidth - 1, y = 1 - 2 * pixel.y() / windowHeight;
+    QVector3D near = inverse.map(QVector3D(x, y, -1));
+    QVector3D dir = (inverse.map(QVector3D(x, y, 1)) - near).normalized();
+
+    // the models of the last frame, the ray goes to object space where the bounds and the BVH are
+    struct Candidate {
+        int piece;
+        float t; // entry in the bounds
+        QVector3D origin, direction;
+    };
+    QVector<Candidate> candidates;
+    for(int ip = 0; ip < min(pieceModels.size(), pieces.size()); ip++) {
+        const OBJObject::Geometry& g = pieces.types[ip]->geom;
+        QMatrix4x4 toObject = pieceModels[ip].inverted();
+        QVector3D o = toObject.map(near), d = toObject.mapVector(dir); // same t as in the world
+
+        float t0 = 0, t1 = 1e30f;
+        for(int a = 0; a < 3 && t0 <= t1; a++) {
+            if(d[a] == 0) {
+                // parallel to the slab, inside it all along or never
+                if(o[a] < g.min[a] || o[a] > g.max[a])
+                    t1 = -1;
+                continue;
+            }
+            float ta = (g.min[a] - o[a]) / d[a], tb = (g.max[a] - o[a]) / d[a];
+            t0 = max(t0, min(ta, tb));
+            t1 = min(t1, max(ta, tb));
+        }
+        if(t0 <= t1)
+            candidates.append({ip, t0, o, d});
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.t < b.t;
+    });
+    result.candidates = candidates.size();
+
+    float nearest = 1e30f;
+    for(const Candidate& c : candidates) {
+        if(c.t >= nearest)
+            break; // the other bounds are behind the hit
+        Bvh::Ray ray;
+        ray.origin = c.origin;
+        ray.direction = c.direction;
+        ray.tMax = nearest;
+        Bvh::Hit hit;
+        if(meshBvh(pieces.types[c.piece]).intersect(ray, hit)) {
+            nearest = hit.t;
+            result.piece = c.piece;
+        }
+    }
 
-            obj->bufferVertices.bind();
-            prog.setAttributeBuffer("vertexPosition", GL_FLOAT, 0, 3); // glVertexAttribPointer(...) // one vertexPosition is 3 floats with offset 0, (stride 0)
-            obj->bufferNormals.bind();
-            prog.setAttributeBuffer("vertexNormal", GL_FLOAT, 0, 3);
-            obj->draw();
-            ip++;
+    if(result.piece >= 0) {
+        result.t = nearest;
+        result.square = frameState.squares[result.piece];
+    } else if(dir.z() != 0) {
+        // the board, z = 0 from A1 at (-4,-4) to H8 at (4,4)
+        float t = -near.z() / dir.z();
+        QVector3D P = near + t * dir;
+        int i = std::floor(P.x() + 4), j = std::floor(P.y() + 4);
+        if(t > 0 && i >= 0 && i < 8 && j >= 0 && j < 8) {
+            result.t = t;
+            result.square = QPoint(i, j);
         }
     }
 
-    // board
-    {
-        auto& prog = boardProg;
-        prog.bind();
-        boardVAO.bind();
+    result.ns = timer.nsecsElapsed();
+    return result;
+}
+
+const Bvh& Scene::meshBvh(const OBJObject* obj)
+{
+    auto it = meshBvhs.find(obj);
+    if(it != meshBvhs.end())
+        return *it;
+
+    QVector<QVector3D> vertices;
+    for(int i = 0; i + 2 < obj->triangles.size(); i += 3)
+        vertices << obj->vertices[obj->triangles[i]] << obj->vertices[obj->triangles[i+1]] << obj->vertices[obj->triangles[i+2]];
+    for(int i = 0; i + 3 < obj->quads.size(); i += 4) {
+        vertices << obj->vertices[obj->quads[i]] << obj->vertices[obj->quads[i+1]] << obj->vertices[obj->quads[i+2]];
+        vertices << obj->vertices[obj->quads[i]] << obj->vertices[obj->quads[i+2]] << obj->vertices[obj->quads[i+3]];
+    }
+
+    Bvh& bvh = meshBvhs[obj];
+    bvh.build(vertices);
+    qDebug() << "pick: BVH of" << bvh.stats.triangles << "triangles," << bvh.stats.nodes << "nodes, depth"
+             << bvh.stats.depth << ", built in" << bvh.stats.buildNs / 1e6 << "ms";
+    return bvh;
+}
+
+void Scene::benchmarkSoftware(const Frame& frame)
+{
+    // the GL image of the frame, read before the cpu draws the same one
+    QImage gl;
+    if(!softwareBackend) {
+        gl = QImage(viewportWidth, viewportHeight, QImage::Format_RGBA8888);
+        ext.BindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+        glReadPixels(0, 0, viewportWidth, viewportHeight, GL_RGBA, GL_UNSIGNED_BYTE, gl.bits());
+        gl = gl.mirrored(); // rows from the bottom
+    }
+
+    qDebug() << "software rasterizer benchmark:" << viewportWidth << "x" << viewportHeight << ","
+             << SOFTWARE_BENCHMARK_FRAMES << "frames per thread count";
+
+    const int cores = max(1, QThread::idealThreadCount());
+    for(int threads = 1; ; threads = min(2 * threads, cores)) {
+        softRaster.setThreads(threads);
+        drawSoftware(frame, viewportWidth, viewportHeight);
+
+        QElapsedTimer timer;
+        timer.start();
+        qint64 setupNs = 0, rasterNs = 0;
+        for(int i = 0; i < SOFTWARE_BENCHMARK_FRAMES; i++) {
+            drawSoftware(frame, viewportWidth, viewportHeight);
+            setupNs += softRaster.stats.setupNs;
+            rasterNs += softRaster.stats.rasterNs;
+        }
+        double ms = timer.nsecsElapsed() / 1e6 / SOFTWARE_BENCHMARK_FRAMES;
+        qDebug() << "  " << threads << "threads:" << 1000 / ms << "fps," << ms << "ms,"
+                 << "setup" << setupNs / 1e6 / SOFTWARE_BENCHMARK_FRAMES << "ms,"
+                 << "tiles" << rasterNs / 1e6 / SOFTWARE_BENCHMARK_FRAMES << "ms,"
+                 << softRaster.stats.triangles << "triangles," << softRaster.stats.binned << "in the tiles";
+
+        if(threads == cores)
+            break;
+    }
+    softRaster.setThreads(0);
+
+    if(!gl.isNull()) {
+        const int tolerance = 8;
+        SoftRasterizer::Difference d = SoftRasterizer::compare(gl, softRaster.image(), tolerance);
+        qDebug() << "  difference with GL: mean" << d.mean << "max" << d.max << ","
+                 << 100 * d.over << "% of the pixels over" << tolerance
+                 << (d.over < 0.02 ? "(within tolerance)" : "(over tolerance, see the effects the cpu doesn't draw: lamps, shadows, planar reflection, clusters, anti-aliasing)");
+    }
+}
 
-        prog.setUniformValue("camera", camera);
-        prog.setUniformValue("nLights", nLights);
-        for(int i = 0; i < nLights; i++) {
-            prog.setUniformValue(("lights[" + QString::number(i) + "]").toStdString().c_str(), lights[i].pos);
-            prog.setUniformValue(("lightColors[" + QString::number(i) + "]").toStdString().c_str(), lights[i].color);
+void Scene::drawHUD(const Frame& frame)
+{
+    const float size = 12, line = 1.6 * size, margin = 10;
+    const QVector3D white(1, 1, 1), yellow(1, 0.9, 0.3);
+    const FrameTimes& t = myFrameTimes;
+    hudText.clear();
+
+    // frame statistics, top left
+    float y = margin;
+    hudText.text(QString("FPS %1").arg(t.intervalMs > 0 ? qRound(1000 / t.intervalMs) : 0), margin, y, size, yellow); // while it draws
+    y += line;
+    hudText.text(QString("CPU %1 MS GPU %2 MS").arg(t.cpuMs, 0, 'f', 2).arg(t.gpuMs, 0, 'f', 2), margin, y, size, white);
+    y += line;
+    hudText.text(QString("%1 X %2 %3 ITEMS").arg(viewportWidth).arg(viewportHeight).arg(renderQueue.stats.items), margin, y, size, white);
+    y += line;
+    if(walled) {
+        hudText.text(QString("WALL %1 BOARDS").arg(tournament.boards()), margin, y, size, white);
+        y += line;
+    }
+    if(!walled && hovered.square.x() >= 0) {
+        QString what = "SQUARE";
+        if(hovered.piece >= 0) {
+            const OBJObject* types[] = {chess.tower, chess.knight, chess.bishop, chess.queen, chess.king, chess.pawn};
+            const char* names[] = {"TOWER", "KNIGHT", "BISHOP", "QUEEN", "KING", "PAWN"};
+            for(int i = 0; i < 6; i++)
+                if(pieces.types[hovered.piece] == types[i])
+                    what = names[i];
         }
-        prog.setUniformValue("normalMatrix", QMatrix());
+        hudText.text(QString("PICK %1 %2%3 %4 MS").arg(what).arg(QChar('A' + hovered.square.x())).arg(hovered.square.y() + 1)
+                     .arg(hovered.ns / 1e6, 0, 'f', 3), margin, y, size, yellow);
+        y += line;
+    }
 
-        texBoardNormalMap->bind(0); // texture unit 0
-        prog.setUniformValue("normalMap", 0);
-        cubeMapTextures[currentCubeMap]->bind(1);
-        prog.setUniformValue("cubemap", 1);
-        prog.setUniformValue("reflectFactor", reflectFactor);
-        prog.setUniformValue("refractFactor", refractFactor);
-        prog.setUniformValue("refractIndice", refractIndice);
+    if(!walled) {
+        // the last moves under the statistics
+        y += line;
+        const QStringList& moves = frameState.moves;
+        const int first = frameState.played - moves.size(); // of the tail, white plays the even ones
+        for(int i = 0; i < moves.size(); i++) {
+            hudText.text(moves[i], margin, y, size, (first + i) % 2 ? QVector3D(0.6, 0.6, 0.6) : white);
+            y += line;
+        }
 
+        // coordinates on the border of the board, centered on their projection
+        auto label = [this, &frame, size, yellow](const QString& s, QVector3D position) {
+            QVector4D clip = frame.pv * QVector4D(position, 1);
+            if(clip.w() <= 0)
+                return;
+            float px = (clip.x() / clip.w() * 0.5f + 0.5f) * windowWidth;
+            float py = (0.5f - clip.y() / clip.w() * 0.5f) * windowHeight;
+            hudText.text(s, px - hudText.width(s, size) / 2, py - size / 2, size, yellow);
+        };
         for(int i = 0; i < 8; i++) {
-            for(int j = 0; j < 8; j++) {
-                Matrix m = boardA1.translated(i,j);
-                prog.setUniformValue("model", m);
-                prog.setUniformValue("matrix", pv * m);
-                prog.setUniformValue("color", (i + j) % 2);
-                glDrawArrays(GL_QUADS, 0, 4);
+            label(QString(QChar('A' + i)), vec3(i - 3.5, -4.5, 0));
+            label(QString::number(i + 1), vec3(-4.5, i - 3.5, 0));
+        }
+
+        // the hovered square, marked on the board
+        if(hovered.square.x() >= 0)
+            label("+", vec3(hovered.square.x() - 3.5, hovered.square.y() - 3.5, 0));
+    }
+
+    Program* text = programs[PROG_HUD];
+    QOpenGLShaderProgram& prog = text->program;
+    QMatrix4x4 pixels;
+    pixels.ortho(0, windowWidth, windowHeight, 0, -1, 1);
+
+    ext.BindFramebuffer(GL_FRAMEBUFFER, QOpenGLContext::currentContext()->defaultFramebufferObject());
+    glViewport(0, 0, windowWidth, windowHeight);
+    glDisable(GL_DEPTH_TEST);
+
+    prog.bind();
+    prog.setUniformValue(text->uniformLocations[U_MATRIX], pixels);
+    hudVAO.bind();
+    hudBuffer.bind();
+    hudBuffer.allocate(hudText.vertices().constData(), hudText.vertices().size() * sizeof(float));
+    glDrawArrays(GL_LINES, 0, hudText.vertexCount());
+
+    glEnable(GL_DEPTH_TEST);
+}
+
+void Scene::renderInsets()
+{
+    // same update, meshes, textures, programs and shadow maps as the main view, drawn over its corner in the window.
+    // Forward only: the G-buffer, the clusters, the planar reflection and the offscreen targets are sized and built for the main view
+    drawingInset = true;
+    selectPrograms();
+
+    ext.BindFramebuffer(GL_FRAMEBUFFER, QOpenGLContext::currentContext()->defaultFramebufferObject());
+    glEnable(GL_SCISSOR_TEST);
+
+    // a quarter of the height each, stacked on the right, the knight one first
+    const int margin = 8;
+    int h = max(1, windowHeight / 4), w = h * 4 / 3;
+    for(int view = KNIGHT_VIEW; view < KNIGHT_VIEW + NINSET; view++) {
+        if(view == KNIGHT_VIEW && frameState.piece < 0)
+            continue; // no move yet
+
+        int x = windowWidth - w - margin, y = windowHeight - (view - KNIGHT_VIEW + 1) * (h + margin);
+        glViewport(x, y, w, h);
+        glScissor(x, y, w, h);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        Frame frame = insetFrame(view, (float) w / h);
+        fillRenderQueue(frame);
+        renderQueue.sort();
+        if(streamed)
+            uploadFrame(frame);
+        drawRange(frame, 0, renderQueue.size());
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+    glViewport(0, 0, windowWidth, windowHeight);
+
+    // back to the features of the main view, for the stats
+    drawingInset = false;
+    selectPrograms();
+}
+
+void Scene::bindSceneFramebuffer()
+{
+    ext.BindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    glViewport(0, 0, viewportWidth, viewportHeight);
+}
+
+QualityGovernor::Settings Scene::wantedQuality() const
+{
+    QualityGovernor::Settings s;
+    s.nLights = nLights;
+    s.lightingModel = lightingModel;
+    s.reflectFactor = reflectFactor;
+    s.refractFactor = refractFactor;
+    s.antiAliasing = antiAliasing;
+    return s;
+}
+
+QString Scene::loweredQuality() const
+{
+    return governor.describe(wantedQuality());
+}
+
+void Scene::resolveAntiAliasing()
+{
+    aaTarget.timer.begin();
+
+    if(aaMode == AntiAliasing::MSAA) {
+        aaTarget.resolve(outputFramebuffer);
+    } else {
+        // fxaa from the color of the scene, nothing needs the depth after it
+        Program* fxaa = programs[PROG_FXAA];
+        QOpenGLShaderProgram& prog = fxaa->program;
+        const int* u = fxaa->uniformLocations;
+
+        ext.BindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+        glDisable(GL_DEPTH_TEST);
+        aaTarget.bindTexture(0);
+        prog.bind();
+        prog.setUniformValue(u[U_SCENE_COLOR], 0);
+        prog.setUniformValue(u[U_TEXEL_SIZE], QVector3D(1.f / viewportWidth, 1.f / viewportHeight, 0));
+        quadVAO.bind();
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    aaTarget.timer.end();
+}
+
+void Scene::upscale()
+{
+    // the offscreen scene stretched to the window, bilinear or sharpened
+    Program* up = programs[PROG_UPSCALE];
+    QOpenGLShaderProgram& prog = up->program;
+    const int* u = up->uniformLocations;
+
+    ext.BindFramebuffer(GL_FRAMEBUFFER, QOpenGLContext::currentContext()->defaultFramebufferObject());
+    glViewport(0, 0, windowWidth, windowHeight);
+    glDisable(GL_DEPTH_TEST);
+
+    resolution.bindTexture(0);
+    prog.bind();
+    prog.setUniformValue(u[U_SCENE_COLOR], 0);
+    prog.setUniformValue(u[U_TEXEL_SIZE], QVector3D(1.f / viewportWidth, 1.f / viewportHeight, 0.25f));
+    quadVAO.bind();
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glEnable(GL_DEPTH_TEST);
+}
+
+void Scene::drawRange(const Frame& frame, int begin, int end)
+{
+    // the queue holds about a hundred items (the wall is instanced): recorded here, then replayed
+    record(frame, begin, end, commandList);
+    submit(commandList);
+}
+
+void Scene::lightGBuffer(const Frame& frame)
+{
+    enum { G_UNIT = 0 }; // albedo, normal, emissive, depth on the units 0 to 3, the forward draws rebind theirs
+
+    gbuffer.bindTextures(G_UNIT);
+    quadVAO.bind();
+
+    auto samplers = [](Program* p) {
+        QOpenGLShaderProgram& prog = p->program;
+        prog.bind();
+        prog.setUniformValue(p->uniformLocations[U_G_ALBEDO], G_UNIT + GBuffer::ALBEDO);
+        prog.setUniformValue(p->uniformLocations[U_G_NORMAL], G_UNIT + GBuffer::NORMAL);
+        prog.setUniformValue(p->uniformLocations[U_G_EMISSIVE], G_UNIT + GBuffer::EMISSIVE);
+        prog.setUniformValue(p->uniformLocations[U_G_DEPTH], G_UNIT + GBuffer::NTARGET);
+    };
+
+    // light independent terms, and the depth so that the forward draws are hidden by the scene
+    samplers(programs[PROG_COMPOSE]);
+    glDepthFunc(GL_ALWAYS);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDepthFunc(GL_LESS);
+
+    // one additive pass per light, on the pixels its volume covers
+    Program* lighting = programs[PROG_DEFERRED_LIGHT];
+    QOpenGLShaderProgram& prog = lighting->program;
+    const int* u = lighting->uniformLocations;
+    samplers(lighting);
+    prog.setUniformValue(u[U_INVERSE_PV], frame.pv.inverted());
+    prog.setUniformValue(u[U_CAMERA], frame.camera);
+    prog.setUniformValue(u[U_SHININESS], chessShininess);
+    prog.setUniformValue(u[U_COOK_LAMBDA], cookLambda);
+    prog.setUniformValue(u[U_COOK_ROUGHNESS], cookRoughness);
+    for(int i = 0; i < shadowLights; i++) {
+        prog.setUniformValue(u[U_SHADOW_MAP0 + i], SHADOW_UNIT + i);
+        prog.setUniformValue(u[U_SHADOW_ORIGIN0 + i], shadowMaps.origin(i));
+    }
+    prog.setUniformValue(u[U_SHADOW_DEPTH], QVector3D(shadowMaps.zNear(), shadowMaps.zFar(), 0));
+
+    glDepthMask(GL_FALSE);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    auto& stats = deferredStats;
+    stats.lightPasses = 0;
+    stats.pixels = 0;
+
+    // the main lights have no falloff, their volume is the whole screen
+    for(int i = 0; i < quality.nLights; i++) {
+        prog.setUniformValue(u[U_LIGHT_SPHERE], QVector4D(lights[i].pos, 0));
+        prog.setUniformValue(u[U_LIGHT_COLOR], lights[i].color);
+        prog.setUniformValue(u[U_BOARD_ONLY], (GLint) (i > 0));
+        prog.setUniformValue(u[U_SHADOW_INDEX], i < shadowLights ? i : -1);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        stats.lightPasses++;
+        stats.pixels += (qint64) viewportWidth * viewportHeight;
+    }
+
+    // the point lights only on the screen rectangle of their sphere
+    glEnable(GL_SCISSOR_TEST);
+    prog.setUniformValue(u[U_BOARD_ONLY], 0);
+    prog.setUniformValue(u[U_SHADOW_INDEX], -1);
+    for(int i = 0; i < pointLights.size(); i++) {
+        QVector3D center(pointLights.x[i], pointLights.y[i], pointLights.z[i]);
+        QVector3D c = frame.view.map(center);
+        float r = pointLights.radius[i], ndc[4];
+        if(!LightClusters::sphereBounds(c.x(), c.y(), -c.z(), r, p(0, 0), p(1, 1), zNear, zFar, ndc))
+            continue;
+
+        int x0 = clamp((int) std::floor((ndc[0] + 1) / 2 * viewportWidth), 0, viewportWidth);
+        int y0 = clamp((int) std::floor((ndc[1] + 1) / 2 * viewportHeight), 0, viewportHeight);
+        int x1 = clamp((int) std::ceil((ndc[2] + 1) / 2 * viewportWidth), 0, viewportWidth);
+        int y1 = clamp((int) std::ceil((ndc[3] + 1) / 2 * viewportHeight), 0, viewportHeight);
+        if(x1 <= x0 || y1 <= y0)
+            continue;
+
+        glScissor(x0, y0, x1 - x0, y1 - y0);
+        prog.setUniformValue(u[U_LIGHT_SPHERE], QVector4D(center, r));
+        prog.setUniformValue(u[U_LIGHT_COLOR], pointLights.color[i]);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        stats.lightPasses++;
+        stats.pixels += (qint64) (x1 - x0) * (y1 - y0);
+    }
+    glDisable(GL_SCISSOR_TEST);
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+}
+
+void Scene::updateShadows()
+{
+    // the cached layers hold the pieces that stay still, only the moving piece is drawn every frame
+    const int moving = frameState.moving ? frameState.piece : -1;
+    Program* shadow = programs[PROG_SHADOW];
+    QOpenGLShaderProgram& prog = shadow->program;
+    int matrix = shadow->uniformLocations[U_MATRIX];
+
+    prog.bind();
+    shadowVAO.bind();
+    glViewport(0, 0, shadowMaps.size(), shadowMaps.size());
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2, 4); // no acne on the lit side of the pieces
+
+    auto drawPiece = [&](int ip, const QMatrix4x4& face) {
+        OBJObject* obj = pieces.types[ip];
+        prog.setUniformValue(matrix, face * pieceModels[ip]);
+        obj->bufferVertices.bind();
+        prog.setAttributeBuffer(0, GL_FLOAT, 0, 3);
+        obj->draw();
+    };
+
+    for(int l = 0; l < shadowLights; l++) {
+        // the main light turns, its layers are drawn from the nearest step of its orbit
+        QVector3D origin = l == 0 ? ShadowMaps::snap(lights[l].pos) : lights[l].pos;
+        QMatrix4x4 faces[ShadowMaps::FACES];
+        shadowMaps.faceMatrices(origin, faces);
+
+        if(shadowMaps.needsRebuild(l, origin)) {
+            for(int f = 0; f < ShadowMaps::FACES; f++) {
+                shadowMaps.bindCached(l, f);
+                for(int ip = 0; ip < pieces.size(); ip++)
+                    if(ip != moving)
+                        drawPiece(ip, faces[f]);
+            }
+        }
+
+        shadowMaps.setLive(l, moving >= 0);
+        if(moving >= 0) {
+            for(int f = 0; f < ShadowMaps::FACES; f++) {
+                shadowMaps.bindLive(l, f);
+                drawPiece(moving, faces[f]);
             }
         }
     }
 
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    bindSceneFramebuffer();
+    shadowMaps.bindTextures(SHADOW_UNIT, shadowLights);
+}
+
+void Scene::updateReflection(const Frame& frame)
+{
+    if(reflection.screenWidth() != viewportWidth || reflection.screenHeight() != viewportHeight) {
+        reflection.create(&ext, viewportWidth, viewportHeight);
+        reflectionState.valid = false;
+    }
+
+    // in ON_CHANGE mode the texture is kept while the camera, the pieces, the light and the materials stay the same
+    auto& state = reflectionState;
+    QVector4D material(chessShininess, cookLambda, cookRoughness, quality.lightingModel);
+    bool same = state.valid && state.pv == frame.pv && state.light == light && state.material == material && state.models == pieceModels;
+    if(planarReflections == 2 && same) {
+        reflection.stats.reuses++;
+        reflection.bindTexture(REFLECTION_UNIT);
+        return;
+    }
+
+    state.valid = true;
+    state.pv = frame.pv;
+    state.light = light;
+    state.material = material;
+    state.models = pieceModels;
+
+    // the pieces mirrored by the board plane, lit by the mirrored light, seen by the real camera
+    Program* mirror = programs[PROG_REFLECTION];
+    QOpenGLShaderProgram& prog = mirror->program;
+    const int* u = mirror->uniformLocations;
+    QMatrix4x4 flip;
+    flip.scale(1, 1, -1);
+
+    reflection.begin();
+    prog.bind();
+    reflectionVAO.bind();
+    prog.setUniformValue(u[U_LIGHT], flip.map(light));
+    prog.setUniformValue(u[U_CAMERA], frame.camera);
+    prog.setUniformValue(u[U_SHININESS], chessShininess);
+    prog.setUniformValue(u[U_COOK_ROUGHNESS], cookRoughness);
+    prog.setUniformValue(u[U_COOK_LAMBDA], cookLambda);
+
+    for(int ip = 0; ip < pieces.size(); ip++) {
+        OBJObject* obj = pieces.types[ip];
+        QMatrix4x4 m = flip * pieceModels[ip];
+
+        prog.setUniformValue(u[U_MATRIX], frame.pv * m);
+        prog.setUniformValue(u[U_MODEL], m);
+        prog.setUniformValue(u[U_NORMAL_MATRIX], m.normalMatrix());
+        prog.setUniformValue(u[U_COLOR], pieces.colors[ip]);
+        obj->bufferVertices.bind();
+        prog.setAttributeBuffer(0, GL_FLOAT, 0, 3);
+        obj->bufferNormals.bind();
+        prog.setAttributeBuffer(1, GL_FLOAT, 0, 3);
+        obj->draw();
+    }
+
+    reflection.end();
+    bindSceneFramebuffer();
+    reflection.bindTexture(REFLECTION_UNIT);
+    reflectionRefreshed = true;
+}
+
+void Scene::uploadFrame(const Frame& frame)
+{
+    // layout std140 of the Frame block (see chess.frag)
+    float* data = frameBlock;
+    std::fill(data, data + FRAME_BYTES / sizeof(float), 0.f);
+    auto put = [data](int vec4, QVector3D v) {
+        data[4*vec4 + 0] = v.x();
+        data[4*vec4 + 1] = v.y();
+        data[4*vec4 + 2] = v.z();
+    };
+
+    put(0, frame.camera);
+    put(1, light);
+    for(int i = 0; i < 10; i++) {
+        put(2 + i, lights[i].pos);
+        put(12 + i, lights[i].color);
+    }
+    for(int i = 0; i < 4; i++)
+        put(22 + i, frameState.points[i]);
+
+    bindFrameBlock();
+}
+
+void Scene::bindFrameBlock()
+{
+    int offset = upload(frameBlock, sizeof(frameBlock));
+    ext.BindBufferRange(GL_UNIFORM_BUFFER, FRAME_BINDING, stream.id(), offset, sizeof(frameBlock));
+}
+
+int Scene::upload(const void* data, int bytes)
+{
+    int offset = stream.upload(data, bytes, uniformAlignment);
+    if(offset >= 0)
+        return offset;
+
+    // the region of the frame is full, the estimate of drawBoard fell short: a ring twice as large, now.
+    // The draws already submitted keep the old buffer alive until the gpu is done with them,
+    // the blocks bound from it are bound again from the new one (the Object ones are bound per draw)
+    int size = 2 * max(stream.regionSize(), bytes + FRAME_BYTES + 2 * uniformAlignment);
+    qDebug() << "stream buffer full, grown to" << size << "bytes per frame";
+    stream.create(&ext, GL_UNIFORM_BUFFER, size);
+    stream.beginFrame();
+    if(data != frameBlock)
+        bindFrameBlock();
+    return stream.upload(data, bytes, uniformAlignment);
+}
+
+void Scene::uploadMaterial()
+{
+    // the block stays bound between the frames, it is only written again when it changed
+    bool changed = params.changed(Parameters::BLOCK_MATERIAL, materialVersion);
+    if(materialBuffer && !changed && materialReflect == quality.reflectFactor && materialRefract == quality.refractFactor)
+        return;
+
+    if(!materialBuffer) {
+        ext.GenBuffers(1, &materialBuffer);
+        ext.BindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+        ext.BufferData(GL_UNIFORM_BUFFER, MATERIAL_BYTES, nullptr, GL_DYNAMIC_DRAW);
+        ext.BindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BINDING, materialBuffer, 0, MATERIAL_BYTES);
+    }
+
+    // layout std140 of the Material block (see chess.frag)
+    float data[MATERIAL_BYTES / sizeof(float)] = {
+        chessShininess, cookLambda, cookRoughness,
+        quality.reflectFactor, quality.refractFactor, refractIndice,
+    };
+    ext.BindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+    ext.BufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(data), data);
+    ext.BindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    materialReflect = quality.reflectFactor;
+    materialRefract = quality.refractFactor;
+    materialUploads++;
+}
+
+void Scene::fillRenderQueue(const Frame& frame)
+{
+    const QVector3D A1Coord = vec3(-3.5, -3.5, 0);
+
+    // depth is the distance to the camera so opaque things go front to back
+    renderQueue.clear();
+
+    QVector3D camera = frame.camera;
+    auto depth = [camera](QVector3D pos) {
+        return (pos - camera).length();
+    };
+
+    // pieces and board go to the G-buffer in the deferred path
+    const int litLayer = deferred ? RenderQueue::GBUFFER_LAYER : RenderQueue::OPAQUE_LAYER;
+
+    // lamp
+    for(int i = 0; i < quality.nLights; i++)
+        renderQueue.push(RenderQueue::makeKey(RenderQueue::OPAQUE_LAYER, PROG_LIGHT, TEX_NONE, 0, depth(lights[i].pos)), i);
+
+    // chess, the transforms of the simulation
+    pieceModels = frameState.models;
+    for(int ip = 0; ip < pieceModels.size(); ip++) {
+        OBJObject* obj = pieces.types[ip];
+        renderQueue.push(RenderQueue::makeKey(litLayer, PROG_CHESS, TEX_NONE, meshes.indexOf(obj), depth(pieceModels[ip].map(obj->geom.center))), ip);
+    }
+
+    // board
+    for(int i = 0; i < 8; i++)
+        for(int j = 0; j < 8; j++)
+            renderQueue.push(RenderQueue::makeKey(litLayer, PROG_BOARD, TEX_BOARD, 0, depth(A1Coord + vec3(i, j, 0))), i * 8 + j);
+
     // bezier
-    if(anim.state == anim.RUN && (anim.type == anim.DEG3 || anim.type == anim.DEG4)) {
-        auto& prog = bezierProg;
-        prog.bind();
-        bezierVAO.bind();
+    if(frameState.moving && (frameState.curve == KnightAnimation::DEG3 || frameState.curve == KnightAnimation::DEG4))
+        renderQueue.push(RenderQueue::makeKey(RenderQueue::LINES_LAYER, PROG_BEZIER, TEX_NONE, 0, 0), 0);
 
-        auto m = boardA1;
-        prog.setUniformValue("degree", anim.type == anim.DEG3 ? 3 : 4);
+    // cube map, last so that only the pixels not covered by the scene are shaded
+    renderQueue.push(RenderQueue::makeKey(RenderQueue::SKY_LAYER, PROG_CUBEMAP, TEX_CUBEMAP, 0, 0), 0);
+}
+
+void Scene::record(const Frame& frame, int begin, int end, CommandList& list) const
+{
+    // no GL here, this can run on any thread
+    const Matrix boardA1 = Matrix().translate(-3.5, -3.5, 0);
+    const auto& pv = frame.pv;
+
+    list.clear();
+
+    // per draw data, in an Object block of the stream buffer or as plain uniforms
+    auto object = [&list, this](const QMatrix4x4& matrix, const QMatrix4x4& model, const QMatrix3x3& normal, int color) {
+        if(streamed) {
+            list.object(matrix, model, normal, color, objectStride);
+        } else {
+            list.uniformMat4(U_MATRIX, matrix);
+            list.uniformMat4(U_MODEL, model);
+            list.uniformMat3(U_NORMAL_MATRIX, normal);
+            list.uniformInt(U_COLOR, color);
+        }
+    };
+
+    auto clusterUniforms = [&list, this]() {
+        list.uniformInt(U_CLUSTER_LIGHTS, CLUSTER_LIGHTS_UNIT);
+        list.uniformInt(U_CLUSTER_ITEMS, CLUSTER_ITEMS_UNIT);
+        list.uniformVec3(U_CLUSTER_VIEWPORT, QVector3D(viewportWidth, viewportHeight, 0));
+        list.uniformVec3(U_CLUSTER_DEPTH, QVector3D(zNear, zFar, LightClusters::Z / std::log(zFar / zNear)));
+    };
+
+    auto shadowUniforms = [&list, this](int n) {
+        for(int i = 0; i < n; i++) {
+            list.uniformInt(U_SHADOW_MAP0 + i, SHADOW_UNIT + i);
+            list.uniformVec3(U_SHADOW_ORIGIN0 + i, shadowMaps.origin(i));
+        }
+        list.uniformVec3(U_SHADOW_DEPTH, QVector3D(shadowMaps.zNear(), shadowMaps.zFar(), 0));
+    };
+
+    renderQueue.execute(begin, end, [&](const RenderQueue::Item& item, bool programChanged, bool textureChanged, bool meshChanged) {
+        int program = RenderQueue::programOf(item.key);
+        if(programChanged)
+            list.bindProgram(program);
+        if(textureChanged && RenderQueue::textureOf(item.key) != TEX_NONE)
+            list.bindTextures(RenderQueue::textureOf(item.key), currentCubeMap.v);
+
+        switch(program) {
+        case PROG_LIGHT: {
+            int i = item.index;
+            QMatrix4x4 m;
+
+            m.translate(lights[i].pos);
+            m.scale(0.1);
+
+            list.uniformVec3(U_COLOR, lights[i].color);
+            list.uniformMat4(U_MATRIX, pv * m);
+            list.drawArrays(GL_QUADS, 0, 6 * 3 * 4);
+            break;
+        }
+        case PROG_CHESS: {
+            if(programChanged) {
+                if(!streamed) {
+                    list.uniformVec3(U_LIGHT, light);
+                    list.uniformVec3(U_CAMERA, frame.camera);
+                    list.uniformFloat(U_SHININESS, chessShininess);
+                    list.uniformFloat(U_COOK_ROUGHNESS, cookRoughness);
+                    list.uniformFloat(U_COOK_LAMBDA, cookLambda);
+                }
+                if(clustered)
+                    clusterUniforms();
+                if(shadowLights && !deferred)
+                    shadowUniforms(1);
+            }
+
+            auto& m = pieceModels[item.index];
+
+            object(pv * m, m, m.normalMatrix(), pieces.colors[item.index]);
 
-        float trail = 0.60f; // [0,1]
-        float b = anim.elapsed / anim.duration;
-        float a = max(0.f, b - trail);
-        auto R = anim.rightVector();
+            int mesh = RenderQueue::meshOf(item.key);
+            if(meshChanged)
+                list.bindMesh(mesh);
+            list.drawMesh(mesh);
+            break;
+        }
+        case PROG_BOARD: {
+            if(programChanged) {
+                QVector3D positions[10], colors[10];
+                for(int i = 0; i < quality.nLights; i++) {
+                    positions[i] = lights[i].pos;
+                    colors[i] = lights[i].color;
+                }
+
+                if(!streamed) {
+                    list.uniformVec3(U_CAMERA, frame.camera);
+                    list.uniformVec3Array(U_LIGHTS, positions, quality.nLights);
+                    list.uniformVec3Array(U_LIGHT_COLORS, colors, quality.nLights);
+                }
+
+                list.uniformInt(U_NORMAL_MAP, 0);
+                list.uniformInt(U_CUBEMAP, 1);
+                if(!streamed) {
+                    list.uniformFloat(U_REFLECT_FACTOR, quality.reflectFactor);
+                    list.uniformFloat(U_REFRACT_FACTOR, quality.refractFactor);
+                    list.uniformFloat(U_REFRACT_INDICE, refractIndice);
+                }
+                if(clustered)
+                    clusterUniforms();
+                if(shadowLights && !deferred)
+                    shadowUniforms(shadowLights);
+                if(reflected) {
+                    list.uniformInt(U_PLANAR_REFLECTION, REFLECTION_UNIT);
+                    list.uniformVec3(U_REFLECTION_VIEWPORT, QVector3D(viewportWidth, viewportHeight, 0));
+                }
+            }
+
+            int i = item.index / 8, j = item.index % 8;
+            Matrix m = boardA1.translated(i,j);
+            object(pv * m, m, QMatrix3x3(), (i + j) % 2);
+            list.drawArrays(GL_QUADS, 0, 4);
+            break;
+        }
+        case PROG_BEZIER: {
+            auto m = boardA1;
+            list.uniformInt(U_DEGREE, frameState.curve == KnightAnimation::DEG3 ? 3 : 4);
+
+            float trail = 0.60f; // [0,1]
+            float b = frameState.progress;
+            float a = max(0.f, b - trail);
+            auto R = frameState.rightVector();
+
+            // 0 0 0, 0 0 3, 2 0 3, 2 0 0
+            if(!streamed)
+                list.uniformVec3Array(U_P, frameState.points, 4);
+            object(pv * m, m, QMatrix3x3(), 0);
+            list.drawArrays(GL_LINE_STRIP, (int) (100 * a), (int) (100 * (b-a)));
+
+            m.translate(0.1 * R);
+
+            object(pv * m, m, QMatrix3x3(), 0);
+            list.drawArrays(GL_LINE_STRIP, (int) (100 * a), (int) (100 * (b-a)));
 
-        // 0 0 0, 0 0 3, 2 0 3, 2 0 0
-        prog.setUniformValueArray("P", anim.P, 4);
-        prog.setUniformValue("matrix", pv * m);
-        glDrawArrays(GL_LINE_STRIP, (int) (100 * a), (int) (100 * (b-a)));
+            m.translate(-0.2 * R);
+
+            object(pv * m, m, QMatrix3x3(), 0);
+            list.drawArrays(GL_LINE_STRIP, (int) (100 * a), (int) (100 * (b-a)));
+            break;
+        }
+        case PROG_CUBEMAP: {
+            list.depth(false, GL_LEQUAL); // the sky is at infinity, exactly at the far plane (see the vertex shader)
+
+            list.uniformMat4(U_MATRIX, frame.sky);
+            list.uniformInt(U_CUBEMAP, 0);
+
+            list.beginQuery();
+            list.drawArrays(GL_QUADS, 0, 6 * 4);
+            list.endQuery();
+
+            list.depth(true, GL_LESS);
+            break;
+        }
+        }
+    });
+}
+
+void Scene::submit(const CommandList& list)
+{
+    int program = 0;
+    QOpenGLShaderProgram* prog = &programs[0]->program;
+    const float* payload = list.payload.constData();
+
+    int blocks = 0;
+    if(!list.blocks.isEmpty())
+        blocks = upload(list.blocks.constData(), list.blocks.size() * sizeof(float));
+
+    for(const Command& c : list.commands) {
+        int location = programs[program]->uniformLocations[c.uniform];
+
+        switch(c.type) {
+        case Command::BIND_PROGRAM:
+            program = c.a;
+            prog = &programs[program]->program;
+            prog->bind();
+            vaos[program]->bind();
+            break;
+        case Command::BIND_MESH: {
+            OBJObject* obj = meshes[c.a];
+            obj->bufferVertices.bind();
+            prog->setAttributeBuffer("vertexPosition", GL_FLOAT, 0, 3); // glVertexAttribPointer(...) // one vertexPosition is 3 floats with offset 0, (stride 0)
+            obj->bufferNormals.bind();
+            prog->setAttributeBuffer("vertexNormal", GL_FLOAT, 0, 3);
+            break;
+        }
+        case Command::BIND_TEXTURES:
+            if(c.a == TEX_BOARD) {
+                texBoardNormalMap->bind(0); // texture unit 0
+                cubeMapTextures[c.b]->bind(1);
+            } else {
+                cubeMapTextures[c.b]->bind(0);
+            }
+            break;
+        case Command::UNIFORM_MAT4:
+            prog->setUniformValue(location, reinterpret_cast<const GLfloat (*)[4]>(payload + c.a)); // column major
+            break;
+        case Command::UNIFORM_MAT3:
+            prog->setUniformValue(location, reinterpret_cast<const GLfloat (*)[3]>(payload + c.a));
+            break;
+        case Command::UNIFORM_VEC3:
+            prog->setUniformValueArray(location, payload + c.a, c.b, 3);
+            break;
+        case Command::UNIFORM_FLOAT:
+            prog->setUniformValue(location, payload[c.a]);
+            break;
+        case Command::UNIFORM_INT:
+            prog->setUniformValue(location, (GLint) c.a);
+            break;
+        case Command::DRAW_ARRAYS:
+            glDrawArrays(c.a, c.b, c.c);
+            break;
+        case Command::DRAW_MESH:
+            meshes[c.a]->draw();
+            break;
+        case Command::DEPTH:
+            glDepthMask(c.a ? GL_TRUE : GL_FALSE);
+            glDepthFunc(c.b);
+            break;
+        case Command::BEGIN_QUERY:
+            if(ext.occlusionQuery && !skyQueryPending)
+                ext.BeginQuery(GL_SAMPLES_PASSED, skyQuery);
+            break;
+        case Command::END_QUERY:
+            if(ext.occlusionQuery && !skyQueryPending) {
+                ext.EndQuery(GL_SAMPLES_PASSED);
+                skyQueryPending = true;
+            }
+            break;
+        case Command::OBJECT:
+            ext.BindBufferRange(GL_UNIFORM_BUFFER, OBJECT_BINDING, stream.id(), blocks + c.a * sizeof(float), OBJECT_BYTES);
+            break;
+        }
+    }
+}
 
-        m.translate(0.1 * R);
+void Scene::countFrameTime(qint64 cpuNs)
+{
+    // exponential average, the gpu time comes from a query of a previous frame, read when ready
+    const double k = 0.05;
+    auto& t = myFrameTimes;
+    t.cpuMs += k * (cpuNs / 1e6 - t.cpuMs);
+    // only between frames that follow each other: the frames on demand wait for an input, that wait is not a frame
+    if(frameClock.isValid() && frameChained)
+        t.intervalMs += k * (frameClock.nsecsElapsed() / 1e6 - t.intervalMs);
+    frameClock.start();
+    frameChained = isAnimating();
+
+    auto& bench = wallBenchmark;
+    bool measured = bench.step >= 0 && bench.frames >= WALL_BENCHMARK_WARMUP;
+    if(measured) {
+        bench.cpuNs += cpuNs;
+        bench.cpuFrames++;
+    }
 
-        prog.setUniformValue("matrix", pv * m);
-        glDrawArrays(GL_LINE_STRIP, (int) (100 * a), (int) (100 * (b-a)));
+    // the planar reflection per refresh, and how often it is refreshed
+    if(reflected) {
+        auto& stats = reflection.stats;
+        reflection.collect();
+        t.reflectionRate += k * (reflectionRefreshed - t.reflectionRate);
+        if(reflectionRefreshed)
+            t.reflectionCpuMs += k * (stats.cpuNs / 1e6 - t.reflectionCpuMs);
+        t.reflectionGpuMs += k * (stats.gpuNs / 1e6 - t.reflectionGpuMs);
+    } else {
+        t.reflectionCpuMs = t.reflectionGpuMs = t.reflectionRate = 0;
+    }
 
-        m.translate(-0.2 * R);
+    if(aaMode == AntiAliasing::OFF)
+        t.antiAliasingMs = 0;
+    else if(aaTarget.timer.collect())
+        t.antiAliasingMs += k * (aaTarget.timer.ns() / 1e6 - t.antiAliasingMs);
+
+    if(!timeQueryPending)
+        return;
+
+    GLuint available = 0;
+    ext.GetQueryObjectuiv(timeQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    if(!available)
+        return;
+
+    GLuint64 ns = 0;
+    ext.GetQueryObjectui64v(timeQuery, GL_QUERY_RESULT, &ns);
+    timeQueryPending = false;
+    t.gpuMs += k * (ns / 1e6 - t.gpuMs);
+    if(measured) {
+        bench.gpuNs += ns;
+        bench.gpuFrames++;
+    }
+}
 
-        prog.setUniformValue("matrix", pv * m);
-        glDrawArrays(GL_LINE_STRIP, (int) (100 * a), (int) (100 * (b-a)));
+void Scene::countSkySamples()
+{
+    // read back the sky query of a previous frame only when it is ready, never wait for the gpu
+    if(!skyQueryPending)
+        return;
+
+    GLuint available = 0;
+    ext.GetQueryObjectuiv(skyQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    if(!available)
+        return;
+
+    GLuint drawn = 0;
+    ext.GetQueryObjectuiv(skyQuery, GL_QUERY_RESULT, &drawn);
+    skyQueryPending = false;
+
+    auto& stats = renderQueue.stats;
+    qint64 total = (qint64) viewportWidth * viewportHeight * viewportSamples;
+    stats.skySamplesDrawn += drawn;
+    stats.skySamplesSaved += max<qint64>(0, total - drawn);
+
+    if(++stats.skyFrames == 250) {
+        qint64 all = stats.skySamplesDrawn + stats.skySamplesSaved;
+        qDebug() << "render queue:"
+                 << "items:" << stats.items
+                 << "program changes:" << stats.programChanges
+                 << "texture changes:" << stats.textureChanges
+                 << "mesh changes:" << stats.meshChanges
+                 << "sky samples saved:" << (all ? 100 * stats.skySamplesSaved / all : 0) << "%";
+        stats.skySamplesDrawn = stats.skySamplesSaved = 0;
+        stats.skyFrames = 0;
     }
 }
 
+void Scene::report()
+{
+    // each module logs to its own category, the counters start again for the next REPORT_FRAMES frames
+    reportFrames = 0;
+    qCDebug(sceneLog) << "material uploads:" << materialUploads;
+    materialUploads = 0;
+    if(deferred)
+        qCDebug(sceneLog) << "deferred: last frame"
+                          << "light passes:" << deferredStats.lightPasses
+                          << "lit pixels:" << deferredStats.pixels;
+    if(walled)
+        qCDebug(sceneLog) << "tournament wall:" << tournament.boards() << "boards,"
+                          << wallData.size() / 4 << "instances in" << meshes.size() + 1 << "draws";
+    if(aaMode != AntiAliasing::OFF)
+        qCDebug(sceneLog) << "anti-aliasing:"
+                          << (aaMode == AntiAliasing::FXAA ? "fxaa" : "msaa") << viewportSamples << "samples,"
+                          << myFrameTimes.antiAliasingMs << "ms gpu";
+
+    // a module that is off logs nothing, its counters are reset all the same
+    if(streamed)
+        stream.report();
+    else
+        stream.stats = StreamBuffer::Stats();
+    if(scaled)
+        resolution.report();
+    else
+        resolution.stats = DynamicResolution::Stats();
+    if(reflected)
+        reflection.report();
+    else
+        reflection.stats.refreshes = reflection.stats.reuses = 0;
+    if(shadowLights)
+        shadowMaps.report();
+    else
+        shadowMaps.stats = ShadowMaps::Stats();
+    if(governor.level())
+        governor.report(wantedQuality());
+    if(clustered)
+        clusters.report();
+}
+
 void Scene::resize(int width, int height)
 {
-    glViewport(0, 0, width, height);
+    if(!softwareBackend)
+        glViewport(0, 0, width, height);
     p.setToIdentity();
-    p.perspective(70, (float) width / height, 0.1, 100.0);
+    p.perspective(fovy, (float) width / height, zNear, zFar);
+
+    // the scene size is chosen at each frame, see render()
+    windowWidth = viewportWidth = width;
+    windowHeight = viewportHeight = height;
+    resolution.setWindow(width, height);
 }
 
 void Scene::applyDelta(QPointF delta) {
@@ -558,31 +2103,200 @@ void Scene::applyMoveForward(float delta) {
     lookAt += d;
 }
 
-void Scene::prepareShaderProgram()
+static QByteArray readShader(QString filename)
+{
+    QFile file(filename);
+    if(! file.open(QIODevice::ReadOnly)) {
+        qCritical() << "Error loading " << filename;
+        exit(1);
+    }
+    QString code = QString::fromUtf8(file.readAll());
+
+    // GLSL has no #include, the file (same directory) is pasted in place
+    QRegularExpression include("^#include \"(.+)\"$", QRegularExpression::MultilineOption);
+    QRegularExpressionMatch match;
+    while((match = include.match(code)).hasMatch()) {
+        QString included = QFileInfo(filename).dir().filePath(match.captured(1));
+        code.replace(match.capturedStart(), match.capturedLength(), QString::fromUtf8(readShader(included)));
+    }
+    return code.toUtf8();
+}
+
+static QByteArray source(QString filename, QByteArray defines)
+{
+    QByteArray code = readShader(filename);
+    return code.insert(code.indexOf('\n') + 1, defines); // after #version
+}
+
+Scene::Program* Scene::program(QString basename, QByteArray defines)
 {
+    QByteArray key = basename.toUtf8() + '\n' + defines;
+    if(Program* p = programCache.value(key))
+        return p;
+
     // add shader, calls init to generate program id (glGenProgram(&programId))
     // create the shader (glCreateShader(&shaderId, type))
     // then attach the shader (glAttachShader(programId, shaderId)
+    Program* p = new Program;
+    auto& prog = p->program;
+
+    QElapsedTimer timer;
+    timer.start();
 
-    auto readPair = [](QOpenGLShaderProgram & prog, QString basename) {
+    QByteArray vertex = source(F(":/shaders/%1.vert").arg(basename), defines);
+    QByteArray fragment = source(F(":/shaders/%1.frag").arg(basename), defines);
+    QByteArray binary = programBinaries.key(vertex, fragment);
+
+    bool cached = programBinaries.load(prog, binary);
+    if(! cached) {
         bool ok = true;
 
-        ok &= prog.addShaderFromSourceFile(QOpenGLShader::Vertex, F(":/shaders/%1.vert").arg(basename));
-        ok &= prog.addShaderFromSourceFile(QOpenGLShader::Fragment, F(":/shaders/%1.frag").arg(basename));
+        ok &= prog.addShaderFromSourceCode(QOpenGLShader::Vertex, vertex);
+        ok &= prog.addShaderFromSourceCode(QOpenGLShader::Fragment, fragment);
+
+        // same attribute locations in every variant, so one vao serves them all
+        prog.bindAttributeLocation("vertexPosition", 0);
+        prog.bindAttributeLocation("position", 0); // cubemap
+        prog.bindAttributeLocation("t", 0); // bezier
+        prog.bindAttributeLocation("vertexNormal", 1);
+        prog.bindAttributeLocation("vertexColor", 2);
+        prog.bindAttributeLocation("vertexCoord", 3);
+        prog.bindAttributeLocation("vertexInstance", 4); // wall
+
+        if(ext.framebufferObject) {
+            GLuint id = prog.programId();
+            ext.BindFragDataLocation(id, 0, "fragColor");
+            ext.BindFragDataLocation(id, GBuffer::ALBEDO, "gAlbedo");
+            ext.BindFragDataLocation(id, GBuffer::NORMAL, "gNormal");
+            ext.BindFragDataLocation(id, GBuffer::EMISSIVE, "gEmissive");
+        }
+
+        programBinaries.prepare(prog);
         ok &= prog.link(); // glLinkProgram(programId)
 
         if(! ok) {
-            qCritical() << "error in a shader" << prog.log();
+            qCritical() << "error in a shader" << basename << defines << prog.log();
             exit(1);
         }
+
+        programBinaries.save(prog, binary, timer.nsecsElapsed());
+    }
+
+    if(streamed) {
+        GLuint id = prog.programId();
+        GLuint object = ext.GetUniformBlockIndex(id, "Object"), frame = ext.GetUniformBlockIndex(id, "Frame");
+        GLuint material = ext.GetUniformBlockIndex(id, "Material");
+        if(object != GL_INVALID_INDEX)
+            ext.UniformBlockBinding(id, object, OBJECT_BINDING);
+        if(frame != GL_INVALID_INDEX)
+            ext.UniformBlockBinding(id, frame, FRAME_BINDING);
+        if(material != GL_INVALID_INDEX)
+            ext.UniformBlockBinding(id, material, MATERIAL_BINDING);
+    }
+
+    for(int u = 0; u < NUNIFORM; u++)
+        p->uniformLocations[u] = prog.uniformLocation(uniformNames[u]);
+
+    qDebug() << "shader variant" << basename << defines.simplified() << (cached ? "(binary)" : "") << timer.elapsed() << "ms";
+    programCache.insert(key, p);
+    return p;
+}
+
+void Scene::selectPrograms()
+{
+    // parameters that change the code of a shader are #defines, not uniforms,
+    // a variant is compiled the first time its parameters are used, then comes from the cache
+    QByteArray streamedDefines = streamed ? "#define STREAMED\n" : "";
+    auto define = [](const char* name, int value) {
+        return QByteArray("#define ") + name + " " + QByteArray::number(value) + "\n";
     };
 
-    readPair(surfProg, "surf");
-    readPair(lightProg, "light");
-    readPair(chessProg, "chess");
-    readPair(boardProg, "board");
-    readPair(bezierProg, "bezier");
-    readPair(cubeMapProg, "cubemap");
+    // the insets and the tournament wall are forward only
+    walled = tournamentBoards > 0 && tournament.boards() > 0 && ext.instancing;
+    bool mainBoard = !drawingInset && !walled;
+
+    deferred = mainBoard && renderPath == 1 && ext.framebufferObject;
+    clustered = mainBoard && !deferred && clusterLights > 0 && clusters.isCreated();
+    QByteArray deferredDefines = deferred ? "#define DEFERRED\n" : "";
+    QByteArray clusterDefines = clustered ?
+        "#define CLUSTERED\n" + define("CLUSTER_X", LightClusters::X) + define("CLUSTER_Y", LightClusters::Y) + define("CLUSTER_Z", LightClusters::Z) : "";
+
+    shadowLights = !walled && shadows && shadowMaps.isCreated() ? clamp(quality.nLights, 0, (int) ShadowMaps::MAX_LIGHTS) : 0;
+    auto shadowDefines = [this, &define](int n) -> QByteArray {
+        return shadowLights ? "#define SHADOWS\n" + define("N_SHADOWS", n) : "";
+    };
+    // the G-buffer variants have no lights, the shadows are in the lighting passes
+    QByteArray litShadowDefines = deferred ? "" : shadowDefines(shadowLights);
+
+    reflected = mainBoard && planarReflections > 0 && quality.reflectFactor > 0 && ext.framebufferObject;
+
+    QByteArray board = streamedDefines + clusterDefines + deferredDefines + litShadowDefines + define("N_LIGHTS", clamp(quality.nLights, 1, 10));
+    if(quality.reflectFactor > 0)
+        board += "#define REFLECT\n";
+    if(reflected)
+        board += "#define PLANAR_REFLECTION\n";
+    if(quality.refractFactor > 0)
+        board += "#define REFRACT\n";
+
+    programs[PROG_LIGHT] = program("light", "");
+    programs[PROG_CHESS] = program("chess", streamedDefines + clusterDefines + deferredDefines + (deferred ? "" : shadowDefines(1))
+                                   + define("LIGHTING_MODEL", clamp(quality.lightingModel, 0, 2)));
+    programs[PROG_BOARD] = program("board", board);
+    programs[PROG_BEZIER] = program("bezier", streamedDefines);
+    programs[PROG_CUBEMAP] = program("cubemap", "");
+
+    if(deferred) {
+        programs[PROG_COMPOSE] = program("deferred", "#define COMPOSE\n");
+        programs[PROG_DEFERRED_LIGHT] = program("deferred", shadowDefines(shadowLights));
+    }
+
+    if(shadowLights)
+        programs[PROG_SHADOW] = program("shadow", "");
+
+    if(dynamicResolution)
+        programs[PROG_UPSCALE] = program("post", dynamicResolution == 2 ? "#define SHARPEN\n" : "");
+    if(quality.antiAliasing == 4)
+        programs[PROG_FXAA] = program("post", "#define FXAA\n");
+
+    if(walled) {
+        programs[PROG_WALL] = program("wall", "");
+        programs[PROG_WALL_BOARD] = program("wall", "#define BOARD\n");
+    }
+
+    if(hud)
+        programs[PROG_HUD] = program("hud", "");
+
+    // plain forward pieces, whatever the path of the frame
+    if(reflected)
+        programs[PROG_REFLECTION] = program("chess", define("LIGHTING_MODEL", clamp(quality.lightingModel, 0, 2)));
+}
+
+void Scene::prepareShaderProgram()
+{
+    programBinaries.initialize(&ext);
+
+    selectPrograms();
+
+    surfProg = &program("surf", "")->program;
+    lightProg = &programs[PROG_LIGHT]->program;
+    chessProg = &programs[PROG_CHESS]->program;
+    boardProg = &programs[PROG_BOARD]->program;
+    bezierProg = &programs[PROG_BEZIER]->program;
+    cubeMapProg = &programs[PROG_CUBEMAP]->program;
+
+    QOpenGLVertexArrayObject* vas[NPROG] = {&lightVAO, &chessVAO, &boardVAO, &bezierVAO, &cubeMapVAO, &quadVAO, &quadVAO, &shadowVAO, &reflectionVAO, &quadVAO, &quadVAO, &wallVAO, &wallVAO, &hudVAO};
+    for(int i = 0; i < NPROG; i++)
+        vaos[i] = vas[i];
+
+    auto& stats = programBinaries.stats;
+    if(programBinaries.enabled())
+        qDebug() << "program binaries:"
+                 << "hits:" << stats.hits
+                 << "misses:" << stats.misses
+                 << "rejected:" << stats.rejected
+                 << "saved:" << stats.savedNs / 1000000 << "ms";
+    else
+        qDebug() << "program binaries: not supported by the driver";
 
     glCheckError();
 }
@@ -636,7 +2350,7 @@ void Scene::prepareVertexBuffers()
 {
     // surface
     {
-        auto& prog = surfProg;
+        auto& prog = *surfProg;
         auto& vao = surfVAO;
         vao.create(); // glGenVertexArrays(1, &vao)
         vao.bind(); // glBindVertexArray(vao)
@@ -729,7 +2443,7 @@ void Scene::prepareVertexBuffers()
 
     // lamp
     {
-        auto& prog = lightProg;
+        auto& prog = *lightProg;
         prog.bind();
 
         auto& vao = lightVAO;
@@ -787,7 +2501,7 @@ void Scene::prepareVertexBuffers()
 
     // chess
     {
-        auto& prog = chessProg;
+        auto& prog = *chessProg;
         auto& vao = chessVAO;
 
         prog.bind();
@@ -815,7 +2529,7 @@ void Scene::prepareVertexBuffers()
         for(QVector3D& v : data)
             v -= {0.5, 0.5, 0};
 
-        auto& prog = boardProg;
+        auto& prog = *boardProg;
         auto& vao = boardVAO;
 
         vao.create();
@@ -843,7 +2557,7 @@ void Scene::prepareVertexBuffers()
             times[i] = i / 100.0;
 
         auto& vao = bezierVAO;
-        auto& prog = bezierProg;
+        auto& prog = *bezierProg;
 
         vao.create();
         vao.bind();
@@ -864,7 +2578,7 @@ void Scene::prepareVertexBuffers()
     // cubemap
     {
         auto& vao = cubeMapVAO;
-        auto& prog = cubeMapProg;
+        auto& prog = *cubeMapProg;
         vao.create();
         vao.bind();
         prog.bind();
@@ -892,6 +2606,76 @@ void Scene::prepareVertexBuffers()
         vao.release();
     }
 
+    // full screen quad, for the screen space passes
+    {
+        auto& vao = quadVAO;
+        auto& prog = *lightProg; // any program, the positions are at location 0 in all of them
+        vao.create();
+        vao.bind();
+
+        const GLfloat points[] = {-1,-1, +1,-1, -1,+1, +1,+1}; // triangle strip
+
+        auto& buf = quadBuffer;
+        buf.create();
+        buf.setUsagePattern(QOpenGLBuffer::StaticDraw);
+        buf.bind();
+        buf.allocate(points, sizeof(points));
+        prog.enableAttributeArray(0);
+        prog.setAttributeBuffer(0, GL_FLOAT, 0, 2);
+
+        vao.release();
+    }
+
+    // shadows, the vertices of each mesh are bound at draw time
+    {
+        shadowVAO.create();
+        shadowVAO.bind();
+        lightProg->enableAttributeArray(0);
+        shadowVAO.release();
+    }
+
+    // planar reflection, same as the shadows with the normals
+    {
+        reflectionVAO.create();
+        reflectionVAO.bind();
+        lightProg->enableAttributeArray(0);
+        lightProg->enableAttributeArray(1);
+        reflectionVAO.release();
+    }
+
+    // tournament wall, the meshes and the instances are bound at draw time
+    {
+        wallVAO.create();
+        wallVAO.bind();
+        lightProg->enableAttributeArray(0);
+        lightProg->enableAttributeArray(1);
+        lightProg->enableAttributeArray(4);
+        if(ext.instancing)
+            ext.VertexAttribDivisor(4, 1); // one vec4 per instance
+        wallVAO.release();
+
+        wallInstances.create();
+        wallInstances.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    }
+
+    // hud, x y r g b per vertex, refilled each frame
+    {
+        hudVAO.create();
+        hudVAO.bind();
+
+        auto& buf = hudBuffer;
+        buf.create();
+        buf.setUsagePattern(QOpenGLBuffer::StreamDraw);
+        buf.bind();
+        const int stride = HUD::FLOATS * sizeof(float);
+        lightProg->enableAttributeArray(0);
+        lightProg->setAttributeBuffer(0, GL_FLOAT, 0, 2, stride);
+        lightProg->enableAttributeArray(2);
+        lightProg->setAttributeBuffer(2, GL_FLOAT, 2 * sizeof(float), 3, stride);
+
+        hudVAO.release();
+    }
+
     // border
     {
         GLfloat points[] = {
@@ -921,16 +2705,14 @@ void Scene::prepareVertexBuffers()
     glCheckError();
 }
 
-QVector3D Scene::KnightAnimation::rightVector() {
+QVector3D Scene::KnightAnimation::rightVector() const {
     return vec3(polar(angle2D(vec2(to - fr)) - M_PI/2), 0);
 }
 
 void Scene::KnightAnimation::startTo(QPoint target) {
     state = RUN;
-    fr = piece->position;
+    fr = scene->pieces.squares[piece];
     to = target;
-    if(scene->onKnightAnim.isRunning)
-        scene->onKnightAnim.start();
 
     if(type == DEG3) {
         P[0] = vec3(vec2(fr), 0);
@@ -954,7 +2736,7 @@ void Scene::KnightAnimation::update(float tnow) {
         pos3D = P[0] + (P[1] - P[0]) * elapsed / duration;
     if(elapsed > duration) {
         state = DONE;
-        piece->position = to;
+        scene->pieces.squares[piece] = to;
     }
 }
 
@@ -10,9 +10,31 @@
 #include <QPainter>
 #include <QVector>
 #include <QMap>
+#include <QHash>
 
 #include "utils.h"
 #include "objloader.h"
+#include "renderqueue.h"
+#include "commandlist.h"
+#include "streambuffer.h"
+#include "programcache.h"
+#include "lightclusters.h"
+#include "gbuffer.h"
+#include "shadowmaps.h"
+#include "planarreflection.h"
+#include "dynamicresolution.h"
+#include "antialiasing.h"
+#include "qualitygovernor.h"
+#include "tournamentwall.h"
+#include "hud.h"
+#include "softrasterizer.h"
+#include "parameters.h"
+#include "pieces.h"
+#include "bvh.h"
+#include "pathtracer.h"
+#include "glextensions.h"
+#include "simulation.h"
+#include "triplebuffer.h"
 
 class Scene
 {
@@ -21,12 +43,41 @@ public:
     ~Scene();
 
     void initialize();
-    void update(double t); // t in seconds
+
+    /**
+     * @brief the state the next render draws from the snapshots of the simulation: between the two last steps,
+     * a step behind the clock. The camera follows the input as it is.
+     */
+    void interpolate();
+
+    /**
+     * @brief the frames change without any input: a move, the fall, the light turning, the wall, a benchmark
+     */
+    bool isAnimating() const;
+
+    /**
+     * @brief any thread: the pieces fall again from the sky, at the next step
+     */
+    void startFalling();
+
+    /**
+     * @brief the moves, the knight animation, the fall and the main light, stepped on its own thread from initialize.
+     * The frames only read its snapshots, it sends resumed when it moves again after a sleep.
+     */
+    Simulation simulation;
+
+    /**
+     * @brief the fields bound to the sliders (see MainWindow), with the uniform blocks they feed
+     */
+    Parameters params;
+
     void render();
     void resize(int width, int height);
 
     static void glCheckError();
 
+    const RenderQueue::Stats& renderStats() const { return renderQueue.stats; }
+
 public slots:
     void applyDelta(QPointF delta);
     void applyMove(QPointF delta);
@@ -38,9 +89,10 @@ public:
     float angleFromUp = radians(60); // math-phi / 3D angle
     float angleOnGround = radians(225); // math-theta / 2D angle / azimutal
 
+    // the simulation's once it runs, changed through simulation.post
     float lightHeight = 1;
     float lightRadius = 1;
-    float lightSpeed = 0.2; // turns / second
+    float lightSpeed = 0.2; // turns / second, the frames read the one of the snapshot
     float lightInitPos = 0; // radians
     float chessShininess = 32;
 
@@ -89,7 +141,7 @@ public:
     } currentCubeMap;
 
 private:
-    QOpenGLShaderProgram surfProg, lightProg, chessProg, boardProg, bezierProg, cubeMapProg;
+    QOpenGLShaderProgram *surfProg, *lightProg, *chessProg, *boardProg, *bezierProg, *cubeMapProg; // default variants, in programCache
 
     QOpenGLVertexArrayObject surfVAO, lightVAO, chessVAO, boardVAO, bezierVAO, cubeMapVAO;
     QOpenGLBuffer
@@ -118,12 +170,6 @@ private:
         void onloaded() override;
     } chess;
 
-    struct ChessPiece {
-        OBJObject* type;
-        QPoint position; // (0,0): A1; (1,0): B1;
-        int color; // 0 is white
-    };
-
     int colorTurn = 0;
 
     struct Light {
@@ -142,21 +188,364 @@ public:
     float cookRoughness = 0.2;
     int lightingModel = 0; // PHONG BLING-PHONG COOK
 
+    int clusterLights = 0; // orbiting colored point lights, drawn by the clustered path, 0 is off
+    int renderPath = 0; // FORWARD DEFERRED
+    int shadows = 1; // OFF ON, cast by the pieces from the main lights
+    int planarReflections = 2; // OFF EVERY_FRAME ON_CHANGE, pieces mirrored in the board
+    int dynamicResolution = 0; // OFF BILINEAR SHARPEN, upscale of the scene drawn at a lower resolution
+    float targetFrameMs = 16.6; // dynamic resolution and quality governor, cpu or gpu time of render()
+    float minResolutionScale = 0.5;
+    int antiAliasing = 2; // OFF MSAA_2X MSAA_4X MSAA_8X FXAA
+    int qualityGovernor = 0; // OFF ON, gives up nLights, lightingModel, reflectFactor, refractFactor and antiAliasing over the target
+    int multiView = 0; // OFF ON, knight camera and top-down view in insets over the main view
+    int tournamentBoards = 0; // games of the tournament wall drawn instead of the board, 0 is off
+    int hud = 0; // OFF ON, board coordinates, moves and frame statistics over the scene
+
+    struct FrameTimes {
+        double cpuMs = 0, gpuMs = 0; // of render(), smoothed, gpu is 0 without timer queries
+        double reflectionCpuMs = 0, reflectionGpuMs = 0; // of one refresh of the planar reflection, part of the above
+        double reflectionRate = 0; // frames that refresh it, [0,1]
+        double resolutionScale = 1; // of the scene on both axes
+        double antiAliasingMs = 0; // gpu, msaa resolve or fxaa pass, the cost of the msaa samples is in the frame
+        int qualityLevel = 0; // rungs of the governor ladder taken down, 0 is the quality set by the user
+        int qualityLevels = 0;
+        double intervalMs = 0; // between two frames in a row while the scene animates, without the idle time, smoothed
+    };
+    const FrameTimes& frameTimes() const { return myFrameTimes; }
+
+    /**
+     * @brief features the quality governor gave up, empty at full quality
+     */
+    QString loweredQuality() const;
+
+    /**
+     * @brief steps the tournament wall from 1 to 1024 boards and prints the frame times of each count
+     */
+    void startWallBenchmark();
+
+    /**
+     * @brief the backend without GL: loads the models only, render() draws the image on the cpu
+     */
+    void initializeSoftware();
+    bool isSoftware() const { return softwareBackend; }
+    const QImage& softwareImage() const { return softRaster.image(); }
+
+    /**
+     * @brief draws the next frame on the cpu with 1 thread up to all the cores, prints the frames per second of each count
+     * and, on the GL backend, the difference with the GL image of the same frame
+     */
+    void startSoftwareBenchmark() { softwareBenchmark = true; }
+
+    /**
+     * @brief takes the pieces, the board, the lights and the cubemap of the next frame and path traces them
+     * in the background to a still-<date>.png, rewritten as the samples add up
+     */
+    void startPathTrace() { pathTracePending = true; }
+
+    /**
+     * @brief what is under a pixel of the window, in the pixels of resize, through the camera of the frame (the knight view too)
+     */
+    struct Pick {
+        Pieces::Handle piece = Pieces::NONE;
+        QPoint square = {-1, -1};   // under the piece or hit on the board, (-1,-1) off the board
+        float t = 0;                // along the ray, from the near plane
+        int candidates = 0;         // pieces whose bounds the ray crosses
+        qint64 ns = 0;
+    };
+
+    /**
+     * @brief the bounds of the pieces first, then the triangles of the candidates in the BVH of their mesh, nearest first
+     */
+    Pick pick(QPointF pixel);
+    void hover(QPointF pixel) { hovered = pick(pixel); }
+    const Pick& hoveredPick() const { return hovered; }
+
 private:
     QVector3D & light = lights[0].pos;
 
-    QList<ChessPiece*> chessPieces; // size = 32
-    QList<QList<ChessPiece*>> knights; // [color][num]
+    Pieces pieces; // 32
 
     QMatrix4x4 p, v;
     QVector3D camera;
+    float fovy = 70, zNear = 0.1, zFar = 100; // of p
+
+    // render queue
+    enum { PROG_LIGHT, PROG_CHESS, PROG_BOARD, PROG_BEZIER, PROG_CUBEMAP, PROG_COMPOSE, PROG_DEFERRED_LIGHT, PROG_SHADOW, PROG_REFLECTION, PROG_UPSCALE, PROG_FXAA, PROG_WALL, PROG_WALL_BOARD, PROG_HUD }; // key order is draw order
+    enum { TEX_NONE, TEX_BOARD, TEX_CUBEMAP };
+
+    GLExtensions ext;
+    RenderQueue renderQueue;
+    QVector<OBJObject*> meshes; // mesh id in the render key
+    QVector<Matrix> pieceModels; // [pieces.size()]
+    GLuint skyQuery = 0;
+    bool skyQueryPending = false;
+    GLuint timeQuery = 0;
+    bool timeQueryPending = false;
+    FrameTimes myFrameTimes;
+    int viewportWidth = 1, viewportHeight = 1, viewportSamples = 1; // of the scene
+    int windowWidth = 1, windowHeight = 1;
+
+    void countSkySamples();
+    void countFrameTime(qint64 cpuNs);
+
+    enum { REPORT_FRAMES = 250 };
+    int reportFrames = 0;
+    void report(); // the counters of the modules, on their logging categories
+
+    // command lists
+    enum { NPROG = PROG_HUD + 1 };
+    enum {
+        U_MATRIX, U_MODEL, U_NORMAL_MATRIX, U_COLOR, U_CAMERA, U_LIGHT,
+        U_SHININESS, U_COOK_ROUGHNESS, U_COOK_LAMBDA,
+        U_LIGHTS, U_LIGHT_COLORS, U_NORMAL_MAP, U_CUBEMAP,
+        U_REFLECT_FACTOR, U_REFRACT_FACTOR, U_REFRACT_INDICE, U_DEGREE, U_P,
+        U_CLUSTER_LIGHTS, U_CLUSTER_ITEMS, U_CLUSTER_VIEWPORT, U_CLUSTER_DEPTH,
+        U_INVERSE_PV, U_LIGHT_SPHERE, U_LIGHT_COLOR, U_BOARD_ONLY,
+        U_G_ALBEDO, U_G_NORMAL, U_G_EMISSIVE, U_G_DEPTH,
+        U_SHADOW_MAP0, U_SHADOW_MAP1, U_SHADOW_MAP2, U_SHADOW_DEPTH, U_SHADOW_INDEX,
+        U_SHADOW_ORIGIN0, U_SHADOW_ORIGIN1, U_SHADOW_ORIGIN2,
+        U_PLANAR_REFLECTION, U_REFLECTION_VIEWPORT, U_SCENE_COLOR, U_TEXEL_SIZE,
+        NUNIFORM
+    };
+    static const char* uniformNames[NUNIFORM];
+
+    // shader permutations
+    struct Program {
+        QOpenGLShaderProgram program;
+        int uniformLocations[NUNIFORM]; // -1 when the program doesn't have it
+    };
+
+    QHash<QByteArray, Program*> programCache; // basename + defines, linked on first use
+    ProgramCache programBinaries; // on disk, across launches
+    Program* programs[NPROG] = {}; // variants of the current parameters
+    QOpenGLVertexArrayObject* vaos[NPROG];
+
+    Program* program(QString basename, QByteArray defines);
+    void selectPrograms();
+
+    struct Frame {
+        QMatrix4x4 pv, sky, view;
+        QVector3D camera;
+    };
+
+    CommandList commandList; // recorded and replayed range by range, its storage kept across frames
+
+    // stream buffer
+    enum { OBJECT_BINDING = 0, FRAME_BINDING = 1, MATERIAL_BINDING = 2 };
+    enum { OBJECT_BYTES = 3 * 64 + 4, FRAME_BYTES = 26 * 16, MATERIAL_BYTES = 2 * 16 }; // std140 sizes of the blocks
+
+    StreamBuffer stream;
+    bool streamed = false;
+    int uniformAlignment = 256;
+    int objectStride = 64; // floats between two Object blocks
+
+    float frameBlock[FRAME_BYTES / sizeof(float)]; // the last Frame block uploaded
+
+    void uploadFrame(const Frame& frame);
+    void bindFrameBlock();
+    int upload(const void* data, int bytes); // to the region of the frame, grows the ring when it is full
+
+    // the Material block, in a buffer of its own, uploaded when a parameter of Parameters::BLOCK_MATERIAL
+    // or the governor changes it
+    GLuint materialBuffer = 0;
+    quint32 materialVersion = 0;
+    float materialReflect = -1, materialRefract = -1; // lowered by the governor, not through the parameters
+    qint64 materialUploads = 0;
+
+    void uploadMaterial();
+
+    // clustered lighting
+    enum { CLUSTER_LIGHTS_UNIT = 2, CLUSTER_ITEMS_UNIT = 3 }; // texture units, after the board ones
+
+    PointLights pointLights; // [clusterLights]
+    LightClusters clusters;
+    bool clustered = false; // this frame
+
+    void updatePointLights(double t);
+    void updateCamera();
+
+    // what a step publishes for the frames, whole: the renderer never sees a step half done
+    struct Snapshot {
+        double t = 0, wall = 0;     // of the step, see Simulation::step
+        QVector<Matrix> models;     // [pieces]
+        QVector<QPoint> squares;    // [pieces]
+        QVector3D light;
+        float lightSpeed = 0;       // the cluster lights turn with it
+        Pieces::Handle piece = Pieces::NONE; // of the last move, still set once it landed (the knight view stays on it)
+        bool moving = false;        // its knight animation runs
+        int curve = 0;              // KnightAnimation::type
+        QVector3D points[4];        // KnightAnimation::P
+        QVector3D position;         // KnightAnimation::pos3D
+        QPoint from, to;
+        float progress = 0;         // elapsed / duration
+        bool falling = false;
+        bool animating = false;     // the simulation goes on stepping
+        int placement = 0;          // changed when a piece leaves or lands, for the cached shadows
+        QStringList moves;          // the last HUD_MOVES, oldest first
+        int played = 0;             // moves since the start
+
+        QVector3D rightVector() const;
+    };
+
+    // simulation thread only
+    TripleBuffer<Snapshot> snapshots;
+    enum { HUD_MOVES = 12 }; // what the hud shows
+    QStringList moves; // the last played, oldest first
+    int played = 0;
+    int placement = 0;
+    bool drawn = false; // no more moves, see Simulation::over
+    QAtomicInt fallRequested;
+
+    void step(double t, double wall);
+    double idleTime(double t) const;
+    void publish(double t, double wall);
+
+    // render thread only
+    Snapshot olderState, latestState; // the two last fetched
+    Snapshot frameState; // drawn by the frame
+    int shadowPlacement = -1;
+
+    // deferred shading
+    GBuffer gbuffer;
+    bool deferred = false; // this frame
+    QOpenGLVertexArrayObject quadVAO;
+    QOpenGLBuffer quadBuffer;
+
+    struct {
+        int lightPasses = 0;
+        qint64 pixels = 0; // lit, all the passes
+    } deferredStats;
+
+    void lightGBuffer(const Frame& frame);
+
+    // shadows
+    enum { SHADOW_UNIT = 4 }; // texture units of the cube maps, after the clusters and the G-buffer ones
+
+    ShadowMaps shadowMaps;
+    int shadowLights = 0; // this frame, 0 is off
+    QOpenGLVertexArrayObject shadowVAO;
+
+    void updateShadows();
+
+    // planar reflection
+    enum { REFLECTION_UNIT = 7 };
+
+    PlanarReflection reflection;
+    bool reflected = false; // this frame
+    bool reflectionRefreshed = false; // this frame
+    QOpenGLVertexArrayObject reflectionVAO;
+
+    struct {
+        bool valid = false;
+        QMatrix4x4 pv;
+        QVector3D light;
+        QVector4D material;
+        QVector<Matrix> models;
+    } reflectionState; // what the texture shows
+
+    void updateReflection(const Frame& frame);
+
+    // dynamic resolution
+    DynamicResolution resolution;
+    bool scaled = false; // this frame, the scene goes to the offscreen target
+    GLuint sceneFramebuffer = 0; // this frame
+    GLuint outputFramebuffer = 0; // this frame, where the anti-aliasing writes: the window or the dynamic resolution target
+
+    void bindSceneFramebuffer();
+    void upscale();
+
+    // anti-aliasing
+    AntiAliasing aaTarget;
+    AntiAliasing::Mode aaMode = AntiAliasing::OFF; // this frame
+
+    void resolveAntiAliasing();
+
+    // quality governor
+    QualityGovernor governor;
+    QualityGovernor::Settings quality; // this frame, what the user set minus what the governor gave up
+    QualityGovernor::Settings wantedQuality() const;
+
+    // multi-view, insets drawn with the same update and the same GL resources in the one context
+    enum { KNIGHT_VIEW = 1, TOP_VIEW = 2, NINSET = 2 }; // 0 is the main view
+    bool drawingInset = false; // this frame, forward only
+
+    Frame insetFrame(int view, float aspect) const;
+    QMatrix4x4 knightView(QVector3D& eye) const; // camera on the moving piece
+    void renderInsets();
+
+    void drawBoard(const Frame& frame);
+
+    // tournament wall, one instanced draw per mesh and one for the boards
+    TournamentWall tournament;
+    bool walled = false; // this frame
+    QOpenGLVertexArrayObject wallVAO;
+    QOpenGLBuffer wallInstances;
+    QVector<float> wallData; // per instance, see TournamentWall::instances
+    QVector<int> wallFirst, wallCount;
+
+    enum { WALL_BENCHMARK_WARMUP = 30, WALL_BENCHMARK_FRAMES = 150 }; // per board count
+
+    struct {
+        int step = -1; // in the board counts, -1 when not running
+        int frames = 0; // of the step
+        qint64 cpuNs = 0, gpuNs = 0; // measured frames of the step
+        int cpuFrames = 0, gpuFrames = 0;
+        int boards = 0; // of the user, back at the end
+    } wallBenchmark;
+
+    void setupTournament(double t);
+    Frame wallFrame() const;
+    void drawTournament();
+    void stepWallBenchmark();
+
+    // hud, every segment of the frame in one GL_LINES draw
+    HUD hudText;
+    QOpenGLVertexArrayObject hudVAO;
+    QOpenGLBuffer hudBuffer;
+    QElapsedTimer frameClock; // interval between two frames
+    bool frameChained = false; // the last frame asked for the next one
+
+    void drawHUD(const Frame& frame);
+
+    // software backend, the board, the pieces and the cubemap of the render queue rasterized on the cpu
+    SoftRasterizer softRaster;
+    bool softwareBackend = false;
+    bool softwareBenchmark = false; // at the next frame
+    int softwareCubeMap = -1; // given to softRaster, -1 before the first frame
+
+    enum { SOFTWARE_BENCHMARK_FRAMES = 10 }; // per thread count, after one of warmup
+
+    QImage cubeMapFace(int n, int face) const;
+    const QImage& drawSoftware(const Frame& frame, int width, int height);
+    void renderSoftware();
+    void benchmarkSoftware(const Frame& frame);
+
+    // reference stills, see PathTracer
+    PathTracer pathTracer;
+    bool pathTracePending = false; // at the next frame
+
+    enum { PATH_TRACE_SAMPLES = 256 };
+
+    void beginPathTrace(const Frame& frame);
+
+    // picking, the BVH of each mesh is in object space, built at its first pick
+    QHash<const OBJObject*, Bvh> meshBvhs;
+    Pick hovered;
+
+    const Bvh& meshBvh(const OBJObject* obj);
+
+    Frame beginFrame() const;
+    void fillRenderQueue(const Frame& frame);
+    void record(const Frame& frame, int begin, int end, CommandList& list) const;
+    void submit(const CommandList& list);
+    void drawRange(const Frame& frame, int begin, int end);
 
     void loadTextures();
     void loadModels();
     void prepareShaderProgram();
     void prepareVertexBuffers();
 
-    // animations
+    // animations, the simulation's once it runs (but onKnightAnim, of the frames)
 public:
 
     float timeEndKnightAnimation = 0;
@@ -171,7 +560,7 @@ public:
         enum {WAIT, RUN, DONE} state = WAIT;
 
         Scene* scene = nullptr;
-        ChessPiece* piece = nullptr;
+        Pieces::Handle piece = Pieces::NONE;
         QPoint fr, to;
         QVector3D pos3D;
         QVector3D P[4];
@@ -182,17 +571,18 @@ public:
                 x = std::max(1,x);
                 self.preffered = x % 2 == 1 ? DEG3 : DEG4;
                 self.type = x % 2 == 1 ? DEG3 : DEG4;
-                self.height = getHeight(x);
-            }
-
-            float getHeight(int i) {
-                return 1.f * ((std::max(1,i) + 1) / 2);
+                self.height = modeHeight(x);
             }
         } mode;
 
+        // of the curve for the value of mode, any thread
+        static float modeHeight(int i) {
+            return 1.f * ((std::max(1,i) + 1) / 2);
+        }
+
         KnightAnimation() : mode{*this} {}
 
-        QVector3D rightVector();
+        QVector3D rightVector() const;
 
         void startTo(QPoint target);
         void update(float tnow);
@@ -239,10 +629,7 @@ public:
     struct Falling {
         Scene* scene;
         float timeCutOff = 15; //s
-        bool running = false;
-        QList<float> positions; // of top point
-        QList<float> velocities; // of top point
-        QList<float> masses;
+        bool running = false; // the state of each piece is in Pieces
 
         float g = 10.0;
         float k = 60;
@@ -252,18 +639,13 @@ public:
         float firstT = 0, lastT = 0;
 
         void start(float t) {
-            positions.clear();
-            velocities.clear();
-            masses.clear();
-
-            const float rho = 1;
+            Pieces& pieces = scene->pieces;
             running = true;
             firstT = lastT = t;
-            for(ChessPiece* obj : scene->chessPieces) {
+            for(Pieces::Handle h = 0; h < pieces.size(); h++) {
                 float random = rand() / (float)RAND_MAX;
-                positions.append(startingHeight + random * 1.50 + obj->type->geom.size.z());
-                velocities.append(0);
-                masses.append(rho * obj->type->geom.size.x() * obj->type->geom.size.y() * obj->type->geom.size.z());
+                pieces.heights[h] = startingHeight + random * 1.50 + pieces.tops[h];
+                pieces.velocities[h] = 0;
             }
         }
 
@@ -272,12 +654,16 @@ public:
 
             bool stop = true;
             float dt = t - lastT;
-            auto pp = positions.begin(); auto vv = velocities.begin(); auto mm = masses.begin();
-            for(ChessPiece* obj : scene->chessPieces) {
-                auto& p = *pp++; auto& v = *vv++; auto& m = *mm++;
-                auto H = obj->type->geom.size.z();
-                float d = H - p;
-                float a = d > 0 ? d * k / m - alpha * v : -g;
+            Pieces& pieces = scene->pieces;
+            float* heights = pieces.heights.data();
+            float* velocities = pieces.velocities.data();
+            const float* tops = pieces.tops.constData();
+            const float* masses = pieces.masses.constData();
+            for(int h = 0; h < pieces.size(); h++) {
+                float& p = heights[h];
+                float& v = velocities[h];
+                float d = tops[h] - p;
+                float a = d > 0 ? d * k / masses[h] - alpha * v : -g;
                 v += a * dt;
                 p += v * dt;
                 if(!(abs(v) < eps && abs(a) < eps))
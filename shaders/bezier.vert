@@ -1,6 +1,23 @@
 #version 130
+#ifdef STREAMED
+#extension GL_ARB_uniform_buffer_object : require
+layout(std140) uniform Object {
+    mat4 matrix;
+    mat4 model;
+    mat4 normalMatrix;
+    int color;
+};
+layout(std140) uniform Frame {
+    vec4 camera;
+    vec4 light;
+    vec4 lights[10];
+    vec4 lightColors[10];
+    vec4 P[4];
+};
+#else
 uniform vec3 P[4];
 uniform mat4 matrix;
+#endif
 
 in float t; // from 0 to 1
 
@@ -13,9 +30,9 @@ void main()
     float u = 1 - t;
     vec3 vertexPosition;
     if(degree == 4)
-        vertexPosition = u*u*u * P[0] + 3*u*u*t * P[1] + 3*u*t*t * P[2] + t*t*t * P[3];
+        vertexPosition = u*u*u * P[0].xyz + 3*u*u*t * P[1].xyz + 3*u*t*t * P[2].xyz + t*t*t * P[3].xyz;
     else
-        vertexPosition = u*u * P[0] + 2*u*t * P[1] + t*t * P[2];
+        vertexPosition = u*u * P[0].xyz + 2*u*t * P[1].xyz + t*t * P[2].xyz;
     gl_Position = matrix * vec4(vertexPosition, 1);
     vertexColor = vec3(1,0,0) * t + u * vec3(0,1,0);
 }
@@ -1,24 +1,76 @@
 #version 130
 
+#ifndef N_LIGHTS
+#define N_LIGHTS 1
+#endif
+
+#ifdef CLUSTERED
+#extension GL_ARB_texture_buffer_object : require
+#endif
+
+#ifdef STREAMED
+#extension GL_ARB_uniform_buffer_object : require
+layout(std140) uniform Object {
+    mat4 matrix;
+    mat4 model;
+    mat4 normalMatrix;
+    int color;
+};
+layout(std140) uniform Frame {
+    vec4 camera;
+    vec4 light;
+    vec4 lights[10];
+    vec4 lightColors[10];
+    vec4 P[4];
+};
+layout(std140) uniform Material { // uploaded when a parameter changes, the pieces are for chess.frag
+    float pieceShininess;
+    float pieceCookLambda;
+    float pieceCookRoughness;
+    float reflectFactor;
+    float refractFactor;
+    float refractIndice;
+};
+#else
 uniform int color;
 uniform vec3 camera;
+uniform vec3 lights[N_LIGHTS];
+uniform vec3 lightColors[N_LIGHTS];
+
+uniform float reflectFactor = 0.2;
+uniform float refractFactor = 0.1;
+uniform float refractIndice = 0.2;
+#endif
 
 uniform sampler2D normalMap;
 uniform samplerCube cubemap;
 uniform float shininess = 32;
 
-uniform vec3 lights[4];
-uniform vec3 lightColors[4];
-uniform int nLights = 1;
-uniform float reflectFactor = 0.2;
-uniform float refractFactor = 0.1;
-uniform float refractIndice = 0.2;
+#ifdef PLANAR_REFLECTION
+uniform sampler2D planarReflection; // mirrored pieces, alpha 1 where there is one (see PlanarReflection)
+uniform vec3 reflectionViewport; // width, height of the screen
+#endif
 
 in vec2 texCoord;
 in vec3 position;
 in vec3 normal;
 
+#ifdef DEFERRED
+out vec4 gAlbedo;
+out vec4 gNormal;
+out vec4 gEmissive;
+#include "octahedral.glsl"
+#else
 out vec4 fragColor;
+#endif
+
+#ifdef CLUSTERED
+#include "clusters.glsl"
+#endif
+
+#ifdef SHADOWS
+#include "shadows.glsl"
+#endif
 
 vec3 normalToColor(vec3 n) { return (n + 1) / 2; }
 vec3 colorToNormal(vec3 c) { return c * 2 - 1; }
@@ -30,29 +82,55 @@ void main(void)
     vec3 ambiant = vec3(1)/5.0;
 
     vec3 N = normalize(normalMapVec);
-    vec3 V = normalize(camera - position);
+    vec3 V = normalize(camera.xyz - position);
 
     vec3 diffuse = vec3(0);
     vec3 specular = vec3(0);
 
-    for(int i = 0; i < nLights; i++) {
-        vec3 L = normalize(lights[i] - position);
+    for(int i = 0; i < N_LIGHTS; i++) {
+        vec3 L = normalize(lights[i].xyz - position);
         vec3 R = normalize(2 * dot(L,N) * N - L);
 
-        diffuse += max(0, dot(L,N)) * lightColors[i];
-        specular += pow(max(0, dot(R,V)), shininess) * lightColors[i];
+        float lit = 1;
+#ifdef SHADOWS
+        lit = shadow(i, position);
+#endif
+        diffuse += lit * max(0, dot(L,N)) * lightColors[i].rgb;
+        specular += lit * pow(max(0, dot(R,V)), shininess) * lightColors[i].rgb;
     }
 
+#ifdef CLUSTERED
+    clusterLighting(position, N, V, shininess, diffuse, specular);
+#endif
+
     vec3 myColor;
     if(color == 0)
         myColor = vec3(0.29,0.15,0); // vec3(0,0,1); // black
     else
         myColor = vec3(0.8); // vec3(1,0,0); // white
 
-    vec4 refl = reflectFactor * texture(cubemap, reflect(-V,N));
-    vec4 refr = refractFactor * texture(cubemap, refract(-V,N,refractIndice));
+    vec4 environment = vec4(0);
+#ifdef REFLECT
+    vec4 reflected = texture(cubemap, reflect(-V,N));
+#ifdef PLANAR_REFLECTION
+    // the pieces in front of the sky, the bumps of the normal map shift them a little
+    vec4 mirror = texture(planarReflection, gl_FragCoord.xy / reflectionViewport.xy + 0.02 * N.xy);
+    reflected = mix(reflected, mirror, mirror.a);
+#endif
+    environment += reflectFactor * reflected;
+#endif
+#ifdef REFRACT
+    environment += refractFactor * texture(cubemap, refract(-V,N,refractIndice));
+#endif
 
-    fragColor = vec4((ambiant + diffuse + specular) * myColor, 1) +  refl + refr;
+#ifdef DEFERRED
+    // the lights are added later in screen space, see deferred.frag
+    gAlbedo = vec4(myColor, 0); // material 0: board
+    gNormal = vec4(encodeNormal(N), 0, 0);
+    gEmissive = vec4(ambiant * myColor, 1) + environment;
+#else
+    fragColor = vec4((ambiant + diffuse + specular) * myColor, 1) + environment;
+#endif
     // fragColor = ((position/8)+1)/2; // normalMapVec;
     // fragColor = normalToColor(L);
 }
@@ -1,12 +1,22 @@
 #version 130
 
-in vec3 vertexPosition;
-in vec3 vertexNormal;
-
+#ifdef STREAMED
+#extension GL_ARB_uniform_buffer_object : require
+layout(std140) uniform Object {
+    mat4 matrix;
+    mat4 model;
+    mat4 normalMatrix; // mat3 in the upper left
+    int color;
+};
+#else
 uniform int color;
 uniform mat4 matrix;
 uniform mat4 model;
 uniform mat3 normalMatrix;
+#endif
+
+in vec3 vertexPosition;
+in vec3 vertexNormal;
 
 out vec3 position;
 out vec3 normal;
@@ -15,7 +25,7 @@ out vec2 texCoord;
 void main(void)
 {
     position = vec3(model * vec4(vertexPosition, 1));
-    normal = normalMatrix * vertexNormal;
+    normal = mat3(normalMatrix) * vertexNormal;
     normal = vec3(0,0,1);
     texCoord = vec2(vertexPosition);
     gl_Position = matrix * vec4(vertexPosition, 1);
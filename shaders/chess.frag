@@ -1,19 +1,66 @@
 #version 130
 
+#ifndef LIGHTING_MODEL
+#define LIGHTING_MODEL 0 // PHONG, BLINN-PHONG, COOK
+#endif
+
+#ifdef CLUSTERED
+#extension GL_ARB_texture_buffer_object : require
+#endif
+
+#ifdef STREAMED
+#extension GL_ARB_uniform_buffer_object : require
+layout(std140) uniform Object {
+    mat4 matrix;
+    mat4 model;
+    mat4 normalMatrix;
+    int color;
+};
+layout(std140) uniform Frame {
+    vec4 camera;
+    vec4 light;
+    vec4 lights[10];
+    vec4 lightColors[10];
+    vec4 P[4];
+};
+layout(std140) uniform Material { // uploaded when a parameter changes
+    float shininess;
+    float cookLambda; // [0,1]
+    float cookRoughness;
+    float reflectFactor;
+    float refractFactor;
+    float refractIndice;
+};
+#else
 uniform vec3 light;
 uniform vec3 camera;
 uniform int color;
 uniform float shininess = 32;
-uniform int lightingModel = 0; // PHONG
 uniform float cookLambda = 0.4; // [0,1]
 uniform float cookRoughness = 0.2;
+#endif
 
 const float Pi = 3.14159265358979323846;
 
 in vec3 position;
 in vec3 normal;
 
-out vec3 fragColor;
+#ifdef CLUSTERED
+#include "clusters.glsl"
+#endif
+
+#ifdef SHADOWS
+#include "shadows.glsl"
+#endif
+
+#ifdef DEFERRED
+out vec4 gAlbedo;
+out vec4 gNormal;
+out vec4 gEmissive;
+#include "octahedral.glsl"
+#else
+out vec4 fragColor; // alpha 1, the planar reflection tells the pieces from the background with it
+#endif
 
 void main()
 {
@@ -25,19 +72,18 @@ void main()
     vec3 specular = vec3(0);
 
     vec3 lightColor = vec3(1);
-    vec3 L = normalize(light - position);
+    vec3 L = normalize(light.xyz - position);
     diffuse += max(0, dot(L,N)) * vec3(1);
 
-    vec3 V = normalize(camera - position);
+    vec3 V = normalize(camera.xyz - position);
     vec3 R = normalize(2 * dot(L,N) * N - L);
     vec3 H = normalize(V + L);
-    if(lightingModel < 2) {
-        if(lightingModel == 0) {
-            specular += pow(max(0, dot(R,V)), shininess) * lightColor;
-        } else {
-            specular += pow(max(0, dot(N,H)), shininess) * lightColor;
-        }
-    } else {
+#if LIGHTING_MODEL == 0
+    specular += pow(max(0, dot(R,V)), shininess) * lightColor;
+#elif LIGHTING_MODEL == 1
+    specular += pow(max(0, dot(N,H)), shininess) * lightColor;
+#else
+    {
         // from wikipedia
 
         float VN = dot(V,N);
@@ -56,6 +102,17 @@ void main()
 
         specular += kspec * lightColor;
     }
+#endif
+
+#ifdef SHADOWS
+    float lit = shadow(0, position);
+    diffuse *= lit;
+    specular *= lit;
+#endif
+
+#ifdef CLUSTERED
+    clusterLighting(position, N, V, shininess, diffuse, specular);
+#endif
 
     vec3 myColor;
     if(color == 0)
@@ -63,6 +120,13 @@ void main()
     else
        myColor = vec3(0,0.5,1); // black guy
 
-    fragColor = (ambiant + diffuse + specular) * myColor;
+#ifdef DEFERRED
+    // the lights are added later in screen space, see deferred.frag
+    gAlbedo = vec4(myColor, (1 + LIGHTING_MODEL) / 3.0); // materials 1 to 3: pieces
+    gNormal = vec4(encodeNormal(N), 0, 0);
+    gEmissive = vec4(ambiant * myColor, 1);
+#else
+    fragColor = vec4((ambiant + diffuse + specular) * myColor, 1);
+#endif
     // fragColor = N; // (L+1)/2;
 }
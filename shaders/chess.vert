@@ -1,11 +1,22 @@
 #version 130
 
-in vec3 vertexPosition;
-in vec3 vertexNormal;
+#ifdef STREAMED
+#extension GL_ARB_uniform_buffer_object : require
+layout(std140) uniform Object {
+    mat4 matrix;
+    mat4 model;
+    mat4 normalMatrix; // mat3 in the upper left
+    int color;
+};
+#else
 uniform mat4 matrix;
 uniform mat4 model;;
 uniform mat3 normalMatrix;
 uniform int color;
+#endif
+
+in vec3 vertexPosition;
+in vec3 vertexNormal;
 
 out vec3 position;
 out vec3 normal;
@@ -13,6 +24,6 @@ out vec3 normal;
 void main(void)
 {
     position = vec3(model * vec4(vertexPosition, 1));
-    normal = normalMatrix * vertexNormal;
+    normal = mat3(normalMatrix) * vertexNormal;
     gl_Position = matrix * vec4(vertexPosition, 1);
 }
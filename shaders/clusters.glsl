@@ -0,0 +1,40 @@
+// clustered point lights, included when CLUSTERED is defined
+// CLUSTER_X, CLUSTER_Y, CLUSTER_Z are given by the program (see LightClusters)
+
+uniform samplerBuffer clusterLights; // 2 texels per light: position radius, color
+uniform usamplerBuffer clusterItems; // offset count per cluster, then the light indices
+uniform vec3 clusterViewport; // width, height
+uniform vec3 clusterDepth; // near, far, slices / log(far / near)
+
+void clusterLighting(vec3 position, vec3 N, vec3 V, float shininess, inout vec3 diffuse, inout vec3 specular)
+{
+    float zNear = clusterDepth.x, zFar = clusterDepth.y;
+    float ndc = gl_FragCoord.z * 2 - 1;
+    float depth = 2 * zNear * zFar / (zFar + zNear - ndc * (zFar - zNear));
+
+    ivec3 c = ivec3(vec3(gl_FragCoord.xy / clusterViewport.xy * vec2(CLUSTER_X, CLUSTER_Y), log(depth / zNear) * clusterDepth.z));
+    c = clamp(c, ivec3(0), ivec3(CLUSTER_X - 1, CLUSTER_Y - 1, CLUSTER_Z - 1));
+    int cluster = (c.z * CLUSTER_Y + c.y) * CLUSTER_X + c.x;
+
+    int offset = int(texelFetch(clusterItems, 2 * cluster).r);
+    int count = int(texelFetch(clusterItems, 2 * cluster + 1).r);
+
+    for(int k = 0; k < count; k++) {
+        int i = int(texelFetch(clusterItems, offset + k).r);
+        vec4 lightSphere = texelFetch(clusterLights, 2 * i);
+        vec3 lightColor = texelFetch(clusterLights, 2 * i + 1).rgb;
+
+        vec3 L = lightSphere.xyz - position;
+        float d = length(L);
+        if(d >= lightSphere.w)
+            continue;
+        L /= d;
+
+        float attenuation = 1 - d / lightSphere.w;
+        attenuation *= attenuation;
+
+        vec3 R = normalize(2 * dot(L,N) * N - L);
+        diffuse += attenuation * max(0, dot(L,N)) * lightColor;
+        specular += attenuation * pow(max(0, dot(R,V)), shininess) * lightColor;
+    }
+}
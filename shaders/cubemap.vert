@@ -7,6 +7,6 @@ out vec3 texcoord;
 
 void main(void)
 {
-    gl_Position = matrix * vec4(position, 1);
+    gl_Position = (matrix * vec4(position, 1)).xyww; // z = w, depth 1, the far plane
     texcoord = position;
 }
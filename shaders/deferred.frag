@@ -0,0 +1,107 @@
+#version 130
+
+// screen space passes of the deferred path, over the G-buffer written by chess.frag and board.frag
+
+uniform sampler2D gAlbedo; // rgb, a = material / 3: board, phong, blinn-phong, cook
+uniform sampler2D gNormal; // octahedral
+uniform sampler2D gEmissive; // ambient and cubemap, what doesn't depend on the lights
+uniform sampler2D gDepth;
+
+in vec2 texCoord;
+
+out vec4 fragColor;
+
+#ifdef COMPOSE
+
+// light independent color, and the depth of the scene for the forward draws that come after
+void main(void)
+{
+    fragColor = texture(gEmissive, texCoord);
+    gl_FragDepth = texture(gDepth, texCoord).r;
+}
+
+#else
+
+#include "octahedral.glsl"
+
+#ifdef SHADOWS
+#include "shadows.glsl"
+uniform int shadowIndex = -1; // main light of the pass, -1 for the point lights
+#endif
+
+uniform mat4 inversePV;
+uniform vec3 camera;
+uniform vec4 lightSphere; // position, radius, radius 0 for a light without falloff
+uniform vec3 lightColor;
+uniform int boardOnly = 0; // like the forward path, only the main light lights the pieces
+uniform float boardShininess = 32;
+uniform float shininess = 32; // pieces
+uniform float cookLambda = 0.4;
+uniform float cookRoughness = 0.2;
+
+const float Pi = 3.14159265358979323846;
+
+// one light, added on the pixels of its volume
+void main(void)
+{
+    float depth = texture(gDepth, texCoord).r;
+    if(depth == 1)
+        discard; // sky
+
+    vec4 albedo = texture(gAlbedo, texCoord);
+    int material = int(albedo.a * 3 + 0.5);
+    if(boardOnly != 0 && material != 0)
+        discard;
+
+    vec4 p = inversePV * vec4(vec3(texCoord, depth) * 2 - 1, 1);
+    vec3 position = p.xyz / p.w;
+
+    vec3 N = decodeNormal(texture(gNormal, texCoord).xy);
+    vec3 V = normalize(camera - position);
+    vec3 L = lightSphere.xyz - position;
+    float d = length(L);
+    L /= d;
+
+    float attenuation = 1;
+    if(lightSphere.w > 0) {
+        if(d >= lightSphere.w)
+            discard;
+        attenuation = 1 - d / lightSphere.w;
+        attenuation *= attenuation;
+    }
+
+#ifdef SHADOWS
+    if(shadowIndex >= 0)
+        attenuation *= shadow(shadowIndex, position);
+#endif
+
+    vec3 R = normalize(2 * dot(L,N) * N - L);
+    vec3 H = normalize(V + L);
+
+    float diffuse = max(0, dot(L,N));
+    float specular;
+    if(material == 0) {
+        specular = pow(max(0, dot(R,V)), boardShininess);
+    } else if(material == 1) {
+        specular = pow(max(0, dot(R,V)), shininess);
+    } else if(material == 2) {
+        specular = pow(max(0, dot(N,H)), shininess);
+    } else {
+        // same as chess.frag
+        float VN = dot(V,N);
+        float NL = dot(N,L);
+        float F = pow(1+VN, cookLambda);
+        float NH = dot(N,H);
+        float NH2 = NH * NH;
+        float m2 = cookRoughness * cookRoughness;
+        float x = (1 - NH2) / (NH2 * m2);
+        float D = exp(-x) / (Pi * m2 * NH2);
+        float VH = dot(V,H);
+        float G = min(1, min(2 * NH * VN / VH, 2 * NH * NL / VH));
+        specular = D*F*G / (4 * (VN) * (NL));
+    }
+
+    fragColor = vec4(attenuation * (diffuse + specular) * lightColor * albedo.rgb, 1);
+}
+
+#endif
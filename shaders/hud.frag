@@ -0,0 +1,10 @@
+#version 130
+
+in vec3 color;
+
+out vec4 fragColor;
+
+void main(void)
+{
+    fragColor = vec4(color, 1);
+}
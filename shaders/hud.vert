@@ -0,0 +1,16 @@
+#version 130
+
+// hud text, line segments in window pixels
+
+uniform mat4 matrix; // pixels, y down, to clip space
+
+in vec3 vertexPosition;
+in vec3 vertexColor;
+
+out vec3 color;
+
+void main(void)
+{
+    color = vertexColor;
+    gl_Position = matrix * vec4(vertexPosition.xy, 0, 1);
+}
@@ -0,0 +1,20 @@
+// octahedral encoding of unit vectors in two numbers in [-1,1], for the G-buffer normals
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0 ? 1.0 : -1.0, v.y >= 0 ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0 ? n.xy : (1 - abs(n.yx)) * signNotZero(n.xy);
+}
+
+vec3 decodeNormal(vec2 e)
+{
+    vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+    if(n.z < 0)
+        n.xy = (1 - abs(n.yx)) * signNotZero(n.xy);
+    return normalize(n);
+}
@@ -0,0 +1,64 @@
+#version 130
+
+// full screen passes on the color of the scene:
+// FXAA, or the stretch of the scene drawn at a lower resolution to the window (see DynamicResolution)
+
+uniform sampler2D sceneColor;
+uniform vec3 texelSize; // 1 / width, 1 / height of the scene, sharpening strength
+
+in vec2 texCoord;
+
+out vec4 fragColor;
+
+#ifdef FXAA
+
+// fxaa, the simple version of Timothy Lottes: blur along the edge found by the luma gradient
+const float reduceMin = 1.0 / 128;
+const float reduceMul = 1.0 / 8;
+const float spanMax = 8;
+
+float luma(vec3 c) { return dot(c, vec3(0.299, 0.587, 0.114)); }
+
+vec3 at(vec2 offset) { return texture(sceneColor, texCoord + offset * texelSize.xy).rgb; }
+
+void main(void)
+{
+    float nw = luma(at(vec2(-1, 1))), ne = luma(at(vec2(1, 1)));
+    float sw = luma(at(vec2(-1, -1))), se = luma(at(vec2(1, -1)));
+    float m = luma(at(vec2(0)));
+
+    float lumaMin = min(m, min(min(nw, ne), min(sw, se)));
+    float lumaMax = max(m, max(max(nw, ne), max(sw, se)));
+
+    // perpendicular to the gradient, that is along the edge
+    vec2 dir = vec2(-((nw + ne) - (sw + se)), (nw + sw) - (ne + se));
+    float reduce = max((nw + ne + sw + se) * 0.25 * reduceMul, reduceMin);
+    dir = clamp(dir / (min(abs(dir.x), abs(dir.y)) + reduce), vec2(-spanMax), vec2(spanMax));
+
+    vec3 a = 0.5 * (at(dir * (1.0 / 3 - 0.5)) + at(dir * (2.0 / 3 - 0.5)));
+    vec3 b = 0.5 * a + 0.25 * (at(dir * -0.5) + at(dir * 0.5));
+
+    // the wide blur overshoots where the edge is a thin line, the narrow one is kept there
+    float lumaB = luma(b);
+    fragColor = vec4(lumaB < lumaMin || lumaB > lumaMax ? a : b, 1);
+}
+
+#else
+
+void main(void)
+{
+    vec4 color = texture(sceneColor, texCoord); // bilinear
+
+#ifdef SHARPEN
+    // unsharp mask on the 4 neighbours, gives back some of the contrast the stretch blurs
+    vec4 around = texture(sceneColor, texCoord + vec2(texelSize.x, 0))
+                + texture(sceneColor, texCoord - vec2(texelSize.x, 0))
+                + texture(sceneColor, texCoord + vec2(0, texelSize.y))
+                + texture(sceneColor, texCoord - vec2(0, texelSize.y));
+    color = clamp(color + texelSize.z * (4 * color - around), 0, 1);
+#endif
+
+    fragColor = color;
+}
+
+#endif
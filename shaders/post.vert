@@ -0,0 +1,11 @@
+#version 130
+
+in vec2 position; // full screen quad, in clip space
+
+out vec2 texCoord;
+
+void main(void)
+{
+    texCoord = position * 0.5 + 0.5;
+    gl_Position = vec4(position, 0, 1);
+}
@@ -0,0 +1,6 @@
+#version 130
+
+// depth only
+void main()
+{
+}
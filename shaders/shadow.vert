@@ -0,0 +1,11 @@
+#version 130
+
+// depth of the pieces seen from a light, one face of its cube map (see ShadowMaps)
+
+in vec3 vertexPosition;
+uniform mat4 matrix;
+
+void main()
+{
+    gl_Position = matrix * vec4(vertexPosition, 1);
+}
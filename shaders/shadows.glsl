@@ -0,0 +1,41 @@
+// shadows of the main lights, included when SHADOWS is defined
+// N_SHADOWS (1 to 3) depth cube maps drawn from the lights (see ShadowMaps)
+
+uniform samplerCubeShadow shadowMap0;
+uniform vec3 shadowOrigin0; // where the map was drawn from, the turning light snaps to a step of its orbit
+#if N_SHADOWS > 1
+uniform samplerCubeShadow shadowMap1;
+uniform vec3 shadowOrigin1;
+#endif
+#if N_SHADOWS > 2
+uniform samplerCubeShadow shadowMap2;
+uniform vec3 shadowOrigin2;
+#endif
+uniform vec3 shadowDepth; // near, far of the faces
+
+// 1 lit, 0 in the shadow, the comparison is filtered by the hardware
+float shadowFace(samplerCubeShadow map, vec3 fromLight)
+{
+    // the face is the one of the major axis, its projection gives the depth that was stored
+    vec3 a = abs(fromLight);
+    float z = max(a.x, max(a.y, a.z));
+    float n = shadowDepth.x, f = shadowDepth.y;
+    float ndc = (f + n) / (f - n) - 2 * f * n / ((f - n) * z);
+    return texture(map, vec4(fromLight, ndc * 0.5 + 0.5));
+}
+
+// samplers can't be indexed by a variable in glsl 1.30
+float shadow(int i, vec3 position)
+{
+    if(i == 0)
+        return shadowFace(shadowMap0, position - shadowOrigin0);
+#if N_SHADOWS > 1
+    if(i == 1)
+        return shadowFace(shadowMap1, position - shadowOrigin1);
+#endif
+#if N_SHADOWS > 2
+    if(i == 2)
+        return shadowFace(shadowMap2, position - shadowOrigin2);
+#endif
+    return 1;
+}
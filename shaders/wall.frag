@@ -0,0 +1,36 @@
+#version 130
+
+// tournament wall, cheap blinn-phong with the main light seen from far away
+
+uniform vec3 light; // direction toward the light
+uniform vec3 camera;
+
+in vec3 position;
+in vec3 normal;
+flat in float color;
+
+#ifdef BOARD
+in vec2 square;
+#endif
+
+out vec4 fragColor;
+
+void main(void)
+{
+#ifdef BOARD
+    vec3 albedo;
+    if(any(lessThan(square, vec2(0))) || any(greaterThanEqual(square, vec2(8))))
+        albedo = vec3(0.25, 0.15, 0.08); // border
+    else
+        albedo = (int(square.x) + int(square.y)) % 2 == 0 ? vec3(0.2) : vec3(0.8);
+#else
+    vec3 albedo = color > 0.5 ? vec3(0.15) : vec3(0.9);
+#endif
+
+    vec3 N = normalize(normal);
+    vec3 V = normalize(camera - position);
+    vec3 H = normalize(light + V);
+    float diffuse = max(0, dot(N, light));
+    float specular = pow(max(0, dot(N, H)), 32);
+    fragColor = vec4(albedo * (0.2 + diffuse) + 0.3 * specular, 1);
+}
@@ -0,0 +1,35 @@
+#version 130
+
+// tournament wall, instanced: one vec4 per piece or per board, position on the wall and color
+
+uniform mat4 matrix; // projection * view
+
+in vec3 vertexPosition;
+in vec3 vertexNormal;
+in vec4 vertexInstance;
+
+out vec3 position;
+out vec3 normal;
+flat out float color;
+
+#ifdef BOARD
+out vec2 square; // A1 is [0,1[^2, the border is outside of [0,8[^2
+#endif
+
+void main(void)
+{
+#ifdef BOARD
+    // the quad of the screen space passes, stretched over the squares and the border
+    vec2 local = vertexPosition.xy * 5;
+    square = local + 4;
+    normal = vec3(0, 0, 1);
+    position = vertexInstance.xyz + vec3(local, 0);
+#else
+    // the black pieces look the other way, like in the scene
+    float s = vertexInstance.w > 0.5 ? -1 : 1;
+    normal = vec3(s * vertexNormal.xy, vertexNormal.z);
+    position = vertexInstance.xyz + vec3(s * vertexPosition.xy, vertexPosition.z);
+#endif
+    color = vertexInstance.w;
+    gl_Position = matrix * vec4(position, 1);
+}
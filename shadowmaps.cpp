@@ -0,0 +1,157 @@
+#include "shadowmaps.h"
+
+#include <QDebug>
+#include <QLoggingCategory>
+
+#include <cmath>
+
+Q_LOGGING_CATEGORY(shadowLog, "chess.shadows", QtInfoMsg)
+
+bool ShadowMaps::create(GLExtensions* ext, int size, float zNear, float zFar)
+{
+    destroy();
+    this->ext = ext;
+
+    if(!ext->framebufferObject)
+        return false;
+
+    mySize = size;
+    myNear = zNear;
+    myFar = zFar;
+
+    for(Light& light : lights) {
+        for(GLuint* map : {&light.cachedMap, &light.liveMap}) {
+            glGenTextures(1, map);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, *map);
+            for(int face = 0; face < FACES; face++)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+
+            // samplerCubeShadow, linear gives 2x2 filtered comparisons for free
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        }
+        light.valid = false;
+        light.useLive = false;
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    // depth only
+    ext->GenFramebuffers(2, fbos);
+    for(GLuint fbo : fbos) {
+        ext->BindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+
+    ext->FramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, lights[0].liveMap, 0);
+    GLenum status = ext->CheckFramebufferStatus(GL_FRAMEBUFFER);
+    ext->BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        qDebug() << "shadow maps incomplete" << status;
+        destroy();
+        return false;
+    }
+
+    qDebug() << "shadow maps:" << MAX_LIGHTS << "lights," << size << "x" << size << "faces";
+    return true;
+}
+
+void ShadowMaps::destroy()
+{
+    if(!fbos[0])
+        return;
+
+    ext->DeleteFramebuffers(2, fbos);
+    fbos[0] = fbos[1] = 0;
+    for(Light& light : lights) {
+        GLuint maps[] = {light.cachedMap, light.liveMap};
+        glDeleteTextures(2, maps);
+        light.cachedMap = light.liveMap = 0;
+    }
+}
+
+void ShadowMaps::invalidate()
+{
+    for(Light& light : lights)
+        light.valid = false;
+}
+
+void ShadowMaps::faceMatrices(QVector3D light, QMatrix4x4 faces[FACES]) const
+{
+    // directions and up vectors of the cube map faces, +X -X +Y -Y +Z -Z
+    static const QVector3D directions[FACES] = {{1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1}};
+    static const QVector3D ups[FACES] = {{0,-1,0}, {0,-1,0}, {0,0,1}, {0,0,-1}, {0,-1,0}, {0,-1,0}};
+
+    QMatrix4x4 projection;
+    projection.perspective(90, 1, myNear, myFar);
+
+    for(int face = 0; face < FACES; face++) {
+        QMatrix4x4 view;
+        view.lookAt(light, light + directions[face], ups[face]);
+        faces[face] = projection * view;
+    }
+}
+
+QVector3D ShadowMaps::snap(QVector3D position)
+{
+    float radius = std::hypot(position.x(), position.y());
+    float step = 2 * M_PI / ORBIT_STEPS;
+    float angle = std::round(std::atan2(position.y(), position.x()) / step) * step;
+    return QVector3D(radius * std::cos(angle), radius * std::sin(angle), position.z());
+}
+
+bool ShadowMaps::needsRebuild(int i, QVector3D position)
+{
+    Light& light = lights[i];
+    if(light.valid && (light.position - position).lengthSquared() < 1e-8f) // a snapped position may differ by a rounding
+        return false;
+
+    light.valid = true;
+    light.position = position;
+    stats.rebuilds++;
+    return true;
+}
+
+void ShadowMaps::bindCached(int light, int face)
+{
+    ext->BindFramebuffer(GL_FRAMEBUFFER, fbos[0]);
+    ext->FramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, lights[light].cachedMap, 0);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowMaps::bindLive(int light, int face)
+{
+    GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+    ext->BindFramebuffer(GL_READ_FRAMEBUFFER, fbos[0]);
+    ext->FramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, target, lights[light].cachedMap, 0);
+    ext->BindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[1]);
+    ext->FramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, target, lights[light].liveMap, 0);
+    ext->BlitFramebuffer(0, 0, mySize, mySize, 0, 0, mySize, mySize, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    ext->BindFramebuffer(GL_FRAMEBUFFER, fbos[1]);
+
+    if(face == 0)
+        stats.composites++;
+}
+
+void ShadowMaps::bindTextures(int firstUnit, int n)
+{
+    for(int i = 0; i < n; i++) {
+        ext->ActiveTexture(GL_TEXTURE0 + firstUnit + i);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, lights[i].useLive ? lights[i].liveMap : lights[i].cachedMap);
+    }
+    ext->ActiveTexture(GL_TEXTURE0);
+}
+
+void ShadowMaps::report()
+{
+    qCDebug(shadowLog) << "shadows:"
+                       << "cache rebuilds:" << stats.rebuilds << "(one per" << 360 / ORBIT_STEPS << "degrees of the turning light)"
+                       << "composites:" << stats.composites;
+    stats = Stats();
+}
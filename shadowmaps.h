@@ -0,0 +1,102 @@
+#ifndef SHADOWMAPS_H
+#define SHADOWMAPS_H
+
+#include <QVector3D>
+#include <QMatrix4x4>
+
+#include "glextensions.h"
+
+/**
+ * @brief omnidirectional shadows of the main lights, one depth cube map per light
+ *
+ * Each light has two layers: the cached one holds the pieces that don't move and is only redrawn
+ * when it is invalidated (a piece starts or ends a move, the pieces fall) or when the light moves.
+ * A light turning around z is snapped to ORBIT_STEPS steps per turn: its shadows move by steps,
+ * and its cached layer is redrawn once per step instead of every frame.
+ * The live one is a copy of the cached layer with the moving piece drawn over it each frame,
+ * it is only used while something moves, so the shadows usually cost a blit and one piece per face.
+ */
+class ShadowMaps
+{
+public:
+    enum { MAX_LIGHTS = 3, FACES = 6, ORBIT_STEPS = 72 };
+
+    struct Stats {
+        int rebuilds = 0;   // cached layers redrawn
+        int composites = 0; // live layers, copy of the cached one and the moving pieces
+    } stats;
+
+    bool create(GLExtensions* ext, int size = 512, float zNear = 0.05, float zFar = 20);
+    void destroy();
+    bool isCreated() const { return fbos[0] != 0; }
+
+    int size() const { return mySize; }
+    float zNear() const { return myNear; }
+    float zFar() const { return myFar; }
+
+    /**
+     * @brief the pieces that don't move changed, every cached layer has to be redrawn
+     */
+    void invalidate();
+
+    /**
+     * @brief projection * view of the 6 faces of the cube map seen from the light, in the GL face order
+     */
+    void faceMatrices(QVector3D light, QMatrix4x4 faces[FACES]) const;
+
+    /**
+     * @brief the position of a light turning around z, its angle rounded to a step of the orbit
+     */
+    static QVector3D snap(QVector3D position);
+
+    /**
+     * @brief true when the cached layer of the light doesn't match its position or was invalidated,
+     * the caller must then draw the static pieces in every face
+     */
+    bool needsRebuild(int light, QVector3D position);
+
+    /**
+     * @brief where the layers of the light were drawn from, the shaders measure the depth from there
+     */
+    QVector3D origin(int light) const { return lights[light].position; }
+
+    /**
+     * @brief targets a face of the cached layer, cleared
+     */
+    void bindCached(int light, int face);
+
+    /**
+     * @brief copies a face of the cached layer to the live layer and targets it
+     */
+    void bindLive(int light, int face);
+
+    /**
+     * @brief layer sampled by the shaders, the live one only when something was drawn in it this frame
+     */
+    void setLive(int light, bool live) { lights[light].useLive = live; }
+
+    /**
+     * @brief depth cube maps of the n first lights on units firstUnit to firstUnit + n - 1
+     */
+    void bindTextures(int firstUnit, int n);
+
+    /**
+     * @brief rebuilds and composites since the last report, on chess.shadows (debug), counted again from 0
+     */
+    void report();
+
+private:
+    GLExtensions* ext = nullptr;
+    GLuint fbos[2] = {}; // cached, live
+    int mySize = 0;
+    float myNear = 0, myFar = 0;
+
+    struct Light {
+        GLuint cachedMap = 0, liveMap = 0; // depth cube maps
+        QVector3D position; // of the cached layer
+        bool valid = false;
+        bool useLive = false;
+    } lights[MAX_LIGHTS];
+};
+
+#endif // SHADOWMAPS_H
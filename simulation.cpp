@@ -0,0 +1,102 @@
+#include "simulation.h"
+
+#include <cmath>
+
+Simulation::Simulation()
+{
+    timer.start();
+}
+
+Simulation::~Simulation()
+{
+    stop();
+}
+
+void Simulation::wake()
+{
+    QMutexLocker lock(&mutex);
+    woken = true;
+    condition.wakeAll();
+}
+
+void Simulation::stop()
+{
+    {
+        QMutexLocker lock(&mutex);
+        stopping = true;
+        condition.wakeAll();
+    }
+    wait();
+}
+
+void Simulation::post(std::function<void()> edit)
+{
+    // full: the thread is in a long batch of steps, it drains the queue before the next one
+    while(!edits.push(edit)) {
+        if(!isRunning()) {
+            applyEdits(); // not started, or over: nothing else takes them
+            continue;
+        }
+        wake();
+        QThread::yieldCurrentThread();
+    }
+    wake();
+}
+
+void Simulation::applyEdits()
+{
+    std::function<void()> edit;
+    while(edits.pop(edit))
+        edit();
+}
+
+void Simulation::run()
+{
+    const double dt = 1.0 / STEPS_PER_SECOND;
+    double t = 0, due = clock(); // due: wall time of the next step
+
+    for(;;) {
+        double now = clock();
+        for(int n = 0; due <= now && n < MAX_STEPS; n++) {
+            t += dt;
+            applyEdits();
+            step(t, due);
+            due += dt;
+        }
+        if(due <= now)
+            due = now; // a stall, the simulation falls behind rather than replaying it
+
+        applyEdits(); // idle reads them too
+        double sleep = idle(t);
+        bool slept = false;
+
+        QMutexLocker lock(&mutex);
+        if(!woken && !stopping) {
+            if(sleep < 0) {
+                condition.wait(&mutex);
+                slept = true;
+            } else if(sleep >= dt) {
+                condition.wait(&mutex, (unsigned long) std::ceil(sleep * 1000));
+                slept = true;
+            } else {
+                double wait = due - clock();
+                if(wait > 0)
+                    condition.wait(&mutex, (unsigned long) std::ceil(wait * 1000));
+            }
+        }
+        woken = false;
+        if(stopping)
+            return;
+        lock.unlock();
+
+        if(slept) {
+            // nothing changed while asleep: the time jumps to now
+            now = clock();
+            if(now > due) {
+                t += now - due;
+                due = now;
+            }
+            emit resumed();
+        }
+    }
+}
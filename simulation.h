@@ -0,0 +1,72 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+
+#include <functional>
+
+#include "spscqueue.h"
+
+/**
+ * @brief a thread that calls step at a fixed rate on a monotonic clock, and sleeps while there is nothing to step
+ *
+ * The time of the steps goes on with the clock; behind by more than MAX_STEPS (a stall), the steps are not all
+ * replayed and the simulation falls behind instead. After each batch of steps, idle tells how long nothing will change:
+ * the thread sleeps until then or until wake, and the time jumps over the sleep.
+ * What step reads belongs to the thread: the other threads change it through post, applied before the next step.
+ */
+class Simulation : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum { STEPS_PER_SECOND = 120, MAX_STEPS = 12 };
+    enum { MAX_EDITS = 256 }; // posted and not applied yet, past it the poster waits for the thread
+
+    Simulation();
+    ~Simulation(); // stops
+
+    // set before start, called on the thread
+    std::function<void(double t, double wall)> step; // t: time of the simulation, wall: of the clock when the step was due, in s
+    std::function<double(double t)> idle; // s without any change from t, 0 while it moves, < 0 until a wake
+
+    /**
+     * @brief any thread: steps again now if it sleeps
+     */
+    void wake();
+    void stop();
+
+    /**
+     * @brief one thread at a time: runs the edit on the thread, before the next step, in the order of the posts
+     */
+    void post(std::function<void()> edit);
+
+    /**
+     * @brief the edits posted so far, on the thread or before start
+     */
+    void applyEdits();
+
+    /**
+     * @brief any thread, s since the start, on the clock of the wall times
+     */
+    double clock() const { return timer.nsecsElapsed() / 1e9; }
+
+signals:
+    void resumed(); // the steps start again after a sleep
+    void over(); // the steps can't go on (the game is drawn), for the gui thread
+
+protected:
+    void run() override;
+
+private:
+    QElapsedTimer timer;
+    QMutex mutex;
+    QWaitCondition condition;
+    bool woken = false, stopping = false; // under the mutex
+    SpscQueue<std::function<void()>, MAX_EDITS> edits;
+};
+
+#endif // SIMULATION_H
@@ -0,0 +1,533 @@
+#include "softrasterizer.h"
+
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QThread>
+#include <QtConcurrent>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "utils.h"
+
+using std::min;
+using std::max;
+
+SoftRasterizer::SoftRasterizer()
+{
+    setThreads(0);
+}
+
+void SoftRasterizer::setThreads(int n)
+{
+    threadCount = n > 0 ? n : max(1, QThread::idealThreadCount());
+    pool.setMaxThreadCount(threadCount);
+}
+
+void SoftRasterizer::setCubeMap(const QVector<QImage>& faces)
+{
+    cubeMap.clear();
+    for(const QImage& face : faces)
+        cubeMap.append(face.convertToFormat(QImage::Format_RGBA8888));
+}
+
+void SoftRasterizer::setNormalMap(const QImage& image)
+{
+    normalMap = image.convertToFormat(QImage::Format_RGBA8888);
+}
+
+void SoftRasterizer::parallel(int count, std::function<void(int)> job)
+{
+    // as many workers as threads, each takes the next job until there is none left
+    QAtomicInt next(0);
+    int workers = min(threadCount, count);
+    QVector<QFuture<void>> running(workers);
+    for(int w = 0; w < workers; w++)
+        running[w] = QtConcurrent::run(&pool, [&next, count, &job]() {
+            for(int i = next.fetchAndAddRelaxed(1); i < count; i = next.fetchAndAddRelaxed(1))
+                job(i);
+        });
+    for(QFuture<void>& worker : running)
+        worker.waitForFinished();
+}
+
+void SoftRasterizer::begin(int width, int height, const Settings& settings)
+{
+    this->width = width;
+    this->height = height;
+    this->settings = settings;
+    inverseSky = settings.sky.inverted();
+    draws.clear();
+}
+
+void SoftRasterizer::drawMesh(const OBJObject* obj, const QMatrix4x4& model, int color)
+{
+    draws.append({obj, model, color});
+}
+
+void SoftRasterizer::drawSquare(const QMatrix4x4& model, int color)
+{
+    draws.append({nullptr, model, color});
+}
+
+const QImage& SoftRasterizer::end()
+{
+    if(width <= 0 || height <= 0)
+        return frame;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // vertices of each draw on its own thread, then the tiles of each triangle in the order of the draws
+    triangles.resize(draws.size());
+    parallel(draws.size(), [this](int draw) {
+        setup(draw);
+    });
+
+    tilesX = (width + TILE - 1) / TILE;
+    tilesY = (height + TILE - 1) / TILE;
+    bins.resize(tilesX * tilesY);
+    for(QVector<const Triangle*>& bin : bins)
+        bin.clear();
+
+    stats.triangles = stats.binned = 0;
+    for(const QVector<Triangle>& list : triangles) {
+        for(const Triangle& t : list) {
+            for(int ty = t.y0 / TILE; ty <= (t.y1 - 1) / TILE; ty++)
+                for(int tx = t.x0 / TILE; tx <= (t.x1 - 1) / TILE; tx++)
+                    bins[ty * tilesX + tx].append(&t);
+            stats.binned += ((t.y1 - 1) / TILE - t.y0 / TILE + 1) * ((t.x1 - 1) / TILE - t.x0 / TILE + 1);
+        }
+        stats.triangles += list.size();
+    }
+    stats.setupNs = timer.nsecsElapsed();
+
+    if(frame.width() != width || frame.height() != height)
+        frame = QImage(width, height, QImage::Format_RGB32);
+    pixels = frame.bits(); // detached here, not by the workers
+    bytesPerLine = frame.bytesPerLine();
+
+    timer.restart();
+    parallel(tilesX * tilesY, [this](int tile) {
+        rasterTile(tile);
+    });
+    stats.rasterNs = timer.nsecsElapsed();
+
+    return frame;
+}
+
+void SoftRasterizer::setup(int d)
+{
+    const Draw& draw = draws[d];
+    QVector<Triangle>& out = triangles[d];
+    out.clear();
+
+    // what chess.vert and board.vert compute
+    const QMatrix4x4 matrix = settings.pv * draw.model;
+    const QMatrix3x3 normalMatrix = draw.model.normalMatrix();
+    const float* n = normalMatrix.constData(); // column major
+
+    auto vertex = [&](QVector3D position, QVector3D normal, QVector2D texCoord) {
+        Vertex v;
+        v.clip = matrix * QVector4D(position, 1);
+        QVector4D world = draw.model * QVector4D(position, 1);
+        float* a = v.attributes;
+        a[0] = world.x(); a[1] = world.y(); a[2] = world.z();
+        a[3] = n[0] * normal.x() + n[3] * normal.y() + n[6] * normal.z();
+        a[4] = n[1] * normal.x() + n[4] * normal.y() + n[7] * normal.z();
+        a[5] = n[2] * normal.x() + n[5] * normal.y() + n[8] * normal.z();
+        a[6] = texCoord.x(); a[7] = texCoord.y();
+        return v;
+    };
+
+    if(!draw.obj) {
+        Vertex v[4];
+        const QVector2D corners[4] = {{-0.5, -0.5}, {0.5, -0.5}, {0.5, 0.5}, {-0.5, 0.5}};
+        for(int i = 0; i < 4; i++)
+            v[i] = vertex(QVector3D(corners[i], 0), {0, 0, 1}, corners[i]);
+        addTriangle(out, v[0], v[1], v[2], BOARD, draw.color);
+        addTriangle(out, v[0], v[2], v[3], BOARD, draw.color);
+        return;
+    }
+
+    const OBJObject* obj = draw.obj;
+    QVector<Vertex> vertices(obj->vertices.size());
+    for(int i = 0; i < vertices.size(); i++)
+        vertices[i] = vertex(obj->vertices[i], i < obj->normals.size() ? obj->normals[i] : QVector3D(0, 0, 1), QVector2D());
+
+    out.reserve(obj->triangles.size() / 3 + obj->quads.size() / 2);
+    for(int i = 0; i + 2 < obj->triangles.size(); i += 3)
+        addTriangle(out, vertices[obj->triangles[i]], vertices[obj->triangles[i+1]], vertices[obj->triangles[i+2]], PIECE, draw.color);
+    for(int i = 0; i + 3 < obj->quads.size(); i += 4) {
+        const Vertex& a = vertices[obj->quads[i]];
+        addTriangle(out, a, vertices[obj->quads[i+1]], vertices[obj->quads[i+2]], PIECE, draw.color);
+        addTriangle(out, a, vertices[obj->quads[i+2]], vertices[obj->quads[i+3]], PIECE, draw.color);
+    }
+}
+
+void SoftRasterizer::addTriangle(QVector<Triangle>& out, const Vertex& a, const Vertex& b, const Vertex& c, int material, int color) const
+{
+    // clipped by the near plane z = -w, one triangle gives a polygon of at most 4 vertices
+    const Vertex* in[3] = {&a, &b, &c};
+    Vertex polygon[4];
+    int n = 0;
+    for(int i = 0; i < 3; i++) {
+        const Vertex& p = *in[i];
+        const Vertex& q = *in[(i + 1) % 3];
+        float dp = p.clip.z() + p.clip.w(), dq = q.clip.z() + q.clip.w();
+        if(dp >= 0)
+            polygon[n++] = p;
+        if((dp >= 0) != (dq >= 0)) {
+            float t = dp / (dp - dq);
+            Vertex& v = polygon[n++];
+            v.clip = p.clip + t * (q.clip - p.clip);
+            for(int k = 0; k < ATTRIBUTES; k++)
+                v.attributes[k] = p.attributes[k] + t * (q.attributes[k] - p.attributes[k]);
+        }
+    }
+
+    for(int i = 1; i + 1 < n; i++) {
+        const Vertex* v[3] = {&polygon[0], &polygon[i], &polygon[i + 1]};
+        Triangle t;
+        float x[3], y[3], z[3];
+        bool behind = false;
+        for(int k = 0; k < 3; k++) {
+            float w = v[k]->clip.w();
+            behind |= w <= 0;
+            float invW = 1 / w;
+            // pixels from the top left, depth in [0,1] like the default glDepthRange
+            x[k] = (v[k]->clip.x() * invW * 0.5f + 0.5f) * width;
+            y[k] = (0.5f - v[k]->clip.y() * invW * 0.5f) * height;
+            z[k] = v[k]->clip.z() * invW * 0.5f + 0.5f;
+            t.invW[k] = invW;
+            for(int j = 0; j < ATTRIBUTES; j++)
+                t.attributes[k][j] = v[k]->attributes[j] * invW;
+        }
+        if(behind)
+            continue;
+
+        // edge of the two other vertices, the weight of vertex k is edges[k] . (x, y, 1)
+        auto edge = [&x, &y](int a, int b, float* e) {
+            e[0] = -(y[b] - y[a]);
+            e[1] = x[b] - x[a];
+            e[2] = (y[b] - y[a]) * x[a] - (x[b] - x[a]) * y[a];
+        };
+        edge(1, 2, t.edges[0]);
+        edge(2, 0, t.edges[1]);
+        edge(0, 1, t.edges[2]);
+
+        float area = t.edges[2][0] * x[2] + t.edges[2][1] * y[2] + t.edges[2][2];
+        if(area == 0)
+            continue;
+        // no culling, like the GL path, both windings are inside on the positive side
+        float sign = area > 0 ? 1 : -1;
+        for(auto& e : t.edges)
+            for(float& f : e)
+                f *= sign;
+        t.invArea = 1 / std::abs(area);
+
+        for(int j = 0; j < 3; j++)
+            t.depth[j] = t.invArea * (z[0] * t.edges[0][j] + z[1] * t.edges[1][j] + z[2] * t.edges[2][j]);
+
+        // pixels whose center may be inside
+        float minX = max(0.f, min({x[0], x[1], x[2]})), maxX = min((float) width, max({x[0], x[1], x[2]}));
+        float minY = max(0.f, min({y[0], y[1], y[2]})), maxY = min((float) height, max({y[0], y[1], y[2]}));
+        t.x0 = (int) std::ceil(minX - 0.5f);
+        t.x1 = (int) std::floor(maxX - 0.5f) + 1;
+        t.y0 = (int) std::ceil(minY - 0.5f);
+        t.y1 = (int) std::floor(maxY - 0.5f) + 1;
+        t.x1 = min(t.x1, width);
+        t.y1 = min(t.y1, height);
+        if(t.x0 >= t.x1 || t.y0 >= t.y1)
+            continue;
+
+        t.material = material;
+        t.color = color;
+        out.append(t);
+    }
+}
+
+void SoftRasterizer::rasterTile(int tile)
+{
+    const int left = tile % tilesX * TILE, top = tile / tilesX * TILE;
+    const int w = min((int) TILE, width - left), h = min((int) TILE, height - top);
+    const QVector<const Triangle*>& bin = bins[tile];
+
+    // nearest triangle of each pixel, in the bin, and its weights
+    float depth[TILE * TILE];
+    int ids[TILE * TILE];
+    float weights1[TILE * TILE], weights2[TILE * TILE];
+    std::fill(depth, depth + TILE * TILE, 1.f);
+    std::fill(ids, ids + TILE * TILE, -1);
+
+    for(int k = 0; k < bin.size(); k++) {
+        const Triangle& t = *bin[k];
+        const int x0 = max(t.x0, left) - left, x1 = min(t.x1, left + w) - left;
+        const int y0 = max(t.y0, top) - top, y1 = min(t.y1, top + h) - top;
+        const int n = x1 - x0;
+        if(n <= 0)
+            continue;
+
+        const float a0 = t.edges[0][0], a1 = t.edges[1][0], a2 = t.edges[2][0], az = t.depth[0];
+        for(int y = y0; y < y1; y++) {
+            // at the center of the first pixel of the span, stepped along x by the loop
+            const float px = left + x0 + 0.5f, py = top + y + 0.5f;
+            const float e0 = t.edges[0][0] * px + t.edges[0][1] * py + t.edges[0][2];
+            const float e1 = t.edges[1][0] * px + t.edges[1][1] * py + t.edges[1][2];
+            const float e2 = t.edges[2][0] * px + t.edges[2][1] * py + t.edges[2][2];
+            const float ez = t.depth[0] * px + t.depth[1] * py + t.depth[2];
+
+            float* d = depth + y * TILE + x0;
+            int* id = ids + y * TILE + x0;
+            float* l1 = weights1 + y * TILE + x0;
+            float* l2 = weights2 + y * TILE + x0;
+
+            int i = 0;
+#ifdef __SSE2__
+            // 4 pixels at a time, the masked ones keep their values; a group outside the triangle writes nothing
+            const __m128 zero = _mm_setzero_ps(), lanes = _mm_setr_ps(0, 1, 2, 3);
+            const __m128 ve0 = _mm_set1_ps(e0), ve1 = _mm_set1_ps(e1), ve2 = _mm_set1_ps(e2), vez = _mm_set1_ps(ez);
+            const __m128 va0 = _mm_set1_ps(a0), va1 = _mm_set1_ps(a1), va2 = _mm_set1_ps(a2), vaz = _mm_set1_ps(az);
+            const __m128i vk = _mm_set1_epi32(k);
+            for(; i + 4 <= n; i += 4) {
+                const __m128 f = _mm_add_ps(_mm_set1_ps((float) i), lanes);
+                const __m128 w0 = _mm_add_ps(ve0, _mm_mul_ps(va0, f));
+                const __m128 w1 = _mm_add_ps(ve1, _mm_mul_ps(va1, f));
+                const __m128 w2 = _mm_add_ps(ve2, _mm_mul_ps(va2, f));
+                const __m128 z = _mm_add_ps(vez, _mm_mul_ps(vaz, f));
+                const __m128 dd = _mm_loadu_ps(d + i);
+                const __m128 inside = _mm_and_ps(
+                    _mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)),
+                    _mm_and_ps(_mm_cmpge_ps(w2, zero), _mm_cmplt_ps(z, dd)));
+                if(!_mm_movemask_ps(inside))
+                    continue;
+
+                auto blend = [inside](__m128 a, __m128 b) { // inside ? a : b
+                    return _mm_or_ps(_mm_and_ps(inside, a), _mm_andnot_ps(inside, b));
+                };
+                _mm_storeu_ps(d + i, blend(z, dd));
+                _mm_storeu_ps(l1 + i, blend(w1, _mm_loadu_ps(l1 + i)));
+                _mm_storeu_ps(l2 + i, blend(w2, _mm_loadu_ps(l2 + i)));
+                const __m128i mask = _mm_castps_si128(inside);
+                const __m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(id + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(id + i),
+                                 _mm_or_si128(_mm_and_si128(mask, vk), _mm_andnot_si128(mask, old)));
+            }
+#endif
+            // the rest of the span, or all of it without SSE2
+            for(; i < n; i++) {
+                const float f = i;
+                const float w0 = e0 + a0 * f, w1 = e1 + a1 * f, w2 = e2 + a2 * f, z = ez + az * f;
+                const bool inside = (w0 >= 0) & (w1 >= 0) & (w2 >= 0) & (z < d[i]);
+                d[i] = inside ? z : d[i];
+                id[i] = inside ? k : id[i];
+                l1[i] = inside ? w1 : l1[i];
+                l2[i] = inside ? w2 : l2[i];
+            }
+        }
+    }
+
+    // every pixel shaded once, rgba8 like the GL target
+    auto unorm = [](float c) {
+        return (int) (clamp(c, 0.f, 1.f) * 255 + 0.5f);
+    };
+    for(int y = 0; y < h; y++) {
+        QRgb* row = reinterpret_cast<QRgb*>(pixels + (top + y) * bytesPerLine) + left;
+        for(int x = 0; x < w; x++) {
+            int i = y * TILE + x;
+            QVector3D c = ids[i] < 0
+                    ? sky(left + x + 0.5f, top + y + 0.5f)
+                    : shade(*bin[ids[i]], weights1[i], weights2[i]);
+            row[x] = qRgb(unorm(c.x()), unorm(c.y()), unorm(c.z()));
+        }
+    }
+}
+
+QVector3D SoftRasterizer::shade(const Triangle& t, float w1, float w2) const
+{
+    // perspective correct attributes
+    float l1 = w1 * t.invArea, l2 = w2 * t.invArea, l0 = 1 - l1 - l2;
+    float invW = l0 * t.invW[0] + l1 * t.invW[1] + l2 * t.invW[2];
+    float a[ATTRIBUTES];
+    for(int k = 0; k < ATTRIBUTES; k++)
+        a[k] = (l0 * t.attributes[0][k] + l1 * t.attributes[1][k] + l2 * t.attributes[2][k]) / invW;
+
+    QVector3D position(a[0], a[1], a[2]);
+    if(t.material == PIECE)
+        return shadePiece(position, QVector3D(a[3], a[4], a[5]), t.color);
+    return shadeBoard(position, QVector2D(a[6], a[7]), t.color);
+}
+
+QVector3D SoftRasterizer::shadePiece(QVector3D position, QVector3D normal, int color) const
+{
+    // chess.frag, the first light only, white
+    const float Pi = M_PI;
+    const float ambiant = 0.1;
+
+    QVector3D N = normal.normalized();
+    QVector3D light = settings.lights.isEmpty() ? QVector3D() : settings.lights[0].position;
+    QVector3D L = (light - position).normalized();
+    float diffuse = max(0.f, QVector3D::dotProduct(L, N));
+
+    QVector3D V = (settings.camera - position).normalized();
+    QVector3D R = (2 * QVector3D::dotProduct(L, N) * N - L).normalized();
+    QVector3D H = (V + L).normalized();
+
+    float specular;
+    if(settings.lightingModel == 0) {
+        specular = std::pow(max(0.f, QVector3D::dotProduct(R, V)), settings.shininess);
+    } else if(settings.lightingModel == 1) {
+        specular = std::pow(max(0.f, QVector3D::dotProduct(N, H)), settings.shininess);
+    } else {
+        float VN = QVector3D::dotProduct(V, N);
+        float NL = QVector3D::dotProduct(N, L);
+        float F = std::pow(1 + VN, settings.cookLambda);
+        float NH = QVector3D::dotProduct(N, H);
+        float NH2 = NH * NH;
+        float m2 = settings.cookRoughness * settings.cookRoughness;
+        float x = (1 - NH2) / (NH2 * m2);
+        float D = std::exp(-x) / (Pi * m2 * NH2);
+        float VH = QVector3D::dotProduct(V, H);
+        float G = min(1.f, min(2 * NH * VN / VH, 2 * NH * NL / VH));
+        specular = D * F * G / (4 * VN * NL);
+    }
+
+    QVector3D myColor = color == 0 ? QVector3D(1, 0.5, 0) : QVector3D(0, 0.5, 1);
+    return (ambiant + diffuse + specular) * myColor;
+}
+
+QVector3D SoftRasterizer::shadeBoard(QVector3D position, QVector2D texCoord, int color) const
+{
+    // board.frag, every light, and the cubemap reflected and refracted
+    QVector3D N(0, 0, 1);
+    if(!normalMap.isNull())
+        N = (2 * sample(normalMap, texCoord.x() + 0.5f, texCoord.y() + 0.5f, true) - QVector3D(1, 1, 1)).normalized();
+
+    const QVector3D ambiant(0.2, 0.2, 0.2);
+    QVector3D V = (settings.camera - position).normalized();
+
+    QVector3D diffuse, specular;
+    for(const Light& light : settings.lights) {
+        QVector3D L = (light.position - position).normalized();
+        QVector3D R = (2 * QVector3D::dotProduct(L, N) * N - L).normalized();
+        diffuse += max(0.f, QVector3D::dotProduct(L, N)) * light.color;
+        specular += std::pow(max(0.f, QVector3D::dotProduct(R, V)), settings.boardShininess) * light.color;
+    }
+
+    QVector3D myColor = color == 0 ? QVector3D(0.29, 0.15, 0) : QVector3D(0.8, 0.8, 0.8);
+
+    QVector3D environment;
+    QVector3D I = -V;
+    float NI = QVector3D::dotProduct(N, I);
+    if(settings.reflectFactor > 0)
+        environment += settings.reflectFactor * sampleCube(cubeMap, I - 2 * NI * N);
+    if(settings.refractFactor > 0) {
+        float eta = settings.refractIndice;
+        float k = 1 - eta * eta * (1 - NI * NI);
+        if(k >= 0)
+            environment += settings.refractFactor * sampleCube(cubeMap, eta * I - (eta * NI + std::sqrt(k)) * N);
+    }
+
+    return (ambiant + diffuse + specular) * myColor + environment;
+}
+
+QVector3D SoftRasterizer::sky(float x, float y) const
+{
+    // direction of the pixel, cubemap.vert puts the cube at the far plane around the eye
+    QVector3D ndc(2 * x / width - 1, 1 - 2 * y / height, 0);
+    return sampleCube(cubeMap, inverseSky.map(ndc));
+}
+
+QVector3D SoftRasterizer::sampleCube(const QVector<QImage>& faces, QVector3D d)
+{
+    if(faces.size() != 6)
+        return QVector3D();
+
+    // face selection of the GL specification
+    float ax = std::abs(d.x()), ay = std::abs(d.y()), az = std::abs(d.z());
+    int face;
+    float ma, sc, tc;
+    if(ax >= ay && ax >= az) {
+        face = d.x() > 0 ? 0 : 1;
+        ma = ax;
+        sc = d.x() > 0 ? -d.z() : d.z();
+        tc = -d.y();
+    } else if(ay >= az) {
+        face = d.y() > 0 ? 2 : 3;
+        ma = ay;
+        sc = d.x();
+        tc = d.y() > 0 ? d.z() : -d.z();
+    } else {
+        face = d.z() > 0 ? 4 : 5;
+        ma = az;
+        sc = d.z() > 0 ? d.x() : -d.x();
+        tc = -d.y();
+    }
+    if(ma == 0)
+        return QVector3D();
+
+    return sample(faces[face], (sc / ma + 1) / 2, (tc / ma + 1) / 2, false);
+}
+
+QVector3D SoftRasterizer::sample(const QImage& image, float s, float t, bool repeat)
+{
+    // bilinear, rgba8888, t goes along the rows as they are stored
+    const int w = image.width(), h = image.height();
+    float fx = s * w - 0.5f, fy = t * h - 0.5f;
+    float x0 = std::floor(fx), y0 = std::floor(fy);
+    float u = fx - x0, v = fy - y0;
+
+    auto wrap = [repeat](int i, int size) {
+        return repeat ? ((i % size) + size) % size : clamp(i, 0, size - 1);
+    };
+    int xs[2] = {wrap((int) x0, w), wrap((int) x0 + 1, w)};
+    int ys[2] = {wrap((int) y0, h), wrap((int) y0 + 1, h)};
+
+    QVector3D c[2][2];
+    for(int j = 0; j < 2; j++) {
+        const uchar* row = image.constScanLine(ys[j]);
+        for(int i = 0; i < 2; i++) {
+            const uchar* p = row + 4 * xs[i];
+            c[j][i] = QVector3D(p[0], p[1], p[2]);
+        }
+    }
+    QVector3D top = c[0][0] + u * (c[0][1] - c[0][0]);
+    QVector3D bottom = c[1][0] + u * (c[1][1] - c[1][0]);
+    return (top + v * (bottom - top)) / 255;
+}
+
+SoftRasterizer::Difference SoftRasterizer::compare(const QImage& a, const QImage& b, int tolerance)
+{
+    Difference d;
+    if(a.size() != b.size() || a.isNull()) {
+        d.mean = d.max = 255;
+        d.over = 1;
+        return d;
+    }
+
+    QImage x = a.convertToFormat(QImage::Format_RGB32), y = b.convertToFormat(QImage::Format_RGB32);
+    qint64 sum = 0, over = 0;
+    for(int j = 0; j < x.height(); j++) {
+        const QRgb* p = reinterpret_cast<const QRgb*>(x.constScanLine(j));
+        const QRgb* q = reinterpret_cast<const QRgb*>(y.constScanLine(j));
+        for(int i = 0; i < x.width(); i++) {
+            int dr = std::abs(qRed(p[i]) - qRed(q[i]));
+            int dg = std::abs(qGreen(p[i]) - qGreen(q[i]));
+            int db = std::abs(qBlue(p[i]) - qBlue(q[i]));
+            int m = max(dr, max(dg, db));
+            sum += dr + dg + db;
+            d.max = max(d.max, m);
+            over += m > tolerance;
+        }
+    }
+
+    double pixels = (double) x.width() * x.height();
+    d.mean = sum / (3 * pixels);
+    d.over = over / pixels;
+    return d;
+}
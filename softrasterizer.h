@@ -0,0 +1,160 @@
+#ifndef SOFTRASTERIZER_H
+#define SOFTRASTERIZER_H
+
+#include <QVector>
+#include <QVector2D>
+#include <QVector3D>
+#include <QMatrix4x4>
+#include <QImage>
+#include <QThreadPool>
+
+#include <functional>
+
+#include "objloader.h"
+
+/**
+ * @brief the board, the pieces and the cubemap drawn on the cpu, for the machines without a usable GL
+ *
+ * The triangles of the frame are transformed and clipped to the near plane, one job per draw, then binned
+ * in TILE x TILE tiles of the screen and the tiles are rasterized by the threads of a pool of its own.
+ * A tile is walked one row at a time: the edge functions and the depth test run on 4 pixels at a time with SSE2
+ * (a plain loop elsewhere), each pixel keeps its nearest triangle and barycentrics, and is shaded once at the end
+ * like chess.frag and board.frag do in the forward path, without the shadows, the planar reflection nor the clusters.
+ * The pixels no triangle covers get the cubemap.
+ */
+class SoftRasterizer
+{
+public:
+    enum { TILE = 32 };
+    enum Material { PIECE, BOARD };
+
+    struct Light {
+        QVector3D position, color;
+    };
+
+    // the uniforms of the shaders
+    struct Settings {
+        QMatrix4x4 pv, sky; // sky: the view without its translation, see Scene::Frame
+        QVector3D camera;
+        QVector<Light> lights; // the first one lights the pieces, all of them the board
+        int lightingModel = 0; // PHONG BLINN-PHONG COOK
+        float shininess = 32, boardShininess = 32;
+        float cookLambda = 0.4, cookRoughness = 0.2;
+        float reflectFactor = 0.2, refractFactor = 0.1, refractIndice = 0.2;
+    };
+
+    struct Stats {
+        int triangles = 0; // after the clipping
+        int binned = 0;    // references to the triangles in all the tiles
+        qint64 setupNs = 0, rasterNs = 0; // last frame
+    } stats;
+
+    SoftRasterizer();
+
+    /**
+     * @brief threads of the pool, 0 is QThread::idealThreadCount()
+     */
+    void setThreads(int n);
+    int threads() const { return threadCount; }
+
+    /**
+     * @brief +X -X +Y -Y +Z -Z, rows in the order of the GL upload (see Scene::cubeMapFace)
+     */
+    void setCubeMap(const QVector<QImage>& faces);
+    bool hasCubeMap() const { return cubeMap.size() == 6; }
+
+    /**
+     * @brief normals of the squares of the board, repeated
+     */
+    void setNormalMap(const QImage& image);
+
+    void begin(int width, int height, const Settings& settings);
+
+    /**
+     * @brief the triangles and the quads of the object, color 0 is white
+     */
+    void drawMesh(const OBJObject* obj, const QMatrix4x4& model, int color);
+
+    /**
+     * @brief a square of the board, [-0.5, 0.5] in x and y before the model, color 0 is dark
+     */
+    void drawSquare(const QMatrix4x4& model, int color);
+
+    /**
+     * @brief rasterizes and shades what was drawn since begin
+     */
+    const QImage& end();
+    const QImage& image() const { return frame; }
+
+    struct Difference {
+        double mean = 0; // per channel, 0 to 255
+        int max = 0;
+        double over = 0; // part of the pixels with a channel over the tolerance, [0,1]
+    };
+
+    /**
+     * @brief per pixel difference of two images of the same size, each pixel differs when the sizes don't match
+     */
+    static Difference compare(const QImage& a, const QImage& b, int tolerance = 8);
+
+    /**
+     * @brief bilinear like the GL samplers, rgba8888 images, t goes along the rows as they are stored
+     */
+    static QVector3D sample(const QImage& image, float s, float t, bool repeat);
+    static QVector3D sampleCube(const QVector<QImage>& faces, QVector3D direction);
+
+private:
+    enum { ATTRIBUTES = 8 }; // world position, normal, texCoord
+
+    struct Vertex {
+        QVector4D clip;
+        float attributes[ATTRIBUTES];
+    };
+
+    struct Draw {
+        const OBJObject* obj; // nullptr for a square
+        QMatrix4x4 model;
+        int color;
+    };
+
+    // in screen space, ready for the tiles
+    struct Triangle {
+        float edges[3][3];   // a x + b y + c, >= 0 inside, for the weights of the vertices 0, 1, 2
+        float depth[3];      // plane of the depth in [0,1], same form
+        float invArea;
+        float invW[3];
+        float attributes[3][ATTRIBUTES]; // divided by w
+        int x0, y0, x1, y1;  // pixels of the bounding box, x1 and y1 excluded
+        int material, color;
+    };
+
+    Settings settings;
+    int width = 0, height = 0;
+    int tilesX = 0, tilesY = 0;
+    QImage frame;
+    uchar* pixels = nullptr; // of frame, each tile writes its own rectangle
+    int bytesPerLine = 0;
+    QVector<QImage> cubeMap;
+    QImage normalMap;
+    QMatrix4x4 inverseSky;
+
+    QVector<Draw> draws;
+    QVector<QVector<Triangle>> triangles; // [draws]
+    QVector<QVector<const Triangle*>> bins; // [tiles], in the order of the draws
+
+    QThreadPool pool;
+    int threadCount = 1;
+
+    void parallel(int count, std::function<void(int)> job);
+
+    void setup(int draw);
+    void addTriangle(QVector<Triangle>& out, const Vertex& a, const Vertex& b, const Vertex& c, int material, int color) const;
+    void rasterTile(int tile);
+
+    QVector3D shade(const Triangle& t, float l1, float l2) const;
+    QVector3D shadePiece(QVector3D position, QVector3D N, int color) const;
+    QVector3D shadeBoard(QVector3D position, QVector2D texCoord, int color) const;
+    QVector3D sky(float x, float y) const;
+};
+
+#endif // SOFTRASTERIZER_H
@@ -0,0 +1,44 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <QAtomicInt>
+
+/**
+ * @brief a ring of N - 1 values from one producer thread to one consumer thread, without a lock on either side
+ *
+ * Each side owns one index and only reads the other one: the producer writes the value then releases the tail,
+ * the consumer acquires it, takes the value then releases the head. Unlike TripleBuffer nothing is skipped,
+ * the values come out in the order they went in; a full ring refuses the value and the producer decides what to do.
+ */
+template <typename T, int N>
+class SpscQueue
+{
+public:
+    // producer, false when full
+    bool push(const T& value) {
+        int t = tail.load();
+        int next = (t + 1) % N;
+        if(next == head.loadAcquire())
+            return false;
+        values[t] = value;
+        tail.storeRelease(next);
+        return true;
+    }
+
+    // consumer, false when empty
+    bool pop(T& value) {
+        int h = head.load();
+        if(h == tail.loadAcquire())
+            return false;
+        value = values[h];
+        values[h] = T(); // releases what the value holds now, not when the ring comes back to it
+        head.storeRelease((h + 1) % N);
+        return true;
+    }
+
+private:
+    T values[N];
+    QAtomicInt head {0}, tail {0};
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,139 @@
+#include "streambuffer.h"
+
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QLoggingCategory>
+
+#include <algorithm>
+#include <cstring>
+
+Q_LOGGING_CATEGORY(streamLog, "chess.stream", QtInfoMsg)
+
+bool StreamBuffer::create(GLExtensions* ext, GLenum target, int regionSize, int regions)
+{
+    destroy();
+
+    this->ext = ext;
+    this->target = target;
+
+    if(!ext->uniformBufferObject)
+        return false;
+
+    size = regionSize;
+    current = 0;
+    cursor = 0;
+
+    ext->GenBuffers(1, &buffer);
+    ext->BindBuffer(target, buffer);
+
+    if(ext->bufferStorage) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        ext->BufferStorage(target, size * regions, nullptr, flags);
+        mapped = (char*) ext->MapBufferRange(target, 0, size * regions, flags);
+        if(mapped) {
+            myMode = PERSISTENT;
+            fences.fill(nullptr, regions);
+        } else {
+            // storage is immutable, a new buffer is needed to fall back
+            ext->BindBuffer(target, 0);
+            ext->DeleteBuffers(1, &buffer);
+            ext->GenBuffers(1, &buffer);
+            ext->BindBuffer(target, buffer);
+        }
+    }
+
+    if(!mapped) {
+        myMode = ORPHANING;
+        ext->BufferData(target, size, nullptr, GL_STREAM_DRAW);
+    }
+
+    ext->BindBuffer(target, 0);
+
+    qDebug() << "stream buffer:" << (myMode == PERSISTENT ? "persistent mapping" : "orphaning")
+             << "regions:" << (myMode == PERSISTENT ? regions : 1) << "size:" << size;
+    return true;
+}
+
+void StreamBuffer::destroy()
+{
+    if(!buffer)
+        return;
+
+    for(GLsync& fence : fences)
+        if(fence)
+            ext->DeleteSync(fence);
+    fences.clear();
+
+    ext->BindBuffer(target, buffer);
+    if(mapped)
+        ext->UnmapBuffer(target);
+    ext->BindBuffer(target, 0);
+    ext->DeleteBuffers(1, &buffer);
+
+    mapped = nullptr;
+    buffer = 0;
+    myMode = NONE;
+}
+
+void StreamBuffer::beginFrame()
+{
+    cursor = 0;
+
+    if(myMode == PERSISTENT) {
+        current = (current + 1) % fences.size();
+        GLsync& fence = fences[current];
+        if(fence) {
+            // the gpu may still read what was written here regions.size() frames ago
+            GLenum status = ext->ClientWaitSync(fence, 0, 0);
+            if(status == GL_TIMEOUT_EXPIRED) {
+                QElapsedTimer timer;
+                timer.start();
+                while(status == GL_TIMEOUT_EXPIRED)
+                    status = ext->ClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+                stats.waits++;
+                stats.waitNs += timer.nsecsElapsed();
+            }
+            ext->DeleteSync(fence);
+            fence = nullptr;
+        }
+    } else if(myMode == ORPHANING) {
+        // the driver gives a fresh storage, the old one lives until the gpu is done with it
+        ext->BindBuffer(target, buffer);
+        ext->BufferData(target, size, nullptr, GL_STREAM_DRAW);
+        ext->BindBuffer(target, 0);
+    }
+}
+
+int StreamBuffer::upload(const void* data, int bytes, int alignment)
+{
+    int offset = (cursor + alignment - 1) / alignment * alignment;
+    if(myMode == NONE || offset + bytes > size)
+        return -1;
+    cursor = offset + bytes;
+    stats.bytes += bytes;
+
+    if(myMode == PERSISTENT) {
+        offset += current * size;
+        std::memcpy(mapped + offset, data, bytes); // coherent, nothing to flush
+    } else {
+        ext->BindBuffer(target, buffer);
+        ext->BufferSubData(target, offset, bytes, data);
+        ext->BindBuffer(target, 0);
+    }
+    return offset;
+}
+
+void StreamBuffer::endFrame()
+{
+    if(myMode == PERSISTENT)
+        fences[current] = ext->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stats.frames++;
+}
+
+void StreamBuffer::report()
+{
+    qCDebug(streamLog) << "stream buffer:" << stats.frames << "frames,"
+                       << stats.bytes / std::max<qint64>(1, stats.frames) << "bytes per frame,"
+                       << "waits:" << stats.waits << "(" << stats.waitNs / 1000000 << "ms )";
+    stats = Stats();
+}
@@ -0,0 +1,63 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <QVector>
+#include <QByteArray>
+
+#include "glextensions.h"
+
+/**
+ * @brief buffer for the data rewritten every frame, allocated once
+ *
+ * With ARB_buffer_storage the buffer is mapped once (persistent, coherent) and cut in regions,
+ * one per frame in flight. Each region is protected by a fence, so the cpu only waits
+ * if it comes back to a region the gpu is still reading, that is never with 3 regions in practice.
+ * Without it the buffer is orphaned at each frame (glBufferData(nullptr)) and filled with glBufferSubData.
+ */
+class StreamBuffer
+{
+public:
+    enum Mode { NONE, PERSISTENT, ORPHANING };
+
+    struct Stats {
+        qint64 frames = 0;
+        qint64 bytes = 0;
+        qint64 waits = 0;   // times the cpu had to wait for the gpu to release a region
+        qint64 waitNs = 0;
+    } stats;
+
+    bool create(GLExtensions* ext, GLenum target, int regionSize, int regions = 3);
+    void destroy();
+
+    Mode mode() const { return myMode; }
+    GLuint id() const { return buffer; }
+    int regionSize() const { return size; }
+
+    void beginFrame();
+
+    /**
+     * @brief copies the data in the region of the current frame
+     * @return offset of the data in the buffer, -1 if the region is full
+     */
+    int upload(const void* data, int bytes, int alignment);
+
+    void endFrame();
+
+    /**
+     * @brief the waits and bytes since the last report, on chess.stream (a debug category, off by default)
+     */
+    void report();
+
+private:
+    GLExtensions* ext = nullptr;
+    Mode myMode = NONE;
+    GLenum target = 0;
+    GLuint buffer = 0;
+    int size = 0; // of a region
+    int current = 0; // region
+    int cursor = 0; // in the region
+    char* mapped = nullptr;
+    QVector<GLsync> fences; // [regions]
+};
+
+#endif // STREAMBUFFER_H
@@ -0,0 +1,157 @@
+#include "tournamentwall.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const float MOVE_S = 0.8;
+
+// xorshift, one state per board so the boards don't share a sequence
+static quint32 next(quint32& seed)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static float pause(quint32& seed)
+{
+    return 0.5 + 2.0 * (next(seed) % 1000) / 1000; // s
+}
+
+void TournamentWall::setup(int n, const QVector<Piece>& initial, int meshCount, double t)
+{
+    this->meshCount = meshCount;
+    std::copy(initial.begin(), initial.begin() + PIECES, pieces);
+    columns = std::max(1, (int) std::ceil(std::sqrt(n)));
+    origin = t;
+    now = 0;
+
+    myBoards.resize(n);
+    for(int b = 0; b < n; b++) {
+        Board& board = myBoards[b];
+        board = Board();
+        for(int i = 0; i < PIECES; i++)
+            board.square[i] = pieces[i].square;
+        board.seed = 2654435761u * (b + 1);
+        board.start = pause(board.seed);
+    }
+}
+
+float TournamentWall::extent() const
+{
+    return columns * SPACING;
+}
+
+bool TournamentWall::startMove(Board& board)
+{
+    auto at = [&board](int x, int y) {
+        for(int i = 0; i < PIECES; i++)
+            if(board.square[i] == y * 8 + x)
+                return i;
+        return (int) NONE;
+    };
+
+    // a few random tries: a piece of the side to move, one or two squares away, pawns straight ahead
+    for(int tries = 0; tries < 8; tries++) {
+        int i = next(board.seed) % PIECES;
+        if(pieces[i].color != board.turn || board.square[i] == NONE)
+            continue;
+
+        int x = board.square[i] % 8, y = board.square[i] / 8;
+        bool pawn = pieces[i].pawn;
+        int dx = pawn ? 0 : (int) (next(board.seed) % 5) - 2;
+        int dy = pawn ? (board.turn == 0 ? 1 : -1) : (int) (next(board.seed) % 5) - 2;
+        int tx = x + dx, ty = y + dy;
+        if((dx == 0 && dy == 0) || tx < 0 || tx > 7 || ty < 0 || ty > 7)
+            continue;
+
+        int target = at(tx, ty);
+        if(target != NONE && (pieces[target].color == board.turn || pieces[target].king || pawn))
+            continue;
+
+        board.moving = i;
+        board.from = board.square[i];
+        board.to = ty * 8 + tx;
+        board.captured = target;
+        return true;
+    }
+    return false;
+}
+
+void TournamentWall::update(double time)
+{
+    const float t = time - origin;
+    now = t;
+    for(Board& board : myBoards) {
+        if(board.moving != NONE) {
+            if(t < board.start + MOVE_S)
+                continue;
+
+            // landed
+            board.square[board.moving] = board.to;
+            if(board.captured != NONE)
+                board.square[board.captured] = NONE;
+            board.moving = board.captured = NONE;
+            board.turn ^= 1;
+            board.start = t + pause(board.seed);
+        } else if(t >= board.start) {
+            if(startMove(board))
+                board.start = t;
+            else
+                board.start = t + pause(board.seed); // nothing found, try again later
+        }
+    }
+}
+
+void TournamentWall::instances(QVector<float>& data, QVector<int>& first, QVector<int>& count) const
+{
+    const int n = myBoards.size();
+    count.fill(0, meshCount + 1);
+    first.fill(0, meshCount + 1);
+
+    // counting sort by mesh, so each mesh is one range of the buffer
+    for(const Board& board : myBoards)
+        for(int i = 0; i < PIECES; i++)
+            if(board.square[i] != NONE)
+                count[pieces[i].mesh]++;
+    count[meshCount] = n;
+    for(int m = 1; m <= meshCount; m++)
+        first[m] = first[m - 1] + count[m - 1];
+
+    data.resize(4 * (first[meshCount] + n));
+    QVector<int> cursor = first;
+    float* out = data.data();
+    const float half = (columns - 1) * SPACING * 0.5f;
+
+    for(int b = 0; b < n; b++) {
+        const Board& board = myBoards[b];
+        float cx = (b % columns) * SPACING - half, cy = (b / columns) * SPACING - half;
+
+        for(int i = 0; i < PIECES; i++) {
+            if(board.square[i] == NONE)
+                continue;
+
+            float x = board.square[i] % 8, y = board.square[i] / 8, z = 0;
+            if(i == board.moving) {
+                // straight line with a jump
+                float h = std::min(1.f, (now - board.start) / MOVE_S);
+                x += h * (board.to % 8 - x);
+                y += h * (board.to / 8 - y);
+                z = 4 * h * (1 - h);
+            }
+
+            float* instance = out + 4 * cursor[pieces[i].mesh]++;
+            instance[0] = cx - 3.5f + x;
+            instance[1] = cy - 3.5f + y;
+            instance[2] = z;
+            instance[3] = pieces[i].color;
+        }
+
+        float* instance = out + 4 * cursor[meshCount]++;
+        instance[0] = cx;
+        instance[1] = cy;
+        instance[2] = 0;
+        instance[3] = 0;
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef TOURNAMENTWALL_H
+#define TOURNAMENTWALL_H
+
+#include <QVector>
+#include <QVector3D>
+
+/**
+ * @brief many independent games laid out in a grid, for the big screen of a tournament
+ *
+ * Each board is a compact block: the square of its 32 pieces and the move in flight.
+ * The pieces, the meshes and the colors are the same on every board, only the squares differ.
+ * The games are random moves with a pause between them, each board on its own clock.
+ * No GL here: instances() writes the per instance data that the scene draws with one instanced call per mesh.
+ */
+class TournamentWall
+{
+public:
+    enum { PIECES = 32, NONE = 255 };
+    enum { SPACING = 11 }; // between two board centers, the board and its border are 10 wide
+
+    struct Piece {
+        quint8 mesh;
+        quint8 color; // 0 is white
+        quint8 square; // 0 is A1, 1 is B1, NONE off the board
+        bool king; // never captured
+        bool pawn; // one square straight ahead
+    };
+
+    /**
+     * @brief n boards in the initial position, pieces.size() == PIECES
+     */
+    void setup(int n, const QVector<Piece>& pieces, int meshCount, double t);
+    int boards() const { return myBoards.size(); }
+
+    void update(double t);
+
+    /**
+     * @brief 4 floats per instance, x y z around the center of the wall and the color.
+     * The pieces of each mesh are together, then one instance per board at the center of the board.
+     * first and count have meshCount + 1 entries, the last one is the boards
+     */
+    void instances(QVector<float>& data, QVector<int>& first, QVector<int>& count) const;
+
+    float extent() const; // width of the grid
+
+private:
+    struct Board {
+        quint8 square[PIECES];
+        quint8 moving = NONE; // piece in flight
+        quint8 from = 0, to = 0;
+        quint8 captured = NONE; // by the piece in flight, removed when it lands
+        quint8 turn = 0;
+        float start = 0; // of the move, or of the next one while waiting, s since the setup
+        quint32 seed = 1;
+    };
+
+    QVector<Board> myBoards;
+    Piece pieces[PIECES];
+    int meshCount = 0;
+    int columns = 1;
+    double origin = 0; // t of the setup, the boards count from it so that a float keeps its precision
+    float now = 0; // since origin
+
+    bool startMove(Board& board);
+};
+
+#endif // TOURNAMENTWALL_H
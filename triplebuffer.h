@@ -0,0 +1,40 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <QAtomicInt>
+
+/**
+ * @brief the latest value of one writer for one reader, without a lock on either side
+ *
+ * Three slots: the writer fills back() then publishes it, the reader fetches the last published one into front().
+ * Publishing and fetching swap a slot with the one in the middle by an atomic exchange, so neither side waits
+ * and the writer never touches the slot the reader holds. The values skipped by the reader are lost, on purpose.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+    // writer
+    T& back() { return values[backIndex]; }
+    void publish() {
+        backIndex = middle.fetchAndStoreOrdered(backIndex | FRESH) & INDEX;
+    }
+
+    // reader, true when a value was published since the last fetch
+    bool fetch() {
+        if(!(middle.loadAcquire() & FRESH))
+            return false;
+        frontIndex = middle.fetchAndStoreOrdered(frontIndex) & INDEX;
+        return true;
+    }
+    const T& front() const { return values[frontIndex]; }
+
+private:
+    enum { INDEX = 3, FRESH = 4 };
+
+    T values[3];
+    int backIndex = 0, frontIndex = 1; // each owned by its side
+    QAtomicInt middle {2};
+};
+
+#endif // TRIPLEBUFFER_H